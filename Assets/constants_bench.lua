@@ -0,0 +1,18 @@
+-- many shadow-casting renderers in view across four cascades (the headless "Buffer Maps"
+-- line reports updates and bytes uploaded per frame)
+
+local mat_surface = trinket.import_material "surface.mat"
+local mesh_box = trinket.create_cube_mesh("box", 0.5)
+
+for x = -32,31 do
+	for z = 0,63 do
+		local box = trinket.create_object("box_" .. x .. "_" .. z)
+		trinket.set_position(box, 2 * x, 0.5, 2 * z)
+		trinket.attach_rendermesh_to(box, mesh_box, mat_surface, true)
+	end
+end
+
+trinket.set_shadow_cascades(4)
+trinket.set_light_direction(0.5, -1, 0.5)
+trinket.set_pov_position(0, 6, -10)
+trinket.set_pov_rotation(20, 0, 0)
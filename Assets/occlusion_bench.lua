@@ -0,0 +1,33 @@
+-- walls of large blocks between the eye and a field of small boxes (the headless summary
+-- reports the occluded fraction); the near wall is flagged as occluders, the far one is
+-- picked automatically by size
+
+local mat_surface = trinket.import_material "surface.mat"
+local mesh_block = trinket.create_cube_mesh("block", 2)
+local mesh_box = trinket.create_cube_mesh("box", 0.25)
+
+-- two walls, the nearer with a doorway in the middle (4m blocks, over the auto-occluder size)
+
+for row = 0,1 do
+	for col = -8,8 do
+		if row > 0 or col ~= 0 then
+			local block = trinket.create_object("block_" .. row .. "_" .. col)
+			trinket.set_position(block, 4 * col, 2, 16 * row)
+			trinket.attach_rendermesh_to(block, mesh_block, mat_surface, true, row == 0)
+		end
+	end
+end
+
+-- boxes between and behind the walls
+
+for x = -30,30 do
+	for z = 0,40 do
+		local box = trinket.create_object("box_" .. x .. "_" .. z)
+		trinket.set_position(box, x, 0.25, 3 + z)
+		trinket.attach_rendermesh_to(box, mesh_box, mat_surface, false)
+	end
+end
+
+trinket.set_light_direction(0.5, -1, 0.5)
+trinket.set_pov_position(0, 1.5, -8)
+trinket.set_pov_rotation(5, 0, 0)
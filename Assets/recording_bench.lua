@@ -0,0 +1,28 @@
+-- ~50k items (224x224) of many distinct meshes under several materials, so the view
+-- and shadow passes split into many render tasks recorded on deferred contexts (run
+-- windowed, as headless runs only walk the tasks)
+
+local materials = {
+	trinket.import_material "surface.mat",
+	trinket.import_material "checkerboard.mat",
+	trinket.import_material "mecha.mat",
+}
+
+local meshes = {}
+for it = 1,32 do
+	meshes[it] = trinket.create_cube_mesh("cube_" .. it, 0.2 + 0.02 * it)
+end
+
+for x = -112,111 do
+	for z = 0,223 do
+		local obj = trinket.create_object("obj_" .. x .. "_" .. z)
+		trinket.set_position(obj, 2 * x, 0.5, 2 * z)
+		local mesh = meshes[(x * 7 + z) % #meshes + 1]
+		local material = materials[(x + z) % #materials + 1]
+		trinket.attach_rendermesh_to(obj, mesh, material, true)
+	end
+end
+
+trinket.set_light_direction(0.5, -1, 0.5)
+trinket.set_pov_position(0, 6, -10)
+trinket.set_pov_rotation(20, 0, 0)
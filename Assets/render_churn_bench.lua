@@ -0,0 +1,55 @@
+-- keeps a large field of mesh renderers alive while releasing and respawning them at a
+-- fixed rate, and logs the average frame cost once a second (frames also end up in the
+-- headless "CPU ms/frame" summary)
+
+local mat_surface = trinket.import_material "surface.mat"
+local mesh_box = trinket.create_cube_mesh("box", 0.25)
+
+local slotCount = 4096
+local churnPerSecond = 8192
+
+local boxes = {}
+
+local function spawn(slot)
+	local x = slot % 64
+	local z = math.floor(slot / 64)
+	local box = trinket.create_object("box_" .. slot)
+	trinket.set_position(box, x - 32, 0.25, z)
+	trinket.attach_rendermesh_to(box, mesh_box, mat_surface, true)
+	boxes[slot] = box
+end
+
+for slot = 0,slotCount-1 do
+	spawn(slot)
+end
+
+trinket.set_light_direction(0.5, -1, 0.5)
+trinket.set_pov_position(0, 8, -16)
+trinket.set_pov_rotation(25, 0, 0)
+
+local nextSlot = 0
+local churnDebt = 0
+local reportTime = 0
+local reportFrames = 0
+local reportChurned = 0
+
+function tick(dt)
+	-- churn in proportion to elapsed time, so the load doesn't depend on frame rate
+	churnDebt = churnDebt + churnPerSecond * dt
+	while churnDebt >= 1 do
+		trinket.release_object(boxes[nextSlot])
+		spawn(nextSlot)
+		nextSlot = (nextSlot + 31) % slotCount
+		churnDebt = churnDebt - 1
+		reportChurned = reportChurned + 1
+	end
+
+	reportTime = reportTime + dt
+	reportFrames = reportFrames + 1
+	if reportTime >= 1 then
+		trinket.log(string.format("%d renderers churned, %d frames, %.3f ms/frame", reportChurned, reportFrames, 1000 * reportTime / reportFrames))
+		reportTime = 0
+		reportFrames = 0
+		reportChurned = 0
+	end
+end
@@ -0,0 +1,25 @@
+-- still shadow casters under a walking, turning camera (the headless summary reports
+-- the static shadow layer's hit rate)
+
+local mat_surface = trinket.import_material "surface.mat"
+local mesh_block = trinket.create_cube_mesh("block", 1)
+
+for x = -20,20 do
+	for z = -20,20 do
+		local block = trinket.create_object("block_" .. x .. "_" .. z)
+		trinket.set_position(block, 4 * x, 1, 4 * z)
+		trinket.attach_rendermesh_to(block, mesh_block, mat_surface, true)
+	end
+end
+
+trinket.set_light_direction(0.5, -1, 0.5)
+trinket.set_pov_position(0, 1.7, -40)
+
+local yaw = 0
+
+function tick(dt)
+	-- walk at 1.5 m/s, turning at 10 degrees/s
+	yaw = yaw + 10 * dt
+	trinket.set_pov_rotation(10, yaw, 0)
+	trinket.translate_pov_local(0, 0, 1.5 * dt)
+end
@@ -0,0 +1,209 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "AABBTree.h"
+
+int32 AABBTree::DoAllocateNode() {
+	if (freeList == INVALID_INDEX) {
+		nodes.push_back();
+		nodes.back().height = -1;
+		nodes.back().parent = INVALID_INDEX;
+		freeList = int32(nodes.size()) - 1;
+	}
+	let idx = freeList;
+	auto& node = nodes[idx];
+	freeList = node.parent;
+	node.parent = INVALID_INDEX;
+	node.child1 = INVALID_INDEX;
+	node.child2 = INVALID_INDEX;
+	node.height = 0;
+	node.id = OBJECT_NIL;
+	return idx;
+}
+
+void AABBTree::DoFreeNode(int32 idx) {
+	auto& node = nodes[idx];
+	node.parent = freeList;
+	node.height = -1;
+	freeList = idx;
+}
+
+int32 AABBTree::CreateProxy(const AABB& box, ObjectID id) {
+	let proxy = DoAllocateNode();
+	auto& node = nodes[proxy];
+	let margin = vec3(AABB_TREE_MARGIN, AABB_TREE_MARGIN, AABB_TREE_MARGIN);
+	node.box = AABB(box.min - margin, box.max + margin);
+	node.tightBox = box;
+	node.id = id;
+	DoInsertLeaf(proxy);
+	++proxyCount;
+	return proxy;
+}
+
+void AABBTree::DestroyProxy(int32 proxy) {
+	CHECK_ASSERT(nodes[proxy].IsLeaf() && nodes[proxy].height == 0);
+	DoRemoveLeaf(proxy);
+	DoFreeNode(proxy);
+	--proxyCount;
+}
+
+bool AABBTree::MoveProxy(int32 proxy, const AABB& box) {
+	auto& node = nodes[proxy];
+	CHECK_ASSERT(node.IsLeaf() && node.height == 0);
+	node.tightBox = box;
+	if (node.box.Contains(box))
+		return false;
+
+	let margin = vec3(AABB_TREE_MARGIN, AABB_TREE_MARGIN, AABB_TREE_MARGIN);
+	DoRemoveLeaf(proxy);
+	node.box = AABB(box.min - margin, box.max + margin);
+	DoInsertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::DoInsertLeaf(int32 leaf) {
+	if (root == INVALID_INDEX) {
+		root = leaf;
+		nodes[root].parent = INVALID_INDEX;
+		return;
+	}
+
+	// descend towards the cheapest sibling: pairing with a node costs the surface area
+	// of their union, and every ancestor grows by the leaf too (so inherits that growth)
+	let leafBox = nodes[leaf].box;
+	auto sibling = root;
+	while(!nodes[sibling].IsLeaf()) {
+		let& node = nodes[sibling];
+		let area = node.box.SurfaceArea();
+		let combinedArea = node.box.Union(leafBox).SurfaceArea();
+		let cost = 2.f * combinedArea;
+		let inheritanceCost = 2.f * (combinedArea - area);
+
+		let ChildCost = [&](int32 childIdx) {
+			let& child = nodes[childIdx];
+			let growth = child.box.Union(leafBox).SurfaceArea();
+			return child.IsLeaf() ? growth + inheritanceCost : growth - child.box.SurfaceArea() + inheritanceCost;
+		};
+		let cost1 = ChildCost(node.child1);
+		let cost2 = ChildCost(node.child2);
+		if (cost < cost1 && cost < cost2)
+			break;
+		sibling = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	// replace the sibling with a new parent of both
+	let oldParent = nodes[sibling].parent;
+	let newParent = DoAllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = nodes[sibling].box.Union(leafBox);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == INVALID_INDEX) {
+		root = newParent;
+	} else if (nodes[oldParent].child1 == sibling) {
+		nodes[oldParent].child1 = newParent;
+	} else {
+		nodes[oldParent].child2 = newParent;
+	}
+
+	DoRefitAncestors(nodes[leaf].parent);
+}
+
+void AABBTree::DoRemoveLeaf(int32 leaf) {
+	if (leaf == root) {
+		root = INVALID_INDEX;
+		return;
+	}
+
+	// the leaf's sibling takes its parent's place
+	let parent = nodes[leaf].parent;
+	let grandParent = nodes[parent].parent;
+	let sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	nodes[sibling].parent = grandParent;
+	DoFreeNode(parent);
+	if (grandParent == INVALID_INDEX) {
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	DoRefitAncestors(grandParent);
+}
+
+void AABBTree::DoRefitAncestors(int32 idx) {
+	while(idx != INVALID_INDEX) {
+		idx = DoBalance(idx);
+		auto& node = nodes[idx];
+		let& child1 = nodes[node.child1];
+		let& child2 = nodes[node.child2];
+		node.height = 1 + eastl::max(child1.height, child2.height);
+		node.box = child1.box.Union(child2.box);
+		idx = node.parent;
+	}
+}
+
+int32 AABBTree::DoBalance(int32 idxA) {
+	// if one child of A is more than a level taller than the other, it's rotated up into
+	// A's place, and A adopts whichever of its children is shorter. Returns the new root.
+	auto& a = nodes[idxA];
+	if (a.IsLeaf() || a.height < 2)
+		return idxA;
+
+	let balance = nodes[a.child2].height - nodes[a.child1].height;
+	if (balance >= -1 && balance <= 1)
+		return idxA;
+
+	let bRotateChild2 = balance > 1;
+	let idxUp = bRotateChild2 ? a.child2 : a.child1;
+	let idxKept = bRotateChild2 ? a.child1 : a.child2;
+	auto& up = nodes[idxUp];
+	let idxF = up.child1;
+	let idxG = up.child2;
+
+	// the taller grandchild stays with the rotated node
+	up.child1 = idxA;
+	up.parent = a.parent;
+	a.parent = idxUp;
+	if (up.parent == INVALID_INDEX) {
+		root = idxUp;
+	} else if (nodes[up.parent].child1 == idxA) {
+		nodes[up.parent].child1 = idxUp;
+	} else {
+		nodes[up.parent].child2 = idxUp;
+	}
+
+	let bKeepF = nodes[idxF].height > nodes[idxG].height;
+	let idxTaller = bKeepF ? idxF : idxG;
+	let idxShorter = bKeepF ? idxG : idxF;
+	up.child2 = idxTaller;
+	if (bRotateChild2)
+		a.child2 = idxShorter;
+	else
+		a.child1 = idxShorter;
+	nodes[idxShorter].parent = idxA;
+
+	let& kept = nodes[idxKept];
+	let& shorter = nodes[idxShorter];
+	a.box = kept.box.Union(shorter.box);
+	a.height = 1 + eastl::max(kept.height, shorter.height);
+	up.box = a.box.Union(nodes[idxTaller].box);
+	up.height = 1 + eastl::max(a.height, nodes[idxTaller].height);
+	return idxUp;
+}
+
+float AABBTree::RayDistance(const AABB& box, const vec3& origin, const vec3& invDirection, float maxDistance) {
+	// slab test (origins inside the box hit at 0)
+	let t0 = (box.min - origin) * invDirection;
+	let t1 = (box.max - origin) * invDirection;
+	let tNear = glm::min(t0, t1);
+	let tFar = glm::max(t0, t1);
+	let enter = eastl::max(eastl::max(tNear.x, tNear.y), eastl::max(tNear.z, 0.f));
+	let exit = eastl::min(eastl::min(tFar.x, tFar.y), eastl::min(tFar.z, maxDistance));
+	return enter <= exit ? enter : -1.f;
+}
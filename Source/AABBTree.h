@@ -0,0 +1,163 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Geom.h"
+#include "Object.h"
+#include <EASTL/vector.h>
+
+#ifndef AABB_TREE_MARGIN
+#	define AABB_TREE_MARGIN 0.1f // leaf boxes are fattened by this, so small motions needn't reinsert
+#endif
+#ifndef AABB_TREE_STACK_SIZE
+#	define AABB_TREE_STACK_SIZE 64 // query stack entries kept inline, before spilling to the heap
+#endif
+
+// Dynamic bounding-volume tree (in the manner of Box2D's b2DynamicTree). Leaves are
+// proxies with a fattened box, inserted next to the sibling which grows the tree's
+// surface area least, and kept balanced by rotations on the way back up. Moving a
+// proxy only touches the tree if it leaves its fattened box. Queries visit proxies
+// whose tight boxes pass the test, and stop early if the visitor returns false.
+class AABBTree {
+public:
+
+	AABBTree() noexcept = default;
+
+	int32 CreateProxy(const AABB& box, ObjectID id);
+	void DestroyProxy(int32 proxy);
+	bool MoveProxy(int32 proxy, const AABB& box); // true if it was reinserted
+
+	bool NeedsMove(int32 proxy, const AABB& box) const { return !nodes[proxy].box.Contains(box); }
+	const AABB& GetFatBox(int32 proxy) const { return nodes[proxy].box; }
+	const AABB& GetBox(int32 proxy) const { return nodes[proxy].tightBox; }
+	ObjectID GetObject(int32 proxy) const { return nodes[proxy].id; }
+	int32 GetProxyCount() const { return proxyCount; }
+	int32 GetHeight() const { return root == INVALID_INDEX ? 0 : nodes[root].height; }
+
+	// fn(proxy) -> bool continue
+	template<typename Fn> void QueryAABB(const AABB& box, const Fn& fn) const;
+	template<typename Fn> void QueryFrustum(const FrustumPlanes& frustum, const Fn& fn) const;
+	template<typename Fn> void QuerySphere(const vec3& center, float radius, const Fn& fn) const;
+
+	// fn(proxy, distance to its box) -> new max distance (0 stops, maxDistance continues,
+	// the distance itself clips to the nearest hit)
+	template<typename Fn> void RayCast(const vec3& origin, const vec3& direction, float maxDistance, const Fn& fn) const;
+
+	// distance along a (normalized) ray to the box, or -1 if it misses within maxDistance
+	static float RayDistance(const AABB& box, const vec3& origin, const vec3& invDirection, float maxDistance);
+
+private:
+
+	struct Node {
+		AABB box;      // (fattened, for leaves)
+		AABB tightBox; // (leaves only)
+		ObjectID id;
+		int32 parent;  // (next free node, when free)
+		int32 child1;
+		int32 child2;
+		int32 height;  // 0 for leaves, -1 when free
+
+		bool IsLeaf() const { return child1 == INVALID_INDEX; }
+	};
+
+	// traversal stack, local to each query so they may run concurrently
+	class QueryStack {
+	private:
+		int32 inlineItems[AABB_TREE_STACK_SIZE];
+		eastl::vector<int32> heapItems;
+		int32* pItems = inlineItems;
+		int32 capacity = AABB_TREE_STACK_SIZE;
+		int32 count = 0;
+
+	public:
+		bool IsEmpty() const { return count == 0; }
+		int32 Pop() { CHECK_ASSERT(count > 0); return pItems[--count]; }
+		void Push(int32 idx) {
+			if (count == capacity) {
+				// spill to the heap (rare, as the tree is balanced), copying the inline items once
+				if (pItems == inlineItems)
+					heapItems.assign(inlineItems, inlineItems + count);
+				capacity *= 2;
+				heapItems.resize(capacity);
+				pItems = heapItems.data();
+			}
+			pItems[count++] = idx;
+		}
+	};
+
+	eastl::vector<Node> nodes;
+	int32 root = INVALID_INDEX;
+	int32 freeList = INVALID_INDEX;
+	int32 proxyCount = 0;
+
+	int32 DoAllocateNode();
+	void DoFreeNode(int32 idx);
+	void DoInsertLeaf(int32 leaf);
+	void DoRemoveLeaf(int32 leaf);
+	void DoRefitAncestors(int32 idx);
+	int32 DoBalance(int32 idx);
+
+	template<typename Overlaps, typename Fn> void DoQuery(const Overlaps& overlaps, const Fn& fn) const;
+};
+
+template<typename Overlaps, typename Fn>
+void AABBTree::DoQuery(const Overlaps& overlaps, const Fn& fn) const {
+	if (root == INVALID_INDEX)
+		return;
+
+	QueryStack stack;
+	stack.Push(root);
+	while(!stack.IsEmpty()) {
+		let& node = nodes[stack.Pop()];
+		if (!overlaps(node.IsLeaf() ? node.tightBox : node.box))
+			continue;
+		if (node.IsLeaf()) {
+			if (!fn(int32(&node - nodes.data())))
+				return;
+		} else {
+			stack.Push(node.child1);
+			stack.Push(node.child2);
+		}
+	}
+}
+
+template<typename Fn>
+void AABBTree::QueryAABB(const AABB& box, const Fn& fn) const {
+	DoQuery([&box](const AABB& it) { return it.Intersection(box).IsValid(); }, fn);
+}
+
+template<typename Fn>
+void AABBTree::QueryFrustum(const FrustumPlanes& frustum, const Fn& fn) const {
+	DoQuery([&frustum](const AABB& it) { return frustum.Overlaps(it); }, fn);
+}
+
+template<typename Fn>
+void AABBTree::QuerySphere(const vec3& center, float radius, const Fn& fn) const {
+	let radiusSq = radius * radius;
+	DoQuery([&center, radiusSq](const AABB& it) { return it.DistanceSq(center) <= radiusSq; }, fn);
+}
+
+template<typename Fn>
+void AABBTree::RayCast(const vec3& origin, const vec3& direction, float maxDistance, const Fn& fn) const {
+	if (root == INVALID_INDEX)
+		return;
+
+	// (infinities from zero components make the slab test work out)
+	let invDirection = 1.f / direction;
+	QueryStack stack;
+	stack.Push(root);
+	while(!stack.IsEmpty()) {
+		let& node = nodes[stack.Pop()];
+		let distance = RayDistance(node.IsLeaf() ? node.tightBox : node.box, origin, invDirection, maxDistance);
+		if (distance < 0.f)
+			continue;
+		if (node.IsLeaf()) {
+			maxDistance = fn(int32(&node - nodes.data()), distance);
+			if (maxDistance <= 0.f)
+				return;
+		} else {
+			stack.Push(node.child1);
+			stack.Push(node.child2);
+		}
+	}
+}
@@ -0,0 +1,141 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#	define _CRT_SECURE_NO_WARNINGS // for portable fopen()
+#endif
+
+#include "Archive.h"
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
+#include <cstdio>
+
+static uint64 AlignUp(uint64 offset, uint64 alignment) {
+	return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+AssetArchive::~AssetArchive() {
+	Unmount();
+}
+
+bool AssetArchive::TryMount(const char* path) {
+	Unmount();
+
+	let pNewMapping = TryMapFile(path);
+	if (pNewMapping == nullptr)
+		return false;
+
+	// validate the header and table-of-contents up-front, so lookups needn't
+	let pBytes = GetMappingBytes(pNewMapping);
+	let size = uint64(GetMappingSize(pNewMapping));
+	let pHeader = (const ArchiveHeader*) pBytes;
+	auto valid = 
+		size >= sizeof(ArchiveHeader) &&
+		pHeader->Magic == ARCHIVE_MAGIC &&
+		pHeader->Version == ARCHIVE_VERSION &&
+		pHeader->TocOffset % ARCHIVE_TOC_ALIGNMENT == 0 &&
+		pHeader->TocOffset <= size &&
+		(size - pHeader->TocOffset) / sizeof(ArchiveEntry) >= pHeader->EntryCount;
+
+	let pTOC = valid ? (const ArchiveEntry*)(pBytes + pHeader->TocOffset) : nullptr;
+	for (uint32 it = 0; valid && it < pHeader->EntryCount; ++it) {
+		let& entry = pTOC[it];
+		valid = 
+			(it == 0 || pTOC[it - 1].NameHash < entry.NameHash) &&
+			entry.ByteCount >= sizeof(AssetDataHeader) &&
+			entry.Offset % ARCHIVE_BLOB_ALIGNMENT == 0 &&
+			entry.Offset <= pHeader->TocOffset &&
+			entry.ByteCount <= pHeader->TocOffset - entry.Offset && // (can't overflow, unlike Offset + ByteCount)
+			((const AssetDataHeader*)(pBytes + entry.Offset))->ByteCount == entry.ByteCount;
+	}
+
+	if (!valid) {
+		ReleaseMapping(pNewMapping);
+		return false;
+	}
+
+	pMapping = pNewMapping;
+	pEntries = pTOC;
+	entryCount = pHeader->EntryCount;
+	return true;
+}
+
+void AssetArchive::Unmount() {
+	if (pMapping)
+		ReleaseMapping(pMapping);
+	pMapping = nullptr;
+	pEntries = nullptr;
+	entryCount = 0;
+}
+
+const ArchiveEntry* AssetArchive::FindEntry(Name name) const {
+	let pEnd = pEntries + entryCount;
+	let it = eastl::lower_bound(pEntries, pEnd, uint64(name.hash), [](const ArchiveEntry& entry, uint64 hash) { return entry.NameHash < hash; });
+	return it != pEnd && it->NameHash == name.hash ? it : nullptr;
+}
+
+AssetDataRef AssetArchive::Load(Name name, schema_t schema) const {
+	let pEntry = FindEntry(name);
+	if (pEntry == nullptr || (schema != SCHEMA_UNDEFINED && pEntry->Schema != schema))
+		return AssetDataRef();
+	return LoadEntry(pEntry);
+}
+
+AssetDataRef AssetArchive::LoadEntry(const ArchiveEntry* pEntry) const {
+	let pData = (const AssetDataHeader*)(GetMappingBytes(pMapping) + pEntry->Offset);
+	CHECK_ASSERT(HashAssetData(pData) == pEntry->ContentHash);
+	return AssetDataRef::View(pMapping, pData);
+}
+
+void AssetArchiveWriter::Add(Name name, const AssetDataHeader* pData) {
+	if (pData == nullptr)
+		return;
+
+	entries.push_back(PendingEntry { name, AssetDataRef(CopyAssetData(pData)) });
+}
+
+bool AssetArchiveWriter::TrySave(const char* path) {
+	let pFile = fopen(path, "wb");
+	if (pFile == nullptr)
+		return false;
+
+	// stable, so the last duplicate of each name is at the end of its run
+	eastl::stable_sort(entries.begin(), entries.end(), [](const PendingEntry& lhs, const PendingEntry& rhs) { return lhs.name.hash < rhs.name.hash; });
+	let isOverwritten = [this](uint32 idx) { return idx + 1 < entries.size() && entries[idx + 1].name == entries[idx].name; };
+	uint32 uniqueCount = 0;
+	for (uint32 it = 0; it < entries.size(); ++it)
+		uniqueCount += isOverwritten(it) ? 0 : 1;
+
+	static const uint8 padding[ARCHIVE_BLOB_ALIGNMENT] = {};
+	eastl::vector<ArchiveEntry> toc;
+	toc.reserve(entries.size());
+
+	bool success = true;
+	uint64 offset = sizeof(ArchiveHeader);
+	ArchiveHeader header = { ARCHIVE_MAGIC, ARCHIVE_VERSION, uniqueCount, 0, 0 };
+	success &= fwrite(&header, sizeof(ArchiveHeader), 1, pFile) == 1;
+
+	for (uint32 idx = 0; idx < entries.size(); ++idx) {
+		if (isOverwritten(idx))
+			continue;
+		let& it = entries[idx];
+		let pData = it.data.GetHeader();
+		let alignedOffset = AlignUp(offset, ARCHIVE_BLOB_ALIGNMENT);
+		let paddingCount = size_t(alignedOffset - offset);
+		success &= fwrite(padding, 1, paddingCount, pFile) == paddingCount;
+		success &= fwrite(pData, 1, pData->ByteCount, pFile) == pData->ByteCount;
+		toc.push_back(ArchiveEntry { uint64(it.name.hash), HashAssetData(pData), alignedOffset, pData->ByteCount, pData->Schema });
+		offset = alignedOffset + pData->ByteCount;
+	}
+
+	header.TocOffset = AlignUp(offset, ARCHIVE_TOC_ALIGNMENT);
+	let paddingCount = size_t(header.TocOffset - offset);
+	success &= fwrite(padding, 1, paddingCount, pFile) == paddingCount;
+	success &= fwrite(toc.data(), sizeof(ArchiveEntry), toc.size(), pFile) == toc.size();
+
+	// patch the header now that we know where the TOC landed
+	success &= fseek(pFile, 0, SEEK_SET) == 0;
+	success &= fwrite(&header, sizeof(ArchiveHeader), 1, pFile) == 1;
+	success &= fclose(pFile) == 0;
+	return success;
+}
@@ -0,0 +1,87 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "AssetData.h"
+#include "Name.h"
+#include <EASTL/vector.h>
+
+//------------------------------------------------------------------------------------------
+// Asset Archives (.tpak)
+//
+// A single file which concatenates cooked asset-data blobs, so that a package build can
+// mount all of its content with one open() and no source-parsing. Layout:
+//
+//   ArchiveHeader
+//   blobs, each aligned to ARCHIVE_BLOB_ALIGNMENT
+//   ArchiveEntry[EntryCount], sorted by NameHash, aligned to ARCHIVE_TOC_ALIGNMENT
+//
+// The whole file is mapped, and blobs are viewed in-place.
+
+#define ARCHIVE_MAGIC           (0x4B415054) // "TPAK"
+#define ARCHIVE_VERSION         1
+#define ARCHIVE_BLOB_ALIGNMENT  64
+#define ARCHIVE_TOC_ALIGNMENT   16
+
+struct ArchiveHeader {
+	uint32 Magic;
+	uint32 Version;
+	uint32 EntryCount;
+	uint32 Reserved;
+	uint64 TocOffset;
+};
+
+struct ArchiveEntry {
+	uint64   NameHash;
+	uint64   ContentHash;
+	uint64   Offset;
+	uint32   ByteCount;
+	schema_t Schema;
+};
+
+class AssetArchive {
+private:
+	AssetDataMapping* pMapping = nullptr;
+	const ArchiveEntry* pEntries = nullptr;
+	uint32 entryCount = 0;
+
+public:
+
+	AssetArchive() noexcept = default;
+	~AssetArchive();
+
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	bool TryMount(const char* path);
+	void Unmount();
+
+	bool IsMounted() const { return pMapping != nullptr; }
+	int32 GetEntryCount() const { return int32(entryCount); }
+	const ArchiveEntry* GetEntryByIndex(int32 idx) const { CHECK_ASSERT(idx >= 0 && idx < GetEntryCount()); return pEntries + idx; }
+
+	const ArchiveEntry* FindEntry(Name name) const;
+	AssetDataRef Load(Name name, schema_t schema = SCHEMA_UNDEFINED) const;
+	AssetDataRef LoadEntry(const ArchiveEntry* pEntry) const;
+};
+
+class AssetArchiveWriter {
+private:
+
+	struct PendingEntry {
+		Name name;
+		AssetDataRef data;
+	};
+
+	eastl::vector<PendingEntry> entries;
+
+public:
+
+	// copies the blob; if a name is added twice, the last one is saved
+	void Add(Name name, const AssetDataHeader* pData);
+
+	int32 GetEntryCount() const { return int32(entries.size()); }
+	void Clear() { entries.clear(); }
+
+	bool TrySave(const char* path);
+};
@@ -0,0 +1,146 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#	define _CRT_SECURE_NO_WARNINGS // for portable fopen()
+#endif
+
+#include "AssetCache.h"
+#include <EASTL/string.h>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+// bump to invalidate every cache entry (e.g. when the cache layout changes)
+#define ASSET_CACHE_VERSION 1
+
+#define ASSET_CACHE_MAX_PATH 1024
+
+static std::atomic<uint32> gCacheHits { 0 };
+static std::atomic<uint32> gCacheMisses { 0 };
+static std::atomic<uint32> gCacheStores { 0 };
+
+static uint64 HashBytes(uint64 seed, const void* pData, size_t size) {
+	let pBytes = (const uint8*) pData;
+	auto result = seed;
+	for (size_t it = 0; it < size; ++it)
+		result = (result ^ uint64(pBytes[it])) * 1099511628211ull;
+	return result;
+}
+
+static eastl::string GetCachePath(uint64 key, const char* extension) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "/%016" PRIx64 "%s", key, extension);
+	return ASSET_CACHE_DIR + eastl::string(buf);
+}
+
+static bool TryStatSource(const char* path, uint64& outSize, int64& outTime) {
+	std::error_code error;
+	let size = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	let time = std::filesystem::last_write_time(path, error);
+	if (error)
+		return false;
+	outSize = uint64(size);
+	outTime = int64(time.time_since_epoch().count());
+	return true;
+}
+
+AssetCacheEntry::AssetCacheEntry(const char* configPath, schema_t aSchema, uint32 importerVersion)
+	: key(14695981039346656037ull)
+	, schema(aSchema)
+	, valid(false)
+{
+	let iniPath = eastl::string("Assets/") + configPath;
+	let pFile = fopen(iniPath.c_str(), "rb");
+	if (pFile == nullptr)
+		return;
+
+	const uint32 header[3] = { ASSET_CACHE_VERSION, aSchema, importerVersion };
+	key = HashBytes(key, header, sizeof(header));
+	key = HashBytes(key, configPath, strlen(configPath));
+
+	uint8 buf[4096];
+	for (size_t count; (count = fread(buf, 1, sizeof(buf), pFile)) > 0; )
+		key = HashBytes(key, buf, count);
+	valid = ferror(pFile) == 0;
+	fclose(pFile);
+}
+
+AssetDataRef AssetCacheEntry::TryLoad() const {
+	if (!valid)
+		return AssetDataRef();
+
+	// check that the sources haven't been modified since we cooked them
+	bool upToDate = false;
+	if (let pDeps = fopen(GetCachePath(key, ".dep").c_str(), "r")) {
+		upToDate = true;
+		uint64 size;
+		int64 time;
+		char path[ASSET_CACHE_MAX_PATH];
+		while (upToDate && fscanf(pDeps, "%" SCNu64 " %" SCNd64 " %1023[^\n]\n", &size, &time, path) == 3) {
+			uint64 currentSize;
+			int64 currentTime;
+			upToDate = TryStatSource(path, currentSize, currentTime) && currentSize == size && currentTime == time;
+		}
+		fclose(pDeps);
+	}
+
+	auto result = upToDate ? AssetDataRef::Load(GetCachePath(key, ".bin").c_str(), schema) : AssetDataRef();
+	if (result)
+		++gCacheHits;
+	else
+		++gCacheMisses;
+	return result;
+}
+
+void AssetCacheEntry::Store(const AssetDataHeader* pData, const char* const* pSourcePaths, int32 sourceCount) const {
+	if (!valid || pData == nullptr)
+		return;
+
+	std::error_code error;
+	std::filesystem::create_directories(ASSET_CACHE_DIR, error);
+	if (error)
+		return;
+
+	// write the blob before the dependency list, since a missing list is a miss
+	if (!TrySaveAssetData(GetCachePath(key, ".bin").c_str(), const_cast<AssetDataHeader*>(pData)))
+		return;
+
+	let pDeps = fopen(GetCachePath(key, ".dep").c_str(), "w");
+	if (pDeps == nullptr)
+		return;
+
+	bool success = true;
+	for (int32 it = 0; it < sourceCount; ++it) {
+		uint64 size;
+		int64 time;
+		success = success && TryStatSource(pSourcePaths[it], size, time);
+		if (success)
+			fprintf(pDeps, "%" PRIu64 " %" PRId64 " %s\n", size, time, pSourcePaths[it]);
+	}
+	success = (fclose(pDeps) == 0) && success;
+
+	if (success)
+		++gCacheStores;
+	else
+		std::filesystem::remove(GetCachePath(key, ".dep").c_str(), error);
+}
+
+AssetCacheStats GetAssetCacheStats() {
+	AssetCacheStats result;
+	result.hits = gCacheHits.load();
+	result.misses = gCacheMisses.load();
+	result.stores = gCacheStores.load();
+	return result;
+}
+
+void ResetAssetCacheStats() {
+	gCacheHits = 0;
+	gCacheMisses = 0;
+	gCacheStores = 0;
+}
@@ -0,0 +1,45 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "AssetData.h"
+
+//------------------------------------------------------------------------------------------
+// Cooked-Asset Cache
+//
+// Importers cache their asset-data under ASSET_CACHE_DIR, keyed by a hash of the importer
+// version, the config path and the config file's contents. Each entry also records the 
+// size and modified-time of the source files it was cooked from (e.g. the FBX or PNG), 
+// so that editing either the config or the source invalidates it. On a hit, the blob is
+// mapped in-place with AssetDataRef::Load(), so no third-party decoders run.
+
+#define ASSET_CACHE_DIR "Cache"
+
+struct AssetCacheStats {
+	uint32 hits;
+	uint32 misses;
+	uint32 stores;
+};
+
+class AssetCacheEntry {
+private:
+	uint64 key;
+	schema_t schema;
+	bool valid;
+
+public:
+
+	AssetCacheEntry(const char* configPath, schema_t aSchema, uint32 importerVersion);
+
+	bool IsValid() const { return valid; }
+
+	// returns a (read-only, usually mapped) blob on a hit, or an empty ref on a miss
+	AssetDataRef TryLoad() const;
+
+	void Store(const AssetDataHeader* pData, const char* const* pSourcePaths, int32 sourceCount) const;
+	void Store(const AssetDataHeader* pData) const { Store(pData, nullptr, 0); }
+	void Store(const AssetDataHeader* pData, const char* sourcePath) const { Store(pData, &sourcePath, 1); }
+};
+
+AssetCacheStats GetAssetCacheStats();
+void ResetAssetCacheStats();
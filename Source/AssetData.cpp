@@ -1,7 +1,22 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
+#	define _CRT_SECURE_NO_WARNINGS // for portable fopen()
+#endif
+
 #include "AssetData.h"
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 
+#if TRINKET_ASSET_MMAP
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
 #define ASSET_BOM (0xC0FFEE42)
 
 AssetDataHeader* AllocAssetData(uint32 szInBytes, schema_t schema) {
@@ -13,29 +28,29 @@ AssetDataHeader* AllocAssetData(uint32 szInBytes, schema_t schema) {
 	return Result;
 }
 
-AssetDataHeader* LoadAssetData(const char* path, schema_t schema) {
-	FILE* pFile;
-	let error = fopen_s(&pFile, path, "rb");
-	if (error) {
-		return nullptr;
-	}
+static bool IsValidHeader(const AssetDataHeader& header, schema_t schema) {
+	return
+		header.ByteOrderMarker == ASSET_BOM &&
+		header.ByteCount >= sizeof(AssetDataHeader) &&
+		(schema == SCHEMA_UNDEFINED || header.Schema == schema);
+}
 
+AssetDataHeader* LoadAssetData(const char* path, schema_t schema) {
+	let pFile = fopen(path, "rb");
 	if (pFile == nullptr)
 		return nullptr;
 
 	AssetDataHeader header;
 
 	let success = 
-		fread(&header, sizeof(AssetDataHeader), 1, pFile) == sizeof(AssetDataHeader) && 
-		header.ByteOrderMarker == ASSET_BOM &&
-		header.ByteCount >= sizeof(AssetDataHeader) &&
-		(schema == SCHEMA_UNDEFINED || header.Schema == schema);
+		fread(&header, sizeof(AssetDataHeader), 1, pFile) == 1 && 
+		IsValidHeader(header, schema);
 	if (!success) {
 		fclose(pFile);
 		return nullptr;
 	}
 
-	let result = AllocAssetData(header.ByteCount, schema);
+	let result = AllocAssetData(header.ByteCount, header.Schema);
 	let bytesRemaining = header.ByteCount - sizeof(AssetDataHeader);
 	let bytesRead = bytesRemaining > 0 ? fread(result + 1, 1, bytesRemaining, pFile) : 0;
 	if (bytesRemaining != bytesRead) {
@@ -59,22 +74,164 @@ AssetDataHeader* CopyAssetData(const AssetDataHeader* data) {
 }
 
 bool TrySaveAssetData(const char* path, AssetDataHeader* data) {
-	FILE* pFile;
-	let error = fopen_s(&pFile, path, "wb");
-	if (error)
+	let pFile = fopen(path, "wb");
+	if (pFile == nullptr)
 		return false;
 	
-	fwrite(data, 1, data->ByteCount, pFile);
-	return true;
+	let bytesWritten = fwrite(data, 1, data->ByteCount, pFile);
+	let closed = fclose(pFile) == 0;
+	return closed && bytesWritten == data->ByteCount;
 }
 
 void FreeAssetData(AssetDataHeader* data) {
 	free(data);
 }
 
+uint64 HashAssetData(const AssetDataHeader* data) {
+	let pBytes = (const uint8*) data;
+	uint64 result = 14695981039346656037ull;
+	for (uint32 it = 0; it < data->ByteCount; ++it)
+		result = (result ^ uint64(pBytes[it])) * 1099511628211ull;
+	return result;
+}
+
+struct AssetDataMapping {
+	std::atomic<int32> refCount;
+	uint8* pBytes;
+	size_t size;
+	bool isHeap;
+};
+
+AssetDataMapping* TryMapFile(const char* path) {
+	#if TRINKET_ASSET_MMAP
+
+	let fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		return nullptr;
+	}
+
+	// the mapping holds its own reference to the file, so we can close the descriptor
+	let size = size_t(info.st_size);
+	let pBase = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pBase == MAP_FAILED)
+		return nullptr;
+
+	// blobs are consumed front-to-back, so prefetch the whole thing
+	madvise(pBase, size, MADV_WILLNEED);
+
+	let result = new AssetDataMapping;
+	result->refCount.store(1, std::memory_order_relaxed);
+	result->pBytes = (uint8*) pBase;
+	result->size = size;
+	result->isHeap = false;
+	return result;
+
+	#else
+
+	let pFile = fopen(path, "rb");
+	if (pFile == nullptr)
+		return nullptr;
+
+	fseek(pFile, 0, SEEK_END);
+	let fileSize = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	if (fileSize <= 0) {
+		fclose(pFile);
+		return nullptr;
+	}
+
+	let size = size_t(fileSize);
+	let pBytes = (uint8*) malloc(size);
+	let bytesRead = fread(pBytes, 1, size, pFile);
+	fclose(pFile);
+	if (bytesRead != size) {
+		free(pBytes);
+		return nullptr;
+	}
+
+	let result = new AssetDataMapping;
+	result->refCount.store(1, std::memory_order_relaxed);
+	result->pBytes = pBytes;
+	result->size = size;
+	result->isHeap = true;
+	return result;
+
+	#endif
+}
+
+const uint8* GetMappingBytes(const AssetDataMapping* pMapping) {
+	return pMapping->pBytes;
+}
+
+size_t GetMappingSize(const AssetDataMapping* pMapping) {
+	return pMapping->size;
+}
+
+void AddRefMapping(AssetDataMapping* pMapping) {
+	pMapping->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ReleaseMapping(AssetDataMapping* pMapping) {
+	if (pMapping->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	if (pMapping->isHeap) {
+		free(pMapping->pBytes);
+	} else {
+		#if TRINKET_ASSET_MMAP
+		munmap(pMapping->pBytes, pMapping->size);
+		#endif
+	}
+	delete pMapping;
+}
+
+AssetDataRef AssetDataRef::Load(const char* path, schema_t schema) {
+	#if TRINKET_ASSET_MMAP
+	if (let pMapping = TryMapFile(path)) {
+		let pHeader = (const AssetDataHeader*) GetMappingBytes(pMapping);
+		let valid = 
+			GetMappingSize(pMapping) >= sizeof(AssetDataHeader) && 
+			IsValidHeader(*pHeader, schema) && 
+			pHeader->ByteCount <= GetMappingSize(pMapping);
+		auto result = valid ? View(pMapping, pHeader) : AssetDataRef();
+		ReleaseMapping(pMapping);
+		return result;
+	}
+	#endif
+	return AssetDataRef(LoadAssetData(path, schema));
+}
+
+AssetDataRef AssetDataRef::View(AssetDataMapping* pMapping, const AssetDataHeader* pData) {
+	CHECK_ASSERT((const uint8*) pData >= GetMappingBytes(pMapping));
+	CHECK_ASSERT((const uint8*) pData + pData->ByteCount <= GetMappingBytes(pMapping) + GetMappingSize(pMapping));
+	AddRefMapping(pMapping);
+	AssetDataRef result;
+	result.data = const_cast<AssetDataHeader*>(pData);
+	result.pMapping = pMapping;
+	return result;
+}
+
+AssetDataRef AssetDataRef::Share() const {
+	return pMapping ? View(pMapping, data) : AssetDataRef(CopyAssetData(data));
+}
+
 AssetDataRef::~AssetDataRef() { 
-	if (data)
+	Reset();
+}
+
+void AssetDataRef::Reset() {
+	if (pMapping)
+		ReleaseMapping(pMapping);
+	else if (data)
 		FreeAssetData(data);
+	data = nullptr;
+	pMapping = nullptr;
 }
 
 bool AssetDataRef::ValidBOM() const {
@@ -82,8 +239,7 @@ bool AssetDataRef::ValidBOM() const {
 }
 
 void AssetDataRef::SetData(AssetDataHeader* pData) {
-	if (data)
-		FreeAssetData(data);
+	Reset();
 	data = pData;
 }
 
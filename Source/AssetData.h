@@ -2,6 +2,15 @@
 #include "Common.h"
 #include <EASTL/string.h>
 
+// Load asset-data by memory-mapping files, rather than reading them into the heap?
+#ifndef TRINKET_ASSET_MMAP
+#	if defined(__unix__) || defined(__APPLE__)
+#		define TRINKET_ASSET_MMAP 1
+#	else
+#		define TRINKET_ASSET_MMAP 0
+#	endif
+#endif
+
 // TODO: Cooking/Caching
 //       - source assets are compiled/"cooked" to a position-independent POD binary blob (asset-data)
 //       - assets-data is cachable, keyed off the INI path it was loaded from
@@ -46,37 +55,73 @@ AssetDataHeader* CopyAssetData(const AssetDataHeader* data);
 bool TrySaveAssetData(const char* path, AssetDataHeader* data);
 void FreeAssetData(AssetDataHeader* data);
 
+// 64-bit FNV-1a hash of a blob's bytes
+uint64 HashAssetData(const AssetDataHeader* data);
+
+//------------------------------------------------------------------------------------------
+// Ref-counted read-only file mapping, shared by AssetDataRefs viewing the same file. When
+// TRINKET_ASSET_MMAP is unavailable the file is read into the heap instead.
+
+struct AssetDataMapping;
+
+AssetDataMapping* TryMapFile(const char* path);
+const uint8* GetMappingBytes(const AssetDataMapping* pMapping);
+size_t GetMappingSize(const AssetDataMapping* pMapping);
+void AddRefMapping(AssetDataMapping* pMapping);
+void ReleaseMapping(AssetDataMapping* pMapping);
+
 //------------------------------------------------------------------------------------------
 // Unique-Ptr-Like Reference to Asset Data Blob
+//
+// Either owns a heap-allocated blob, or holds a reference on a read-only file-mapping,
+// in which case the blob is viewed in-place from the page cache and must not be written.
 
 class AssetDataRef {
 private:
 	AssetDataHeader* data;
+	AssetDataMapping* pMapping;
 
 public:
 
-	AssetDataRef() noexcept : data(nullptr) {}
-	AssetDataRef(AssetDataRef&& rval) noexcept : data(rval.data) { rval.data = nullptr; }
+	AssetDataRef() noexcept : data(nullptr), pMapping(nullptr) {}
+	AssetDataRef(AssetDataRef&& rval) noexcept : data(rval.data), pMapping(rval.pMapping) { rval.data = nullptr; rval.pMapping = nullptr; }
 	AssetDataRef& operator=(AssetDataRef&& rval) noexcept {
-		data = rval.data;
-		rval.data = nullptr;
+		if (this != &rval) {
+			Reset();
+			data = rval.data;
+			pMapping = rval.pMapping;
+			rval.data = nullptr;
+			rval.pMapping = nullptr;
+		}
 		return *this;
 	}
 
 	AssetDataRef(const AssetDataRef&) = delete;
 	AssetDataRef& operator=(const AssetDataRef&) = delete;
 
-	AssetDataRef(AssetDataHeader* aData) noexcept : data(aData)  {}
+	AssetDataRef(AssetDataHeader* aData) noexcept : data(aData), pMapping(nullptr) {}
 
 	~AssetDataRef();
 
+	// Maps the file when TRINKET_ASSET_MMAP is available, falling back on LoadAssetData()
+	static AssetDataRef Load(const char* path, schema_t schema = 0);
+
+	// A reference to a blob inside a mapping (e.g. an archive entry)
+	static AssetDataRef View(AssetDataMapping* pMapping, const AssetDataHeader* pData);
+
+	// Another reference to the same blob (shares the mapping, or copies a heap blob)
+	AssetDataRef Share() const;
+
 	bool ValidBOM() const;
+	bool IsMapped() const { return pMapping != nullptr; }
 	schema_t Schema() const { return data ? data->Schema : SCHEMA_UNDEFINED; }
+	const AssetDataHeader* GetHeader() const { return data; }
 
 	operator bool() const { return data != nullptr; }
 
 	template<typename T>
 	T* Get() { 
+		CHECK_ASSERT(pMapping == nullptr); // mapped data is read-only
 		return data && data->Schema == T::SCHEMA ? (T*) data : nullptr;
 	}
 
@@ -86,6 +131,7 @@ public:
 	}
 
 	void SetData(AssetDataHeader* pData);
+	void Reset();
 };
 
 //------------------------------------------------------------------------------------------
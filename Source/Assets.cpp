@@ -5,13 +5,17 @@
 
 AssetDatabase::AssetDatabase() : mgr(true) {
 	mgr.ReserveCompact(1024);
+	names.Reserve(1024);
 }
 
 AssetDatabase::~AssetDatabase() {
 }
 
 ObjectID AssetDatabase::CreateObject(Name name) {
-	return mgr.CreateObject(name, 1);
+	let id = mgr.CreateObject(name, 1);
+	if (!id.IsNil())
+		names.Add(name, id);
+	return id;
 }
 
 void AssetDatabase::AddRef(ObjectID id) {
@@ -32,6 +36,7 @@ void AssetDatabase::Release(ObjectID id) {
 	if ((*pRefCount) == 0) {
 		for (auto listener : listeners)
 			listener->Database_WillReleaseAsset(this, id);
+		names.Remove(GetName(id), id);
 		mgr.ReleaseObject(id);
 	}
 }
@@ -42,18 +47,15 @@ Name  AssetDatabase::GetName(ObjectID id) const {
 }
 
 ObjectID AssetDatabase::FindAsset(Name name) const {
-	let pNames = mgr.GetPool().GetComponentData<C_NAME>();
-	let n = mgr.GetPool().Count();
-	for (int it = 0; it < n; ++it) {
-		if (name == pNames[it])
-			return *mgr.GetPool().GetComponentByIndex<C_HANDLE>(it);
-	}
-	return OBJECT_NIL;
+	return names.Find(name, mgr.GetPool());
 }
 
 void AssetDatabase::TryRename(ObjectID id, Name name) {
-	if (let pName = mgr.TryGetComponent<C_NAME>(id))
+	if (let pName = mgr.TryGetComponent<C_NAME>(id)) {
+		names.Remove(*pName, id);
 		*pName = name;
+		names.Add(name, id);
+	}
 }
 //
 //eastl::string AssetDatabase::GetConfigPath(ObjectID id) const {
@@ -61,6 +63,34 @@ void AssetDatabase::TryRename(ObjectID id, Name name) {
 //	return pName ? "Assets/" + pName->GetString() + ".ini" : "";
 //}
 
+bool AssetDatabase::TryMountArchive(const char* path) {
+	auto pArchive = eastl::make_unique<AssetArchive>();
+	if (!pArchive->TryMount(path))
+		return false;
+	archives.push_back(eastl::move(pArchive));
+	return true;
+}
+
+AssetDataRef AssetDatabase::FindArchivedAssetData(Name name, schema_t schema) const {
+	for (auto it = archives.rbegin(); it != archives.rend(); ++it) {
+		if (auto result = (*it)->Load(name, schema))
+			return result;
+	}
+	return AssetDataRef();
+}
+
+void AssetDatabase::BeginRecordingArchive() {
+	pRecorder = eastl::make_unique<AssetArchiveWriter>();
+}
+
+bool AssetDatabase::TrySaveRecordedArchive(const char* path) {
+	if (!pRecorder)
+		return false;
+	let result = pRecorder->TrySave(path);
+	pRecorder.reset();
+	return result;
+}
+
 void AssetDatabase::CacheAssetData(ObjectID id, AssetDataHeader* pData) {
 	data.TryAppendObject(id, pData);
 }
@@ -6,6 +6,8 @@
 #include "Name.h"
 #include "ObjectPool.h"
 #include "AssetData.h"
+#include "Archive.h"
+#include <EASTL/unique_ptr.h>
 
 // TODO: Filesystem Abstraction (physfs?)
 
@@ -29,7 +31,10 @@ private:
 	enum Components { C_HANDLE, C_NAME, C_REF_COUNT };
 
 	ObjectMgr<Name, int32> mgr;   // shared resource objects
+	NameIndex names;
 	ObjectPool<AssetDataRef> data;
+	eastl::vector<eastl::unique_ptr<AssetArchive>> archives;
+	eastl::unique_ptr<AssetArchiveWriter> pRecorder;
 	ListenerList<IAssetListener> listeners;
 
 public:
@@ -53,6 +58,15 @@ public:
 	ObjectID FindAsset(Name name) const;
 	void TryRename(ObjectID id, Name name);
 
+	// cooked asset archives, searched most-recently-mounted first
+	bool TryMountArchive(const char* path);
+	AssetDataRef FindArchivedAssetData(Name name, schema_t schema) const;
+
+	// records every asset-data blob passed to RecordAssetData(), to pack into an archive
+	void BeginRecordingArchive();
+	void RecordAssetData(Name name, const AssetDataHeader* pData) { if (pRecorder) pRecorder->Add(name, pData); }
+	bool TrySaveRecordedArchive(const char* path);
+
 	// asset-data in-memory caching
 	void CacheAssetData(ObjectID id, AssetDataHeader* pData);
 	void ClearAssetData(ObjectID id);
@@ -0,0 +1,427 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "Tests.h"
+
+#if TRINKET_TEST
+#include "Hierarchy.h"
+#include "Jobs.h"
+#include "Scene.h"
+#include <EASTL/algorithm.h>
+#include <EASTL/hash_map.h>
+#include <EASTL/string.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <shared_mutex>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock BenchClock;
+
+double MillisecondsSince(BenchClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+void AddBenchTree(Hierarchy& hierarchy, TestRandom& rng, int32 count, int32 rootInterval) {
+
+	// tree of short chains and fans (each object is parented to one of the last few 
+	// objects added), with a new root every rootInterval objects or so
+	for (int32 it = 0; it < count; ++it) {
+		let id = ObjectID(uint32(it));
+		let parent = it == 0 || rng.Range(rootInterval) == 0 ? OBJECT_NIL : ObjectID(uint32(it - 1 - rng.Range(eastl::min(it, 8))));
+		hierarchy.TryAdd(id, parent);
+		hierarchy.SetRelativePose(id, rng.Pose());
+	}
+}
+
+void ApplyBenchWrite(Hierarchy& hierarchy, TestRandom& rng, int32 count) {
+
+	// mostly gameplay-style relative writes, plus physics-style scene writes
+	let idx = rng.Range(count);
+	switch (rng.Range(4)) {
+	case 0:
+	case 1: hierarchy.SetRelativePositionByIndex(idx, rng.Position()); break;
+	case 2: hierarchy.SetRelativeRotationByIndex(idx, rng.Rotation()); break;
+	default: hierarchy.SetScenePoseByIndex(idx, rng.Pose()); break;
+	}
+}
+
+void BenchHierarchyShape(const char* shape, int32 rootInterval) {
+	using namespace std;
+
+	// the same random setter traffic is applied to an eager and a deferred hierarchy,
+	// and the deferred one is flushed at the end of each frame
+	const int32 objectCount = 100000;
+	const int32 writesPerFrame = 10000;
+	const int32 frameCount = 10;
+	Hierarchy eager(ObjectID(0u));
+	Hierarchy deferred(ObjectID(1u));
+	TestRandom eagerTree(1), deferredTree(1);
+	AddBenchTree(eager, eagerTree, objectCount, rootInterval);
+	AddBenchTree(deferred, deferredTree, objectCount, rootInterval);
+	deferred.SetDeferPoseUpdates(true);
+
+	TestRandom eagerRandom(2), deferredRandom(2);
+	double eagerMs = 0.0;
+	double deferredMs = 0.0;
+	for (int32 frame = 0; frame < frameCount; ++frame) {
+		let eagerStart = BenchClock::now();
+		for (int32 it = 0; it < writesPerFrame; ++it)
+			ApplyBenchWrite(eager, eagerRandom, objectCount);
+		eagerMs += MillisecondsSince(eagerStart);
+
+		let deferredStart = BenchClock::now();
+		for (int32 it = 0; it < writesPerFrame; ++it)
+			ApplyBenchWrite(deferred, deferredRandom, objectCount);
+		deferred.FlushScenePoses();
+		deferredMs += MillisecondsSince(deferredStart);
+	}
+
+	let identical =
+		memcmp(eager.GetRelativePoseData(), deferred.GetRelativePoseData(), objectCount * sizeof(HPose)) == 0 &&
+		memcmp(eager.GetScenePoseData(), deferred.GetScenePoseData(), objectCount * sizeof(HPose)) == 0;
+	cout << "[BENCH] hierarchy (" << shape << ", a root per ~" << rootInterval << " objects): " << objectCount << " objects, " << writesPerFrame << " random writes/frame" << endl;
+	cout << "[BENCH]   eager:    " << eagerMs / frameCount << " ms/frame" << endl;
+	cout << "[BENCH]   deferred: " << deferredMs / frameCount << " ms/frame (" << eagerMs / deferredMs << "x)" << endl;
+	cout << "[BENCH]   identical poses: " << (identical ? "yes" : "NO") << endl;
+}
+
+void BenchHierarchy() {
+	BenchHierarchyShape("shallow", 32);
+	BenchHierarchyShape("deep", 1024);
+}
+
+double ScalarConcatNanoseconds(const Hierarchy& hierarchy, eastl::vector<HPose>& scenePoses, int32 repeatCount) {
+
+	// reference: the scalar PoseMask::Concat loop the scene poses were computed with before
+	let n = hierarchy.Count();
+	let pParents = hierarchy.GetParentData();
+	let pRelativePoses = hierarchy.GetRelativePoseData();
+	let pMasks = hierarchy.GetMaskData();
+	scenePoses.resize(n);
+	auto best = 1e30;
+	for (int32 repeat = 0; repeat < repeatCount; ++repeat) {
+		let start = BenchClock::now();
+		for (int32 it = 0; it < n; ++it) {
+			let parentIdx = pParents[it];
+			scenePoses[it] = parentIdx >= 0 ? pMasks[it].Concat(scenePoses[parentIdx], pRelativePoses[it]) : pRelativePoses[it];
+		}
+		best = eastl::min(best, 1e6 * MillisecondsSince(start) / n);
+	}
+	return best;
+}
+
+double KernelConcatNanoseconds(const Hierarchy& hierarchy, eastl::vector<HPose>& scenePoses, int32 repeatCount) {
+
+	// the ConcatPoses kernel alone, grouping runs of poses whose parents are already
+	// computed (as the flush does, without its dirty-flag bookkeeping)
+	let n = hierarchy.Count();
+	let pParents = hierarchy.GetParentData();
+	let pRelativePoses = hierarchy.GetRelativePoseData();
+	let pMasks = hierarchy.GetMaskData();
+	scenePoses.resize(n);
+	auto best = 1e30;
+	for (int32 repeat = 0; repeat < repeatCount; ++repeat) {
+		let start = BenchClock::now();
+		int32 indices[POSE_BATCH_WIDTH];
+		int32 count = 0;
+		for (int32 it = 0; it < n; ++it) {
+			if (pParents[it] < 0) {
+				scenePoses[it] = pRelativePoses[it];
+				continue;
+			}
+			if (count == POSE_BATCH_WIDTH || (count > 0 && pParents[it] >= indices[0])) {
+				ConcatPoses(scenePoses.data(), pRelativePoses, pMasks, pParents, indices, count);
+				count = 0;
+			}
+			indices[count++] = it;
+		}
+		ConcatPoses(scenePoses.data(), pRelativePoses, pMasks, pParents, indices, count);
+		best = eastl::min(best, 1e6 * MillisecondsSince(start) / n);
+	}
+	return best;
+}
+
+double FlushConcatNanoseconds(Hierarchy& hierarchy, int32 repeatCount) {
+
+	// dirty every root, so the flush recomputes the whole hierarchy with ConcatPoses
+	let n = hierarchy.Count();
+	hierarchy.SetDeferPoseUpdates(true);
+	auto best = 1e30;
+	for (int32 repeat = 0; repeat < repeatCount; ++repeat) {
+		for (int32 it = 0; it < n; ++it)
+			if (hierarchy.IsRootIndex(it))
+				hierarchy.SetRelativePoseByIndex(it, *hierarchy.GetRelativePoseByIndex(it));
+		let start = BenchClock::now();
+		hierarchy.FlushScenePoses();
+		best = eastl::min(best, 1e6 * MillisecondsSince(start) / n);
+	}
+	hierarchy.SetDeferPoseUpdates(false);
+	return best;
+}
+
+void BenchPoseConcatShape(const char* shape, Hierarchy& hierarchy) {
+	using namespace std;
+
+	// best-of-N, so it's the cost with the columns in cache (64k poses are ~5MB)
+	const int32 repeatCount = 50;
+	eastl::vector<HPose> scalarPoses, kernelPoses;
+	let scalarNs = ScalarConcatNanoseconds(hierarchy, scalarPoses, repeatCount);
+	let kernelNs = KernelConcatNanoseconds(hierarchy, kernelPoses, repeatCount);
+	let flushNs = FlushConcatNanoseconds(hierarchy, repeatCount);
+
+	// the kernel rounds differently than PoseMask::Concat, but must match the flush exactly
+	auto maxError = 0.f;
+	let pKernelPoses = reinterpret_cast<const float*>(kernelPoses.data());
+	let pScalarPoses = reinterpret_cast<const float*>(scalarPoses.data());
+	let floatCount = hierarchy.Count() * int32(sizeof(HPose) / sizeof(float));
+	for (int32 it = 0; it < floatCount; ++it)
+		maxError = eastl::max(maxError, fabsf(pKernelPoses[it] - pScalarPoses[it]));
+	let identical = memcmp(kernelPoses.data(), hierarchy.GetScenePoseData(), hierarchy.Count() * sizeof(HPose)) == 0;
+
+	cout << "[BENCH] pose_concat (" << shape << "): " << hierarchy.Count() << " poses" << endl;
+	cout << "[BENCH]   PoseMask::Concat loop: " << scalarNs << " ns/pose" << endl;
+	cout << "[BENCH]   ConcatPoses kernel:    " << kernelNs << " ns/pose (" << scalarNs / kernelNs << "x), max abs difference " << maxError << endl;
+	cout << "[BENCH]   hierarchy flush:       " << flushNs << " ns/pose, identical to kernel: " << (identical ? "yes" : "NO") << endl;
+}
+
+void BenchPoseConcat() {
+	const int32 poseCount = 65536;
+	TestRandom rng(3);
+
+	// flat: 16 roots with 4095 direct children each (every batch is full)
+	{
+		Hierarchy hierarchy(ObjectID(0u));
+		const int32 rootCount = 16;
+		for (int32 it = 0; it < poseCount; ++it) {
+			let parent = it % (poseCount / rootCount) == 0 ? OBJECT_NIL : ObjectID(uint32(it - it % (poseCount / rootCount)));
+			hierarchy.TryAdd(ObjectID(uint32(it)), parent);
+			hierarchy.SetRelativePoseByIndex(hierarchy.IndexOf(ObjectID(uint32(it))), rng.Pose());
+		}
+		BenchPoseConcatShape("flat, 16 x 4095 children", hierarchy);
+	}
+
+	// deep: 1024 chains, 64 links long (every batch is a single pose)
+	{
+		Hierarchy hierarchy(ObjectID(0u));
+		const int32 chainLength = 64;
+		for (int32 it = 0; it < poseCount; ++it) {
+			let parent = it % chainLength == 0 ? OBJECT_NIL : ObjectID(uint32(it - 1));
+			hierarchy.TryAdd(ObjectID(uint32(it)), parent);
+			hierarchy.SetRelativePoseByIndex(it, rng.Pose());
+		}
+		BenchPoseConcatShape("deep, 1024 x 64-link chains", hierarchy);
+	}
+
+	// mixed: short chains and fans, as in the hierarchy benchmark
+	{
+		Hierarchy hierarchy(ObjectID(0u));
+		AddBenchTree(hierarchy, rng, poseCount, 32);
+		BenchPoseConcatShape("mixed chains and fans", hierarchy);
+	}
+}
+
+double TimeTransformFrames(Scene& scene, JobSystem& jobs, const eastl::vector<ObjectID>& roots, int32 frameCount) {
+
+	// every root moves each frame, so every object is recomputed by the flush
+	auto totalMs = 0.0;
+	for (int32 frame = 0; frame < frameCount; ++frame) {
+		for (int32 it = 0; it < int32(roots.size()); ++it) {
+			let pHierarchy = scene.GetSublevelHierarchyFor(roots[it]);
+			pHierarchy->SetRelativePosition(roots[it], vec3(float(it), float(frame), 0.f));
+		}
+		let start = BenchClock::now();
+		scene.UpdateTransformsParallel(&jobs);
+		totalMs += MillisecondsSince(start);
+	}
+	return totalMs / frameCount;
+}
+
+void BenchParallelTransforms() {
+	using namespace std;
+
+	// 1M objects across 64 sublevels, in root subtrees of ~64 short chains and fans
+	const int32 sublevelCount = 64;
+	const int32 objectsPerSublevel = 16384;
+	const int32 frameCount = 10;
+	Scene scene;
+	scene.SetDeferPoseUpdates(true);
+	TestRandom rng(5);
+	eastl::vector<ObjectID> roots;
+	eastl::vector<ObjectID> recent;
+	for (int32 sub = 0; sub < sublevelCount; ++sub) {
+		let pHierarchy = scene.GetHierarchy(scene.CreateSublevel(NAME("bench_sublevel")));
+		recent.clear();
+		for (int32 it = 0; it < objectsPerSublevel; ++it) {
+			let id = scene.CreateObject(NAME("bench_object"));
+			let parent = it == 0 || rng.Range(64) == 0 ? OBJECT_NIL : recent[recent.size() - 1 - rng.Range(eastl::min(int32(recent.size()), 8))];
+			pHierarchy->TryAdd(id, parent);
+			pHierarchy->SetRelativePose(id, rng.Pose());
+			if (parent.IsNil())
+				roots.push_back(id);
+			recent.push_back(id);
+		}
+	}
+	scene.FlushScenePoses();
+
+	// 1, 2, 4 ... threads, up to the hardware (and at least 8, to show the overhead of
+	// oversubscribing a smaller machine)
+	cout << "[BENCH] parallel_transforms: " << sublevelCount * objectsPerSublevel << " objects in " << sublevelCount << " sublevels, " << roots.size() << " moving roots, " << thread::hardware_concurrency() << " hardware threads" << endl;
+	let maxThreadCount = eastl::max(int32(thread::hardware_concurrency()), 8);
+	auto serialMs = 0.0;
+	for (int32 threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+		JobSystem jobs(threadCount - 1);
+		let ms = TimeTransformFrames(scene, jobs, roots, frameCount);
+		if (threadCount == 1)
+			serialMs = ms;
+		cout << "[BENCH]   " << threadCount << " threads: " << ms << " ms/frame (" << serialMs / ms << "x)" << endl;
+	}
+}
+
+// the intern table before it was sharded: one map behind a shared_mutex
+struct SharedMutexNameTable {
+	std::shared_mutex mutex;
+	eastl::hash_map<size_t, eastl::string> map;
+
+	void Intern(size_t hash, const char* cstring) {
+		mutex.lock_shared();
+		let notInterned = map.find(hash) == map.end();
+		mutex.unlock_shared();
+		if (notInterned) {
+			mutex.lock();
+			map[hash] = cstring;
+			mutex.unlock();
+		}
+	}
+
+	eastl::string GetString(size_t hash) {
+		eastl::string result;
+		mutex.lock_shared();
+		let it = map.find(hash);
+		if (it != map.end())
+			result = it->second;
+		mutex.unlock_shared();
+		return result;
+	}
+};
+
+struct NameBenchStrings {
+	eastl::vector<eastl::string> strings;
+	eastl::vector<size_t> hashes;
+
+	void Generate(const char* prefix, int32 count) {
+		strings.resize(count);
+		hashes.resize(count);
+		for (int32 it = 0; it < count; ++it) {
+			strings[it] = eastl::string(prefix) + eastl::to_string(it);
+			hashes[it] = Name::Hash(strings[it].c_str());
+		}
+	}
+};
+
+double NanosecondsPerOp(int32 opCount, BenchClock::time_point start) {
+	return 1e6 * MillisecondsSince(start) / opCount;
+}
+
+void BenchNames() {
+	using namespace std;
+
+	// per thread count, for each table: fresh interns (every string new), repeat interns
+	// of a warm set (the common case, e.g. NAME() and find-by-name), and GetString()
+	const int32 warmCount = 65536;
+	const int32 opCount = 1 << 20;
+	const int32 grainSize = 4096;
+	NameBenchStrings warm;
+	warm.Generate("bench_warm_", warmCount);
+	SharedMutexNameTable oldTable;
+	for (int32 it = 0; it < warmCount; ++it) {
+		oldTable.Intern(warm.hashes[it], warm.strings[it].c_str());
+		Name::Intern(warm.hashes[it], warm.strings[it].c_str(), false);
+	}
+
+	cout << "[BENCH] names: " << warmCount << " warm names, " << opCount << " ops per test, " << thread::hardware_concurrency() << " hardware threads (ns/op, shared_mutex map -> sharded table)" << endl;
+	let maxThreadCount = eastl::max(int32(thread::hardware_concurrency()), 8);
+	NameBenchStrings fresh;
+	for (int32 threadCount = 1; threadCount <= maxThreadCount; threadCount *= 2) {
+		JobSystem jobs(threadCount - 1);
+
+		fresh.Generate((eastl::string("bench_old_") + eastl::to_string(threadCount) + "_").c_str(), opCount);
+		auto start = BenchClock::now();
+		jobs.ParallelFor(opCount, grainSize, [&](int32 begin, int32 end) {
+			for (auto it = begin; it < end; ++it)
+				oldTable.Intern(fresh.hashes[it], fresh.strings[it].c_str());
+		});
+		let oldFreshNs = NanosecondsPerOp(opCount, start);
+
+		fresh.Generate((eastl::string("bench_new_") + eastl::to_string(threadCount) + "_").c_str(), opCount);
+		start = BenchClock::now();
+		jobs.ParallelFor(opCount, grainSize, [&](int32 begin, int32 end) {
+			for (auto it = begin; it < end; ++it)
+				Name::Intern(fresh.hashes[it], fresh.strings[it].c_str(), false);
+		});
+		let newFreshNs = NanosecondsPerOp(opCount, start);
+
+		start = BenchClock::now();
+		jobs.ParallelFor(opCount, grainSize, [&](int32 begin, int32 end) {
+			for (auto it = begin; it < end; ++it)
+				oldTable.Intern(warm.hashes[it % warmCount], warm.strings[it % warmCount].c_str());
+		});
+		let oldWarmNs = NanosecondsPerOp(opCount, start);
+
+		start = BenchClock::now();
+		jobs.ParallelFor(opCount, grainSize, [&](int32 begin, int32 end) {
+			for (auto it = begin; it < end; ++it)
+				Name::Intern(warm.hashes[it % warmCount], warm.strings[it % warmCount].c_str(), false);
+		});
+		let newWarmNs = NanosecondsPerOp(opCount, start);
+
+		start = BenchClock::now();
+		jobs.ParallelFor(opCount, grainSize, [&](int32 begin, int32 end) {
+			for (auto it = begin; it < end; ++it)
+				oldTable.GetString(warm.hashes[it % warmCount]);
+		});
+		let oldLookupNs = NanosecondsPerOp(opCount, start);
+
+		start = BenchClock::now();
+		jobs.ParallelFor(opCount, grainSize, [&](int32 begin, int32 end) {
+			for (auto it = begin; it < end; ++it)
+				Name(warm.hashes[it % warmCount]).GetString();
+		});
+		let newLookupNs = NanosecondsPerOp(opCount, start);
+
+		cout << "[BENCH]   " << threadCount << " threads: fresh intern " << oldFreshNs << " -> " << newFreshNs;
+		cout << ", repeat intern " << oldWarmNs << " -> " << newWarmNs;
+		cout << ", GetString " << oldLookupNs << " -> " << newLookupNs << endl;
+	}
+}
+
+struct Benchmark {
+	const char* name;
+	void (*func)();
+};
+
+const Benchmark benchmarks[] = {
+	{ "hierarchy", BenchHierarchy },
+	{ "pose_concat", BenchPoseConcat },
+	{ "parallel_transforms", BenchParallelTransforms },
+	{ "names", BenchNames },
+};
+
+}
+
+bool RunBenchmark(const char* name) {
+	let all = strcmp(name, "all") == 0;
+	bool found = false;
+	for (let& it : benchmarks) {
+		if (all || strcmp(name, it.name) == 0) {
+			it.func();
+			found = true;
+		}
+	}
+	return found;
+}
+
+#endif
@@ -3,9 +3,19 @@
 
 #pragma once
 
+// Build without a graphics device backend (e.g. profiling CPU frame cost on build boxes)?
+// Any build can also run without a window or device by passing --headless.
+#ifndef TRINKET_HEADLESS
+#	define TRINKET_HEADLESS 0
+#endif
+
 // Include IMGUI editor?
 #ifndef TRINKET_EDITOR
-#	define TRINKET_EDITOR 1
+#	if TRINKET_HEADLESS
+#		define TRINKET_EDITOR 0
+#	else
+#		define TRINKET_EDITOR 1
+#	endif
 #endif
 
 // Include QA/Test features (e.g. wireframe debug-draw)
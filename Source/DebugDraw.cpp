@@ -0,0 +1,164 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "DebugDraw.h"
+#include <glm/gtc/constants.hpp>
+#include <thread>
+
+DebugLineBuffer::~DebugLineBuffer() {
+	for(auto& stream : streams)
+		DoTrimPages(stream, 0);
+}
+
+DebugLineBuffer::Stream& DebugLineBuffer::DoBeginWrite() {
+	// register as a writer of the current stream, retrying if it was retired in
+	// between (Flip() swaps, then waits for registered writers, so this can't be missed)
+	for(;;) {
+		let idx = writeIdx.load();
+		auto& stream = streams[idx];
+		stream.writers.fetch_add(1);
+		if (writeIdx.load() == idx)
+			return stream;
+		stream.writers.fetch_sub(1);
+	}
+}
+
+void DebugLineBuffer::DoEndWrite(Stream& stream) {
+	stream.writers.fetch_sub(1, std::memory_order_release);
+}
+
+void DebugLineBuffer::DoWriteLine(Stream& stream, uint32 lineIdx, const vec4& color, const vec3& start, const vec3& end) {
+	if (lineIdx >= DEBUG_LINE_CAPACITY)
+		return; // (counted as dropped when retired)
+
+	// allocate pages on first touch; if two writers race, the loser frees its page
+	auto& pageSlot = stream.pages[lineIdx / DEBUG_LINE_PAGE_SIZE];
+	auto pPage = pageSlot.load(std::memory_order_acquire);
+	if (pPage == nullptr) {
+		let pNewPage = new Page;
+		if (pageSlot.compare_exchange_strong(pPage, pNewPage, std::memory_order_acq_rel)) {
+			pPage = pNewPage;
+			pageCount.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			delete pNewPage;
+		}
+	}
+
+	let vertexIdx = 2 * (lineIdx % DEBUG_LINE_PAGE_SIZE);
+	pPage->vertices[vertexIdx].position = start;
+	pPage->vertices[vertexIdx].color = color;
+	pPage->vertices[vertexIdx + 1].position = end;
+	pPage->vertices[vertexIdx + 1].color = color;
+}
+
+void DebugLineBuffer::DoTrimPages(Stream& stream, uint32 usedPageCount) {
+	for(uint32 it=usedPageCount; it<DEBUG_LINE_MAX_PAGES; ++it) {
+		if (let pPage = stream.pages[it].exchange(nullptr, std::memory_order_relaxed)) {
+			delete pPage;
+			pageCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+uint32 DebugLineBuffer::Flip() {
+	// the stream retired last flip takes appends again, keeping only the pages it used
+	let retiringIdx = writeIdx.load();
+	auto& nextStream = streams[1 - retiringIdx];
+	DoTrimPages(nextStream, GetRetiredPageCount());
+	nextStream.cursor.store(0, std::memory_order_relaxed);
+	writeIdx.store(1 - retiringIdx);
+
+	// (seq_cst like the writeIdx store above, pairing with DoBeginWrite()'s increment-then-
+	// recheck; an acquire load could be reordered before the store, missing a late writer)
+	auto& stream = streams[retiringIdx];
+	while(stream.writers.load() != 0)
+		std::this_thread::yield();
+	let total = stream.cursor.load(std::memory_order_relaxed);
+	retiredCount = total < DEBUG_LINE_CAPACITY ? total : DEBUG_LINE_CAPACITY;
+	retiredDroppedCount = total - retiredCount;
+	return retiredCount;
+}
+
+const DebugLineVertex* DebugLineBuffer::GetRetiredPage(uint32 pageIdx) const {
+	CHECK_ASSERT(pageIdx < GetRetiredPageCount());
+	return streams[1 - writeIdx.load()].pages[pageIdx].load(std::memory_order_relaxed)->vertices;
+}
+
+uint32 DebugLineBuffer::GetRetiredPageLineCount(uint32 pageIdx) const {
+	CHECK_ASSERT(pageIdx < GetRetiredPageCount());
+	let remaining = retiredCount - pageIdx * DEBUG_LINE_PAGE_SIZE;
+	return remaining < DEBUG_LINE_PAGE_SIZE ? remaining : DEBUG_LINE_PAGE_SIZE;
+}
+
+void DebugLineBuffer::DrawLine(const vec4& color, const vec3& start, const vec3& end) {
+	auto& stream = DoBeginWrite();
+	DoWriteLine(stream, stream.cursor.fetch_add(1, std::memory_order_relaxed), color, start, end);
+	DoEndWrite(stream);
+}
+
+void DebugLineBuffer::DoDrawCorners(const vec4& color, const vec3* corners) {
+	// corners are indexed by bits (x, y, z), so edges join corners one bit apart
+	auto& stream = DoBeginWrite();
+	auto lineIdx = stream.cursor.fetch_add(12, std::memory_order_relaxed);
+	for(int corner=0; corner<8; ++corner)
+		for(int axis=0; axis<3; ++axis)
+			if ((corner & (1 << axis)) == 0)
+				DoWriteLine(stream, lineIdx++, color, corners[corner], corners[corner | (1 << axis)]);
+	DoEndWrite(stream);
+}
+
+void DebugLineBuffer::DrawBox(const vec4& color, const mat4& transform) {
+	vec3 corners[8];
+	for(int it=0; it<8; ++it) {
+		let local = vec4(it & 1 ? 1.f : -1.f, it & 2 ? 1.f : -1.f, it & 4 ? 1.f : -1.f, 1.f);
+		corners[it] = vec3(transform * local);
+	}
+	DoDrawCorners(color, corners);
+}
+
+void DebugLineBuffer::DrawAABB(const vec4& color, const AABB& box) {
+	vec3 corners[8];
+	for(int it=0; it<8; ++it)
+		corners[it] = vec3(it & 1 ? box.max.x : box.min.x, it & 2 ? box.max.y : box.min.y, it & 4 ? box.max.z : box.min.z);
+	DoDrawCorners(color, corners);
+}
+
+void DebugLineBuffer::DrawFrustum(const vec4& color, const mat4& viewProjection, bool isGL) {
+	let inverseViewProjection = glm::inverse(viewProjection);
+	let nearDepth = isGL ? -1.f : 0.f;
+	vec3 corners[8];
+	for(int it=0; it<8; ++it) {
+		let clip = inverseViewProjection * vec4(it & 1 ? 1.f : -1.f, it & 2 ? 1.f : -1.f, it & 4 ? 1.f : nearDepth, 1.f);
+		corners[it] = vec3(clip) / clip.w;
+	}
+	DoDrawCorners(color, corners);
+}
+
+void DebugLineBuffer::DrawSphere(const vec4& color, const vec3& center, float radius) {
+	// one circle around each axis
+	auto& stream = DoBeginWrite();
+	auto lineIdx = stream.cursor.fetch_add(3 * DEBUG_SPHERE_SEGMENTS, std::memory_order_relaxed);
+	let step = glm::two_pi<float>() / float(DEBUG_SPHERE_SEGMENTS);
+	for(int axis=0; axis<3; ++axis) {
+		let OnCircle = [&](int segment) {
+			let angle = step * float(segment);
+			vec3 offset(0.f, 0.f, 0.f);
+			offset[(axis + 1) % 3] = radius * cosf(angle);
+			offset[(axis + 2) % 3] = radius * sinf(angle);
+			return center + offset;
+		};
+		for(int segment=0; segment<DEBUG_SPHERE_SEGMENTS; ++segment)
+			DoWriteLine(stream, lineIdx++, color, OnCircle(segment), OnCircle(segment + 1));
+	}
+	DoEndWrite(stream);
+}
+
+void DebugLineBuffer::DrawAxes(const mat4& transform, float size) {
+	auto& stream = DoBeginWrite();
+	let lineIdx = stream.cursor.fetch_add(3, std::memory_order_relaxed);
+	let origin = vec3(transform[3]);
+	DoWriteLine(stream, lineIdx + 0, vec4(1, 0, 0, 1), origin, origin + size * vec3(transform[0]));
+	DoWriteLine(stream, lineIdx + 1, vec4(0, 1, 0, 1), origin, origin + size * vec3(transform[1]));
+	DoWriteLine(stream, lineIdx + 2, vec4(0, 0, 1, 1), origin, origin + size * vec3(transform[2]));
+	DoEndWrite(stream);
+}
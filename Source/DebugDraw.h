@@ -0,0 +1,80 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Geom.h"
+#include <atomic>
+
+#ifndef DEBUG_LINE_PAGE_SIZE
+#	define DEBUG_LINE_PAGE_SIZE 4096 // lines per page
+#endif
+#ifndef DEBUG_LINE_MAX_PAGES
+#	define DEBUG_LINE_MAX_PAGES 1024
+#endif
+#ifndef DEBUG_SPHERE_SEGMENTS
+#	define DEBUG_SPHERE_SEGMENTS 16
+#endif
+
+#define DEBUG_LINE_CAPACITY (DEBUG_LINE_PAGE_SIZE * DEBUG_LINE_MAX_PAGES)
+
+struct DebugLineVertex {
+	vec3 position;
+	vec4 color;
+};
+
+// Double-buffered stream of debug lines, stored in pages which are allocated on
+// first touch (and trimmed when a frame doesn't need them). Any thread may append
+// without locking: each primitive reserves its lines with one atomic add. The
+// renderer calls Flip() once a frame and reads back the retired lines while the
+// next frame's lines are appended to the other buffer.
+class DebugLineBuffer {
+public:
+
+	DebugLineBuffer() noexcept = default;
+	~DebugLineBuffer();
+
+	DebugLineBuffer(const DebugLineBuffer&) = delete;
+	DebugLineBuffer& operator=(const DebugLineBuffer&) = delete;
+
+	void DrawLine(const vec4& color, const vec3& start, const vec3& end);
+	void DrawBox(const vec4& color, const mat4& transform); // the [-1,1] cube, transformed
+	void DrawAABB(const vec4& color, const AABB& box);
+	void DrawSphere(const vec4& color, const vec3& center, float radius);
+	void DrawFrustum(const vec4& color, const mat4& viewProjection, bool isGL);
+	void DrawAxes(const mat4& transform, float size);
+
+	// Renderer-only: retires the lines appended since the last flip (after waiting
+	// for in-flight appends), and returns how many there are
+	uint32 Flip();
+
+	uint32 GetRetiredCount() const { return retiredCount; }
+	uint32 GetRetiredDroppedCount() const { return retiredDroppedCount; } // (past capacity)
+	uint32 GetRetiredPageCount() const { return (retiredCount + DEBUG_LINE_PAGE_SIZE - 1) / DEBUG_LINE_PAGE_SIZE; }
+	const DebugLineVertex* GetRetiredPage(uint32 pageIdx) const;
+	uint32 GetRetiredPageLineCount(uint32 pageIdx) const;
+	size_t GetAllocatedBytes() const { return size_t(pageCount.load(std::memory_order_relaxed)) * sizeof(Page); }
+
+private:
+
+	struct Page {
+		DebugLineVertex vertices[2 * DEBUG_LINE_PAGE_SIZE];
+	};
+
+	struct Stream {
+		std::atomic<Page*> pages[DEBUG_LINE_MAX_PAGES] = {};
+		std::atomic<uint32> cursor { 0 };
+		std::atomic<int32> writers { 0 };
+	};
+
+	Stream streams[2];
+	std::atomic<int32> writeIdx { 0 };
+	std::atomic<int32> pageCount { 0 };
+	uint32 retiredCount = 0;
+	uint32 retiredDroppedCount = 0;
+
+	Stream& DoBeginWrite();
+	void DoEndWrite(Stream& stream);
+	void DoWriteLine(Stream& stream, uint32 lineIdx, const vec4& color, const vec3& start, const vec3& end);
+	void DoDrawCorners(const vec4& color, const vec3* corners);
+	void DoTrimPages(Stream& stream, uint32 usedPageCount);
+};
@@ -1,5 +1,9 @@
 #include "Display.h"
+#include <EABase/eabase.h>
+#include <thread>
+#if D3D12_SUPPORTED
 #include "DiligentCore/Graphics/GraphicsEngineD3D12/interface/EngineFactoryD3D12.h"
+#endif
 
 #define DEPTH_BUFFER_FORMAT TEX_FORMAT_D32_FLOAT
 
@@ -14,8 +18,20 @@ void GraphicsDebugMessageCallback(
 	cout << "[GRAPHICS] " << Message << endl;
 }
 
-Display::Display(const char* windowName) {
+Display::Display(const char* windowName, bool headless) {
 
+	#if TRINKET_HEADLESS
+	EA_UNUSED(windowName);
+	headless = true; // no device backend in this build
+	#endif
+
+	if (headless) {
+		// no window or device, so graphics only does its CPU-side work
+		MSAA_Count = 1;
+		return;
+	}
+
+	#if !TRINKET_HEADLESS
 	SDL_Rect rect;
 	SDL_GetDisplayBounds(0, &rect);
 
@@ -42,9 +58,17 @@ Display::Display(const char* windowName) {
 	#if _DEBUG
 	EngineCI.EnableDebugLayer = true;
 	#endif
+	// one deferred context per hardware thread, so any job worker can record
+	let threadCount = int32(std::thread::hardware_concurrency());
+	deferredContextCount = threadCount < MAX_DEFERRED_CONTEXTS ? threadCount : MAX_DEFERRED_CONTEXTS;
+	EngineCI.NumDeferredContexts = deferredContextCount;
 	auto GetEngineFactoryD3D12 = LoadGraphicsEngineD3D12();
 	auto* pFactoryD3D12 = GetEngineFactoryD3D12();
-	pFactoryD3D12->CreateDeviceAndContextsD3D12(EngineCI, &pDevice, &pContext);
+	IDeviceContext* ppContexts[1 + MAX_DEFERRED_CONTEXTS] = {};
+	pFactoryD3D12->CreateDeviceAndContextsD3D12(EngineCI, &pDevice, ppContexts);
+	pContext.Attach(ppContexts[0]);
+	for(int it=0; it<deferredContextCount; ++it)
+		pDeferredContexts[it].Attach(ppContexts[1 + it]);
 	pEngineFactory = pFactoryD3D12;
 
 
@@ -62,21 +86,34 @@ Display::Display(const char* windowName) {
 		SupportedSampleCounts & 0x02 ? 2 : 
 		1;
 	CreateMSAARenderTarget();
+	#endif
 }
 
 Display::~Display() {
 	if (pContext)
 		pContext->Flush();
-	SDL_DestroyWindow(pWindow);
+	if (pWindow)
+		SDL_DestroyWindow(pWindow);
+}
+
+float Display::GetAspect() const {
+	if (IsHeadless())
+		return float(HEADLESS_SCREEN_WIDTH) / float(HEADLESS_SCREEN_HEIGHT);
+	let& SCD = pSwapChain->GetDesc(); 
+	return float(SCD.Width) / float(SCD.Height);
 }
 
 ivec2 Display::GetScreenSize() const {
+	if (IsHeadless())
+		return ivec2(HEADLESS_SCREEN_WIDTH, HEADLESS_SCREEN_HEIGHT);
 	ivec2 result;
 	SDL_GetWindowSize(pWindow, &result.x, &result.y);
 	return result;
 }
 
 void Display::HandleEvent(const SDL_Event& ev) {
+	if (IsHeadless())
+		return;
 	let resize = ev.type == SDL_WINDOWEVENT && (
 		ev.window.event == SDL_WINDOWEVENT_RESIZED ||
 		ev.window.event == SDL_WINDOWEVENT_SIZE_CHANGED
@@ -90,6 +127,8 @@ void Display::HandleEvent(const SDL_Event& ev) {
 }
 
 void Display::SetMultisamplingTargetAndClear() {
+	if (IsHeadless())
+		return;
 	ITextureView* pRTV = GetRenderTargetView();
 	ITextureView* pDSV = GetDepthTargetView();
 	pContext->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -99,6 +138,8 @@ void Display::SetMultisamplingTargetAndClear() {
 }
 
 void Display::ResolveMultisampling() {
+	if (IsHeadless())
+		return;
 	if (IsMultisampling()) {
 		// Resolve multi-sampled render taget into the current swap chain back buffer.
 		auto pCurrentBackBuffer = pSwapChain->GetCurrentBackBufferRTV()->GetTexture();
@@ -114,6 +155,8 @@ void Display::ResolveMultisampling() {
 }
 
 void Display::Present() {
+	if (IsHeadless())
+		return;
 
 	bool vsync = true;
 	pSwapChain->Present(vsync ? 1 : 0);
@@ -8,6 +8,11 @@
 #include <SDL_syswm.h>
 
 // Diligent Engine Config
+#if TRINKET_HEADLESS && !defined(_WIN32)
+#ifndef PLATFORM_LINUX
+#define PLATFORM_LINUX 1
+#endif
+#else
 #ifndef PLATFORM_WIN32
 #define PLATFORM_WIN32 1
 #endif
@@ -17,6 +22,15 @@
 #ifndef D3D12_SUPPORTED
 #define D3D12_SUPPORTED 1
 #endif
+#endif
+
+// Headless displays report this size for aspect/screen queries
+#ifndef HEADLESS_SCREEN_WIDTH
+#define HEADLESS_SCREEN_WIDTH 1280
+#endif
+#ifndef HEADLESS_SCREEN_HEIGHT
+#define HEADLESS_SCREEN_HEIGHT 720
+#endif
 
 #include "DiligentCore/Common/interface/BasicMath.hpp"
 #include "DiligentCore/Common/interface/RefCntAutoPtr.hpp"
@@ -26,6 +40,11 @@
 #include "DiligentCore/Graphics/GraphicsEngine/interface/Shader.h"
 #include "DiligentCore/Graphics/GraphicsEngine/interface/SwapChain.h"
 
+// Deferred contexts for recording command lists on job threads
+#ifndef MAX_DEFERRED_CONTEXTS
+#define MAX_DEFERRED_CONTEXTS 16
+#endif
+
 using namespace Diligent;
 class Graphics;
 class Texture;
@@ -35,24 +54,30 @@ class Mesh;
 class Display {
 public:
 
-	Display(const char* windowName);
+	Display(const char* windowName, bool headless = false);
 	~Display();
 
 	SDL_Window* GetWindow() { return pWindow; }
 
+	// Headless displays have no window, device or contexts (--headless), so
+	// rendering code must treat them as optional and only do CPU-side work
+	bool IsHeadless() const { return pDevice == nullptr; }
+
 	IRenderDevice* GetDevice() { return pDevice; }
 	IEngineFactory* GetEngineFactory() { return pEngineFactory; }
 	IDeviceContext* GetContext() { return pContext; }
+	int32 GetDeferredContextCount() const { return deferredContextCount; }
+	IDeviceContext* GetDeferredContext(int32 idx) { CHECK_ASSERT(idx >= 0 && idx < deferredContextCount); return pDeferredContexts[idx]; }
 	ISwapChain* GetSwapChain() { return pSwapChain; }
 
-	float GetAspect() const { let& SCD = pSwapChain->GetDesc(); return float(SCD.Width) / float(SCD.Height); }
+	float GetAspect() const;
 	ivec2 GetScreenSize() const;
 
 	bool IsMultisampling() const { return MSAA_Count > 1; }
 	int GetMultisampleCount() const { return MSAA_Count; }
 
-	ITextureView* GetRenderTargetView() { return IsMultisampling() ? pMSColorRTV : pSwapChain->GetCurrentBackBufferRTV(); }
-	ITextureView* GetDepthTargetView() { return IsMultisampling() ? pMSDepthDSV : pSwapChain->GetDepthBufferDSV(); }
+	ITextureView* GetRenderTargetView() { return IsMultisampling() || !pSwapChain ? pMSColorRTV : pSwapChain->GetCurrentBackBufferRTV(); }
+	ITextureView* GetDepthTargetView() { return IsMultisampling() || !pSwapChain ? pMSDepthDSV : pSwapChain->GetDepthBufferDSV(); }
 
 	void HandleEvent(const SDL_Event& aEvent);
 
@@ -64,9 +89,11 @@ private:
 
 	void CreateMSAARenderTarget();
 
-	SDL_Window* pWindow;
+	SDL_Window* pWindow = nullptr;
 	RefCntAutoPtr<IRenderDevice>  pDevice;
 	RefCntAutoPtr<IDeviceContext> pContext;
+	RefCntAutoPtr<IDeviceContext> pDeferredContexts[MAX_DEFERRED_CONTEXTS];
+	int32                         deferredContextCount = 0;
 	RefCntAutoPtr<IEngineFactory> pEngineFactory;
 	RefCntAutoPtr<ISwapChain>     pSwapChain;
 
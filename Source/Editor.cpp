@@ -195,14 +195,33 @@ void Editor::ShowInspector() {
 			toDelete = selection;
 
 		if (let pHierarchy = pScene->GetSublevelHierarchyFor(selection)) {
-			let rel = pHierarchy->GetScenePose(selection);
-			ImGui::LabelText("Position", "<%.2f, %.2f, %.2f>", rel->position.x, rel->position.y, rel->position.z);
+			let rel = pHierarchy->GetCurrentScenePose(selection);
+			ImGui::LabelText("Position", "<%.2f, %.2f, %.2f>", rel.position.x, rel.position.y, rel.position.z);
 		}
 
 	} else {
 		ImGui::Text("No Object Selected.");
 	}
 
+	if (ImGui::CollapsingHeader("Rendering")) {
+		let& stats = pWorld->GetGraphics()->GetRenderStats();
+		ImGui::Text("Visible: %u (Culled: %u)", stats.visibleCount, stats.culledCount);
+		ImGui::Text("Occluded: %u (Occluders: %u)", stats.occludedCount, stats.occluderCount);
+		ImGui::Text("Shadow Casters: %u (Culled: %u)", stats.shadowCasterCount, stats.culledShadowCasterCount);
+		ImGui::Text("Draw Calls: %u", stats.drawCount);
+		ImGui::Text("Triangles: %u", stats.triangleCount);
+		ImGui::Text("PSO Binds: %u", stats.psoBindCount);
+		ImGui::Text("SRB Commits: %u", stats.srbCommitCount);
+		ImGui::Text("Vertex Buffer Binds: %u", stats.vertexBufferBindCount);
+		ImGui::Text("Static Shadow Cache Hits: %u / Invalidations: %u", stats.staticShadowCacheHits, stats.staticShadowInvalidations);
+		ImGui::Text("Buffer Maps: %u (%u bytes)", stats.mapCount, stats.uploadBytes);
+		ImGui::Text("Debug Lines: %u (Dropped: %u)", stats.debugLineCount, stats.droppedDebugLineCount);
+
+		auto shadowSettings = pWorld->GetGraphics()->GetShadowSettings();
+		if (ImGui::SliderInt("Shadow Cascades", &shadowSettings.cascadeCount, 1, MAX_SHADOW_CASCADES))
+			pWorld->GetGraphics()->SetShadowSettings(shadowSettings);
+	}
+
 
 	ImGui::End();
 
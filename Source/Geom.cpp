@@ -0,0 +1,72 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "Geom.h"
+#include <xmmintrin.h>
+
+static_assert( sizeof(AABB) == 6 * sizeof(float) );
+
+int32 CullBoxes(const FrustumPlanes& frustum, const AABB* pBoxes, int32 idxStart, int32 idxEnd, int32* outIndices) {
+	
+	// splat planes, one component per register
+	__m128 nx[6], ny[6], nz[6], absx[6], absy[6], absz[6], d[6];
+	for(int it=0; it<6; ++it) {
+		let& plane = frustum.planes[it];
+		nx[it] = _mm_set1_ps(plane.normal.x);
+		ny[it] = _mm_set1_ps(plane.normal.y);
+		nz[it] = _mm_set1_ps(plane.normal.z);
+		absx[it] = _mm_set1_ps(glm::abs(plane.normal.x));
+		absy[it] = _mm_set1_ps(glm::abs(plane.normal.y));
+		absz[it] = _mm_set1_ps(glm::abs(plane.normal.z));
+		d[it] = _mm_set1_ps(plane.distance);
+	}
+
+	let half = _mm_set1_ps(0.5f);
+	let zero = _mm_setzero_ps();
+	int32 count = 0;
+	int32 idx = idxStart;
+	for(; idx + 4 <= idxEnd; idx += 4) {
+		
+		// transpose four boxes into lanes: [min.xyz, max.x] and [min.z, max.xyz]
+		let pFloats = reinterpret_cast<const float*>(pBoxes + idx);
+		__m128 a0 = _mm_loadu_ps(pFloats + 0);
+		__m128 a1 = _mm_loadu_ps(pFloats + 6);
+		__m128 a2 = _mm_loadu_ps(pFloats + 12);
+		__m128 a3 = _mm_loadu_ps(pFloats + 18);
+		_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+		__m128 b0 = _mm_loadu_ps(pFloats + 2);
+		__m128 b1 = _mm_loadu_ps(pFloats + 8);
+		__m128 b2 = _mm_loadu_ps(pFloats + 14);
+		__m128 b3 = _mm_loadu_ps(pFloats + 20);
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+		let cx = _mm_mul_ps(half, _mm_add_ps(a0, b1));
+		let cy = _mm_mul_ps(half, _mm_add_ps(a1, b2));
+		let cz = _mm_mul_ps(half, _mm_add_ps(a2, b3));
+		let ex = _mm_mul_ps(half, _mm_sub_ps(b1, a0));
+		let ey = _mm_mul_ps(half, _mm_sub_ps(b2, a1));
+		let ez = _mm_mul_ps(half, _mm_sub_ps(b3, a2));
+
+		// a box is outside if it's entirely below any plane
+		__m128 outside = zero;
+		for(int it=0; it<6; ++it) {
+			let dist = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[it], cx), _mm_mul_ps(ny[it], cy)), _mm_mul_ps(nz[it], cz)), d[it]);
+			let radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absx[it], ex), _mm_mul_ps(absy[it], ey)), _mm_mul_ps(absz[it], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+		}
+
+		let visibleBits = ~_mm_movemask_ps(outside) & 0xf;
+		for(int lane=0; lane<4; ++lane) {
+			outIndices[count] = idx + lane;
+			count += (visibleBits >> lane) & 1;
+		}
+	}
+
+	// remainder
+	for(; idx < idxEnd; ++idx) {
+		outIndices[count] = idx;
+		count += frustum.Overlaps(pBoxes[idx]) ? 1 : 0;
+	}
+
+	return count;
+}
@@ -44,6 +44,17 @@ struct AABB {
 			pos.x < max.x && pos.y < max.y && pos.z < max.z ;
 	}
 
+	bool Contains(const AABB& other) const {
+		return
+			other.min.x >= min.x && other.min.y >= min.y && other.min.z >= min.z &&
+			other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z ;
+	}
+
+	float SurfaceArea() const {
+		let size = Size();
+		return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
 	AABB Union(const AABB& other) const {
 		return AABB(glm::min(min, other.min), glm::max(max, other.max));
 	}
@@ -195,5 +206,42 @@ struct FrustumParams {
 
 struct FrustumPlanes {
 	Plane planes[6];
+
+	// Extracts inward-facing planes from a (view-)projection matrix. For GL-style clip-space,
+	// depth is in [-w, w], otherwise it's in [0, w].
+	static FrustumPlanes FromMatrix(const mat4& m, bool isGL) {
+		let row = [&m](int idx) { return vec4(m[0][idx], m[1][idx], m[2][idx], m[3][idx]); };
+		const vec4 equations[6] = {
+			row(3) + row(0),
+			row(3) - row(0),
+			row(3) + row(1),
+			row(3) - row(1),
+			isGL ? row(3) + row(2) : row(2),
+			row(3) - row(2)
+		};
+
+		FrustumPlanes result;
+		for(int it=0; it<6; ++it) {
+			let invLength = 1.f / glm::length(vec3(equations[it]));
+			result.planes[it] = Plane(invLength * vec3(equations[it]), -invLength * equations[it].w);
+		}
+		return result;
+	}
+
+	bool Overlaps(const AABB& box) const {
+		let center = box.Center();
+		let extent = box.Extent();
+		for(let& it : planes) {
+			let radius = glm::dot(glm::abs(it.normal), extent);
+			if (it.DistanceTo(center) + radius < 0.f)
+				return false;
+		}
+		return true;
+	}
 };
 
+// Writes the indices in [idxStart, idxEnd) of boxes which overlap the frustum to
+// outIndices, and returns the count. Boxes are tested four-at-a-time with SSE. 
+// outIndices must have room for (idxEnd - idxStart) indices.
+int32 CullBoxes(const FrustumPlanes& frustum, const AABB* pBoxes, int32 idxStart, int32 idxEnd, int32* outIndices);
+
@@ -7,6 +7,8 @@
 
 #include <glm/gtx/color_space.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <cfloat>
+#include <EASTL/sort.h>
 
 #include "Math.h"
 #include "World.h"
@@ -17,11 +19,16 @@ Graphics::Graphics(Display* aDisplay, World* aWorld)
 	, pWorld(aWorld)
 	, pov{ RPose(ForceInit::Default), 60.f, 0.01f, 100000.f }
 	, lightDirection(0, -1, 0)
+	, shadowSettings{ 3, 2048, 50.f, 0.75f }
 {
 	pWorld->db.AddListener(this);
 	pWorld->scene.AddListener(this);
 	pWorld->skel.AddListener(this);
 
+	// headless: no device objects, and Draw() only tallies
+	if (pDisplay->IsHeadless())
+		return;
+
 	let pDevice = pDisplay->GetDevice();
 	let pSwapChain = pDisplay->GetSwapChain();
 	let pContext = pDisplay->GetContext();
@@ -31,33 +38,27 @@ Graphics::Graphics(Display* aDisplay, World* aWorld)
 	pEngineFactory->CreateDefaultShaderSourceStreamFactory("Assets", &pShaderSourceFactory);
 
 	// create shadow map texture
-	{
-		TextureDesc SMDesc;
-		SMDesc.Name = "Shadow Map";
-		SMDesc.Type = RESOURCE_DIM_TEX_2D;
-		SMDesc.Width = 2048;
-		SMDesc.Height = 2048;
-		SMDesc.Format = TEX_FORMAT_SHADOW_MAP;
-		SMDesc.BindFlags = BIND_SHADER_RESOURCE | BIND_DEPTH_STENCIL;
-		pDevice->CreateTexture(SMDesc, nullptr, &pShadowMap);
-		pShadowMapSRV = pShadowMap->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
-		pShadowMapDSV = pShadowMap->GetDefaultView(TEXTURE_VIEW_DEPTH_STENCIL);
-	}
+	DoCreateShadowMap();
 
 
-	// create render constants
+	// create render constants (per-object transforms are in the instance stream)
 	{
+		// (both are updated on the immediate context before any command list executes,
+		// so each pass has its own buffer rather than remapping one per pass)
 		BufferDesc BD;
-		BD.Name = "CB_Surface";
-		BD.uiSizeInBytes = sizeof(RenderConstants);
-		BD.Usage = USAGE_DYNAMIC;
+		BD.Name = "CB_Frame";
+		BD.uiSizeInBytes = sizeof(FrameConstants);
+		BD.Usage = USAGE_DEFAULT;
 		BD.BindFlags = BIND_UNIFORM_BUFFER;
-		BD.CPUAccessFlags = CPU_ACCESS_WRITE;
-		pDevice->CreateBuffer(BD, nullptr, &pRenderConstants);
+		pDevice->CreateBuffer(BD, nullptr, &pFrameConstants);
+		BD.Name = "CB_Pass";
+		BD.uiSizeInBytes = sizeof(PassConstants);
+		for(auto& pBuffer : pPassConstants)
+			pDevice->CreateBuffer(BD, nullptr, &pBuffer);
 	}
 
-	// create shadow map pipeline state
-	{
+	// create shadow map pipeline states (one per mesh vertex format)
+	for(uint32 format=0; format<MESH_VERTEX_FORMAT_COUNT; ++format) {
 		PipelineStateCreateInfo PCI;
 		PipelineStateDesc& PSODesc = PCI.PSODesc;
 		PSODesc.Name = "PS_Shadow";
@@ -78,19 +79,29 @@ Graphics::Graphics(Display* aDisplay, World* aWorld)
 			SCI.EntryPoint = "main";
 			SCI.Desc.Name = "VS_shadow";
 			SCI.FilePath = "shadow.vsh";
+			SCI.Macros = GetInstancedMeshShaderMacros(format);
 			pDevice->CreateShader(SCI, &pVS);
 		}
 		PSODesc.GraphicsPipeline.pVS = pVS;
 		PSODesc.GraphicsPipeline.pPS = nullptr; // depth/vertex-shader only
-		PSODesc.GraphicsPipeline.InputLayout.LayoutElements = MeshVertexLayoutElems;
-		PSODesc.GraphicsPipeline.InputLayout.NumElements = _countof(MeshVertexLayoutElems);
+		PSODesc.GraphicsPipeline.InputLayout.LayoutElements = GetInstancedMeshLayoutElems(format);
+		PSODesc.GraphicsPipeline.InputLayout.NumElements = _countof(InstancedMeshVertexLayoutElems);
 		PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+		ShaderResourceVariableDesc Vars[]{
+			{SHADER_TYPE_VERTEX, "PassConstants", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE} // per cascade
+		};
+		PSODesc.ResourceLayout.Variables = Vars;
+		PSODesc.ResourceLayout.NumVariables = _countof(Vars);
 		PSODesc.GraphicsPipeline.RasterizerDesc.DepthClipEnable = false;
 		PSODesc.GraphicsPipeline.RasterizerDesc.DepthBias = 60;
 		PSODesc.GraphicsPipeline.RasterizerDesc.SlopeScaledDepthBias = 3.33f;
-		pDevice->CreatePipelineState(PCI, &pShadowPipelineState);
-		pShadowPipelineState->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(pRenderConstants);
-		pShadowPipelineState->CreateShaderResourceBinding(&pShadowResourceBinding, true);
+		pDevice->CreatePipelineState(PCI, &pShadowPipelineStates[format]);
+		BindRenderConstants(pShadowPipelineStates[format]);
+		for(int cascadeIdx=0; cascadeIdx<MAX_SHADOW_CASCADES; ++cascadeIdx) {
+			auto& pBinding = pShadowResourceBindings[cascadeIdx][format];
+			pShadowPipelineStates[format]->CreateShaderResourceBinding(&pBinding, true);
+			pBinding->GetVariableByName(SHADER_TYPE_VERTEX, "PassConstants")->Set(pPassConstants[1 + cascadeIdx]);
+		}
 	}
 
 	#if SHADOW_MAP_DEBUG
@@ -130,6 +141,11 @@ Graphics::Graphics(Display* aDisplay, World* aWorld)
 		PSODesc.GraphicsPipeline.pPS = pShadowMapDebugPS;
 		PSODesc.GraphicsPipeline.SmplDesc.Count = pDisplay->GetMultisampleCount();
 		PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE;
+		ShaderResourceVariableDesc Vars[]{
+			{SHADER_TYPE_PIXEL, "g_ShadowMap", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC} // rebound on resize
+		};
+		PSODesc.ResourceLayout.Variables = Vars;
+		PSODesc.ResourceLayout.NumVariables = _countof(Vars);
 		SamplerDesc SamLinearClampDesc{
 			FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR,
 			TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP
@@ -201,17 +217,10 @@ Graphics::Graphics(Display* aDisplay, World* aWorld)
 		pDevice->CreatePipelineState(Args, &pDebugWireframePSO);
 		CHECK_ASSERT(pDebugWireframePSO);
 
-		pDebugWireframePSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(GetRenderConstants());
+		BindRenderConstants(pDebugWireframePSO);
 		pDebugWireframePSO->CreateShaderResourceBinding(&pDebugWireframeSRB, true);
 
-		// Wireframe Vertex Buffer
-		BufferDesc VBD;
-		VBD.Name = "VB_DebugWireframe";
-		VBD.Usage = USAGE_DEFAULT; //USAGE_DYNAMIC;
-		VBD.BindFlags = BIND_VERTEX_BUFFER;
-		VBD.uiSizeInBytes = sizeof(lineBuf);
-		pDevice->CreateBuffer(VBD, nullptr, &pDebugWireframeBuf);
-		CHECK_ASSERT(pDebugWireframeBuf);
+		// (the wireframe vertex buffer is sized on demand by Draw())
 	}
 	#endif
 }
@@ -223,24 +232,205 @@ Graphics::~Graphics() {
 }
 
 void Graphics::Database_WillReleaseAsset(AssetDatabase* caller, ObjectID id) {
-	// TODO
+
+	// drop renderers which reference the asset (backwards, since removal swaps from the end)
+	for(int32 it=meshRenderers.Count()-1; it>=0; --it) {
+		let pData = meshRenderers.GetComponentByIndex<1>(it);
+		if (pData->pMesh->ID() == id || pData->pMaterial->ID() == id)
+			TryRemoveMeshRenderer(*meshRenderers.GetComponentByIndex<0>(it));
+	}
+
+	// drop passes for a released material
+	let pit = eastl::find_if(materialPasses.begin(), materialPasses.end(), [id](const auto& it) { return it.first->ID() == id; });
+	if (pit == materialPasses.end())
+		return;
+	let firstPassIdx = pit->second;
+	let passCount = pit->first->NumPasses();
+	materialPasses.erase(pit);
+	passes.erase(passes.begin() + firstPassIdx, passes.begin() + firstPassIdx + passCount);
+	for(auto& it : materialPasses)
+		if (it.second > firstPassIdx)
+			it.second -= passCount;
+	for(auto& it : items)
+		if (it.passIdx > firstPassIdx)
+			it.passIdx -= passCount;
 }
 
 void Graphics::Scene_WillReleaseObject(Scene* caller, ObjectID id) {
-	// TODO
+	TryRemoveMeshRenderer(id);
 }
 
 void Graphics::Skeleton_WillReleaseSkeleton(class SkelRegistry* Caller, ObjectID id) {
-	// TODO
+	// (no render state references skeletons yet)
 }
 
 void Graphics::Skeleton_WillReleaseSkelAsset(class SkelRegistry* Caller, ObjectID id) {
-	// TODO
+	// (no render state references skeletons yet)
+}
+
+void Graphics::SetShadowSettings(const ShadowSettings& settings) {
+	CHECK_ASSERT(settings.cascadeCount > 0 && settings.cascadeCount <= MAX_SHADOW_CASCADES);
+	CHECK_ASSERT(settings.resolution >= 16);
+	let bResize = settings.cascadeCount != shadowSettings.cascadeCount || settings.resolution != shadowSettings.resolution;
+	shadowSettings = settings;
+	if (bResize)
+		DoCreateShadowMap();
+}
+
+void Graphics::DoCreateShadowMap() {
+	let pDevice = pDisplay->GetDevice();
+	staticShadowsDirty = true;
+	if (pDevice == nullptr)
+		return;
+
+	// one array slice per cascade
+	TextureDesc SMDesc;
+	SMDesc.Name = "Shadow Map";
+	SMDesc.Type = RESOURCE_DIM_TEX_2D_ARRAY;
+	SMDesc.Width = shadowSettings.resolution;
+	SMDesc.Height = shadowSettings.resolution;
+	SMDesc.ArraySize = shadowSettings.cascadeCount;
+	SMDesc.Format = TEX_FORMAT_SHADOW_MAP;
+	SMDesc.BindFlags = BIND_SHADER_RESOURCE | BIND_DEPTH_STENCIL;
+	pShadowMap.Release();
+	pDevice->CreateTexture(SMDesc, nullptr, &pShadowMap);
+	CHECK_ASSERT(pShadowMap);
+	pShadowMapSRV = pShadowMap->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+	for(int it=0; it<MAX_SHADOW_CASCADES; ++it) {
+		pShadowCascadeDSVs[it].Release();
+		if (it >= shadowSettings.cascadeCount)
+			continue;
+		TextureViewDesc DSVDesc;
+		DSVDesc.ViewType = TEXTURE_VIEW_DEPTH_STENCIL;
+		DSVDesc.TextureDim = RESOURCE_DIM_TEX_2D_ARRAY;
+		DSVDesc.FirstArraySlice = it;
+		DSVDesc.NumArraySlices = 1;
+		pShadowMap->CreateView(DSVDesc, &pShadowCascadeDSVs[it]);
+	}
+
+	// static casters are cached in a matching array, and copied in before dynamic casters
+	SMDesc.Name = "Static Shadow Map";
+	SMDesc.BindFlags = BIND_DEPTH_STENCIL;
+	pStaticShadowMap.Release();
+	pDevice->CreateTexture(SMDesc, nullptr, &pStaticShadowMap);
+	CHECK_ASSERT(pStaticShadowMap);
+	for(int it=0; it<MAX_SHADOW_CASCADES; ++it) {
+		pStaticCascadeDSVs[it].Release();
+		if (it >= shadowSettings.cascadeCount)
+			continue;
+		TextureViewDesc DSVDesc;
+		DSVDesc.ViewType = TEXTURE_VIEW_DEPTH_STENCIL;
+		DSVDesc.TextureDim = RESOURCE_DIM_TEX_2D_ARRAY;
+		DSVDesc.FirstArraySlice = it;
+		DSVDesc.NumArraySlices = 1;
+		pStaticShadowMap->CreateView(DSVDesc, &pStaticCascadeDSVs[it]);
+	}
+
+	// rebind for anything which sampled the previous texture
+	for(auto& it : passes)
+		it.pMaterial->GetPass(it.materialPassIdx).SetShadowMap(pShadowMapSRV);
+	if (pShadowMapDebugSRB)
+		pShadowMapDebugSRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_ShadowMap")->Set(pShadowMapSRV);
+}
+
+void Graphics::DoFitShadowCascades(const DeviceCaps& caps) {
+	let& NDCAttribs = caps.GetNDCAttribs();
+	let IsGL = caps.IsGLDevice();
+
+	let lightz = lightDirection;
+	const vec3 referenceVec = lightz.y * lightz.y < lightz.z * lightz.z ? vec3(0, 1, 0) : vec3(0, 0, 1);
+	let lightx = glm::normalize(glm::cross(referenceVec, lightz));
+	let lighty = glm::cross(lightz, lightx);
+	let lightView = mat3(lightx, lighty, lightz);
+
+	// camera basis, and the half-extents of the view frustum at unit depth
+	let eyePosition = pov.pose.position;
+	let eyeRight = pov.pose.rotation * vec3(1, 0, 0);
+	let eyeUp = pov.pose.rotation * vec3(0, 1, 0);
+	let eyeForward = pov.pose.rotation * vec3(0, 0, 1);
+	let tanHalfFovy = glm::tan(0.5f * glm::radians(pov.fovy));
+	let tanHalfFovx = tanHalfFovy * pDisplay->GetAspect();
+
+	let count = shadowSettings.cascadeCount;
+	let zNear = pov.zNear;
+	let zFar = eastl::min(shadowSettings.distance, pov.zFar);
+	for(int it=0; it<count; ++it) {
+
+		// "practical" split scheme between logarithmic and uniform
+		let u = float(it + 1) / float(count);
+		let logSplit = zNear * glm::pow(zFar / zNear, u);
+		let uniformSplit = zNear + (zFar - zNear) * u;
+		let sliceFar = it == count - 1 ? zFar : glm::mix(uniformSplit, logSplit, shadowSettings.splitLambda);
+		let sliceNear = it == 0 ? zNear : cascades[it - 1].splitDepth;
+
+		// bound the slice with a sphere, so its size is stable as the camera rotates
+		vec3 corners[8];
+		for(int c=0; c<8; ++c) {
+			let depth = (c & 4) ? sliceFar : sliceNear;
+			let x = (c & 1) ? tanHalfFovx : -tanHalfFovx;
+			let y = (c & 2) ? tanHalfFovy : -tanHalfFovy;
+			corners[c] = eyePosition + depth * (eyeForward + x * eyeRight + y * eyeUp);
+		}
+		vec3 center (0.f, 0.f, 0.f);
+		for(let& c : corners)
+			center += 0.125f * c;
+		float radius = 0.f;
+		for(let& c : corners)
+			radius = eastl::max(radius, glm::length(c - center));
+		radius = glm::ceil(radius * 16.f) / 16.f;
+
+		// snap to a coarse light-space grid of whole texels, so static shadows don't shimmer,
+		// and the cascade transform (and its cached static layer) only changes when the camera
+		// crosses a grid cell (padding by a cell, so the snapped bounds still contain the slice)
+		auto lightCenter = glm::transpose(lightView) * center;
+		let snapTexels = eastl::max(1u, eastl::min(uint32(STATIC_SHADOW_SNAP * float(shadowSettings.resolution)), shadowSettings.resolution / 4));
+		let texelSize = 2.f * radius / float(shadowSettings.resolution - 2 * snapTexels);
+		let snapSize = float(snapTexels) * texelSize;
+		radius += snapSize;
+		lightCenter = glm::floor(lightCenter / snapSize) * snapSize;
+
+		// (casters nearer the light are depth-clamped by the shadow PSO, so the bounds only
+		// depend on the view and light, which keeps the static shadow layer cacheable)
+		let viewMin = lightCenter - vec3(radius, radius, radius);
+		let viewMax = lightCenter + vec3(radius, radius, radius);
+		let viewExtent = viewMax - viewMin;
+
+		// Apply bias to shift the extent to 
+		//    [-1,1]x[-1,1]x[0,1] for DX or to 
+		//    [-1,1]x[-1,1]x[-1,1] for GL
+		// Find bias such that sceneMin -> 
+		//    (-1,-1,0) for DX or 
+		//    (-1,-1,-1) for GL
+		const vec3 lightSpaceScale (
+			2.f / viewExtent.x,
+			2.f / viewExtent.y,
+			(IsGL ? 2.f : 1.f) / viewExtent.z
+		);
+		const vec3 lightSpaceScaledBias (
+			-viewMin.x * lightSpaceScale.x - 1.f,
+			-viewMin.y * lightSpaceScale.y - 1.f,
+			-viewMin.z * lightSpaceScale.z + (IsGL ? -1.f : 0.f)
+		);
+
+		auto& cascade = cascades[it];
+		cascade.splitDepth = sliceFar;
+		cascade.worldToLightProjSpace = 
+			glm::translate(lightSpaceScaledBias) * // offset to cascade center
+			glm::scale(lightSpaceScale) *          // scale to cascade extents
+			mat4(glm::transpose(lightView));       // view matrix of directional light
+		cascade.worldToShadowMapUVDepth = 
+			glm::translate(vec3(0.5f, 0.5f, NDCAttribs.GetZtoDepthBias())) *         // to UV bias
+			glm::scale(vec3(0.5f, NDCAttribs.YtoVScale, NDCAttribs.ZtoDepthScale)) * // to UV scale
+			cascade.worldToLightProjSpace;
+	}
 }
 
 void Graphics::AddRenderPasses(Material* pMaterial) {
+	if (materialPasses.find(pMaterial) != materialPasses.end())
+		return;
+	materialPasses[pMaterial] = int32(passes.size());
 	for (int it = 0; it < pMaterial->NumPasses(); ++it)
-		passes.push_back(RenderPass{ pMaterial, it, 0 });
+		passes.push_back(RenderPass{ pMaterial, it });
 }
 
 bool Graphics::AddMeshRenderer(ObjectID id, const RenderMeshData& data) {
@@ -255,41 +445,390 @@ bool Graphics::AddMeshRenderer(ObjectID id, const RenderMeshData& data) {
 	if (data.pMaterial == nullptr)
 		return false;
 
-	if (!meshRenderers.TryAppendObject(id, data))
+	let proxy = spatialIndex.CreateProxy(DoGetRendererBounds(id, data), id);
+	if (!meshRenderers.TryAppendObject(id, data, INVALID_INDEX, proxy)) {
+		spatialIndex.DestroyProxy(proxy);
 		return false;
+	}
 
-	// add render items, update render passes
-	int itemIdx = 0;
-	for (auto pit = passes.begin(); pit != passes.end(); ++pit)
-	{
-		if (pit->pMaterial == data.pMaterial)
-		{
-			for (uint16 submeshIdx = 0; submeshIdx < data.pMesh->GetSubmeshCount(); ++submeshIdx) 
-			{
-				items.insert(items.begin() + itemIdx, RenderItem { data.pMesh, id, submeshIdx, data.castsShadow });
-			}
-			pit->itemCount += data.pMesh->GetSubmeshCount();
+	DoAddRenderItems(id, data);
+	return true;
+}
+
+bool Graphics::TryRemoveMeshRenderer(ObjectID id) {
+	if (!meshRenderers.Contains(id))
+		return false;
+
+	DoRemoveRenderItems(id);
+	spatialIndex.DestroyProxy(*meshRenderers.TryGetComponent<3>(id));
+	return meshRenderers.TryReleaseObject_Swap(id);
+}
+
+AABB Graphics::DoGetRendererBounds(ObjectID id, const RenderMeshData& data) {
+	let pose = pWorld->scene.GetSublevelHierarchyFor(id)->GetCurrentScenePose(id);
+	return data.pMesh->GetBoundingBox().GetTransformed(pose.ToMatrix());
+}
+
+void Graphics::UpdateSpatialIndex() {
+	// only renderers on the hierarchies' moved lists are refit (bounds are recomputed in 
+	// parallel, since poses are flushed, but only renderers which left their fattened boxes
+	// are reinserted)
+	pWorld->scene.FlushScenePoses();
+	movedRenderers.clear();
+	let sublevelCount = pWorld->scene.GetSublevelCount();
+	for(int32 sub=0; sub<sublevelCount; ++sub) {
+		let pHierarchy = pWorld->scene.GetHierarchyByIndex(sub);
+		for(let id : pHierarchy->GetMovedObjects()) {
+			let rendererIdx = meshRenderers.IndexOf(id);
+			if (rendererIdx != INVALID_INDEX)
+				movedRenderers.push_back(rendererIdx);
+		}
+		pHierarchy->ClearMovedObjects();
+	}
+
+	let count = int32(movedRenderers.size());
+	rendererBounds.resize(count);
+	pWorld->jobs.ParallelFor(count, 1024, [this](int32 begin, int32 end) {
+		for(auto it=begin; it<end; ++it) {
+			let idx = movedRenderers[it];
+			rendererBounds[it] = DoGetRendererBounds(*meshRenderers.GetComponentByIndex<0>(idx), *meshRenderers.GetComponentByIndex<1>(idx));
 		}
-		itemIdx += pit->itemCount;
+	});
+	for(int32 it=0; it<count; ++it) {
+		let rendererIdx = movedRenderers[it];
+		spatialIndex.MoveProxy(*meshRenderers.GetComponentByIndex<3>(rendererIdx), rendererBounds[it]);
+		for(auto idx = *meshRenderers.GetComponentByIndex<2>(rendererIdx); idx != INVALID_INDEX; idx = items[idx].nextItemIdx)
+			items[idx].moved = 1;
 	}
+}
 
+bool Graphics::TrySetMeshRendererMaterial(ObjectID id, Material* pMaterial) {
+	let pData = meshRenderers.TryGetComponent<1>(id);
+	if (pData == nullptr || pMaterial == nullptr)
+		return false;
+
+	DoRemoveRenderItems(id);
+	pData->pMaterial = pMaterial;
+	DoAddRenderItems(id, *pData);
 	return true;
 }
 
+void Graphics::DoAddRenderItems(ObjectID id, const RenderMeshData& data) {
+	// add one item per pass, chained from the renderer (draw order is rebuilt
+	// by the render queue each frame, so items are unordered)
+	let pit = materialPasses.find(data.pMaterial);
+	if (pit == materialPasses.end())
+		return;
+
+	// (draws may be recorded on deferred contexts, which can't transition buffers)
+	if (let pContext = pDisplay->GetContext())
+		for (int lodIdx = 0; lodIdx < data.pMesh->GetLodCount(); ++lodIdx)
+			if (data.pMesh->GetLod(lodIdx)->IsLoaded())
+				data.pMesh->GetLod(lodIdx)->DoTransitionBuffers(pContext);
+
+	// (shadows and occluders stand in for the whole mesh, so only the first item of each
+	// renderer casts or occludes -- the shadow pass ignores materials anyway)
+	auto pFirstItemIdx = meshRenderers.TryGetComponent<2>(id);
+	for (int passIdx = pit->second; passIdx < pit->second + data.pMaterial->NumPasses(); ++passIdx)
+	{
+		let bFirst = passIdx == pit->second;
+		let occluder = !bFirst ? OCCLUDER_NEVER : data.isOccluder ? OCCLUDER_ALWAYS : OCCLUDER_AUTO;
+		let shadows = bFirst && data.castsShadow;
+		items.push_back(RenderItem { data.pMesh, id, uint16(passIdx), shadows, uint8(occluder), 0, 0, 1, 0, *pFirstItemIdx });
+		*pFirstItemIdx = int32(items.size()) - 1;
+	}
+}
+
+void Graphics::DoRemoveRenderItems(ObjectID id) {
+	auto pFirstItemIdx = meshRenderers.TryGetComponent<2>(id);
+	while(*pFirstItemIdx != INVALID_INDEX) {
+		let idx = *pFirstItemIdx;
+		*pFirstItemIdx = items[idx].nextItemIdx;
+		if (items[idx].IsStaticCaster())
+			staticShadowsDirty = true;
+
+		// swap-remove, re-linking the tail item from whichever chain points to it
+		let lastIdx = int32(items.size()) - 1;
+		if (idx < lastIdx) {
+			items[idx] = items[lastIdx];
+			auto pLink = meshRenderers.TryGetComponent<2>(items[idx].id);
+			while(*pLink != lastIdx)
+				pLink = &items[*pLink].nextItemIdx;
+			*pLink = idx;
+		}
+		items.pop_back();
+	}
+}
+
+int32 Graphics::DoQueryFrustumItems(const FrustumPlanes& frustum) {
+	// visit renderers through the spatial index, writing all their items to visibleItems
+	int32 count = 0;
+	spatialIndex.QueryFrustum(frustum, [this, &count](int32 proxy) {
+		let rendererIdx = meshRenderers.IndexOf(spatialIndex.GetObject(proxy));
+		for(auto idx = *meshRenderers.GetComponentByIndex<2>(rendererIdx); idx != INVALID_INDEX; idx = items[idx].nextItemIdx)
+			visibleItems[count++] = idx;
+		return true;
+	});
+	return count;
+}
+
+int32 Graphics::DoCullOccludedItems(const mat4& view, const mat4& viewProjection, int32 visibleCount) {
+	#if OCCLUSION_CULLING
+	// pick the visible occluders which look largest (box diagonal over view depth)
+	occluderCandidates.clear();
+	for(int32 it=0; it<visibleCount; ++it) {
+		let idx = visibleItems[it];
+		let& item = items[idx];
+		if (item.occluder == OCCLUDER_NEVER)
+			continue;
+		let size = glm::length(boundingBoxes[idx].Size());
+		if (item.occluder == OCCLUDER_AUTO && (OCCLUSION_AUTO_OCCLUDER_SIZE <= 0.f || size < OCCLUSION_AUTO_OCCLUDER_SIZE))
+			continue;
+		let viewDepth = eastl::max((view * vec4(boundingBoxes[idx].Center(), 1.f)).z, pov.zNear);
+		occluderCandidates.push_back(eastl::make_pair(size / viewDepth, idx));
+	}
+	if (occluderCandidates.empty())
+		return visibleCount;
+	if (occluderCandidates.size() > OCCLUSION_MAX_OCCLUDERS) {
+		let GreaterSize = [](const eastl::pair<float, int32>& lhs, const eastl::pair<float, int32>& rhs) { return lhs.first > rhs.first; };
+		eastl::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + OCCLUSION_MAX_OCCLUDERS, occluderCandidates.end(), GreaterSize);
+		occluderCandidates.resize(OCCLUSION_MAX_OCCLUDERS);
+	}
+
+	// rasterize occluder boxes (auto-selected ones shrunk, as their meshes needn't fill them)
+	occlusionBuffer.Begin(viewProjection);
+	for(let& candidate : occluderCandidates) {
+		let& item = items[candidate.second];
+		auto box = item.pMesh->GetBoundingBox();
+		if (item.occluder == OCCLUDER_AUTO) {
+			let center = box.Center();
+			let extent = OCCLUSION_AUTO_OCCLUDER_SHRINK * box.Extent();
+			box = AABB(center - extent, center + extent);
+		}
+		occlusionBuffer.TryAddOccluder(matrices[candidate.second], box);
+	}
+	occlusionBuffer.Rasterize(pWorld->jobs);
+	renderStats.occluderCount = occlusionBuffer.GetOccluderCount();
+
+	// test the rest against it, and compact the survivors in order (occluders are
+	// tested too, since one can hide another)
+	pWorld->jobs.ParallelFor(visibleCount, 256, [this](int32 begin, int32 end) {
+		for(auto it=begin; it<end; ++it)
+			if (!occlusionBuffer.IsVisible(boundingBoxes[visibleItems[it]]))
+				visibleItems[it] = INVALID_INDEX;
+	});
+	int32 count = 0;
+	for(int32 it=0; it<visibleCount; ++it)
+		if (visibleItems[it] != INVALID_INDEX)
+			visibleItems[count++] = visibleItems[it];
+	return count;
+	#else
+	return visibleCount;
+	#endif
+}
+
 void Graphics::DrawDebugLine(const vec4& color, const vec3& start, const vec3& end) {
 	#if TRINKET_TEST
+	debugLines.DrawLine(color, start, end);
+	#endif
+}
+
+// Render queue sort keys, most significant field first:
+//   [63..60] layer   (opaque only, for now)
+//   [59..48] pass    (index into passes, i.e. material PSO + SRB)
+//   [47]     vertex format (which of the pass's PSOs)
+//   [46..27] mesh    (object index)
+//   [26..25] LOD
+//   [24..0]  depth   (view depth float bits, so opaque draws are front-to-back)
+// Entries which differ only in depth share all draw state, and draw as one instanced run.
+#define RENDER_KEY_LAYER_OPAQUE 0ull
+#define RENDER_KEY_PASS_MASK    (0xfffull << 48)
+#define RENDER_KEY_FORMAT_SHIFT 47
+#define RENDER_KEY_GROUP_MASK   (~0x1ffffffull)
+
+uint64 Graphics::GetSortKey(const RenderItem& item, float viewDepth) const {
+	CHECK_ASSERT(item.passIdx < (1 << 12));
+	static_assert(MESH_MAX_LODS <= (1 << 2));
+	static_assert(MESH_VERTEX_FORMAT_COUNT <= 2);
+	let meshID = item.pMesh->ID();
+	let meshIdx = uint64((meshID.pageIdx << OBJ_ITEM_BITS) | meshID.itemIdx);
 
-	if (lineCount >= DEBUG_LINE_CAPACITY)
+	// non-negative floats sort the same as their bits
+	let depth = eastl::max(viewDepth, 0.f);
+	uint32 depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	
+	return
+		(RENDER_KEY_LAYER_OPAQUE << 60) |
+		(uint64(item.passIdx) << 48) |
+		(uint64(item.pMesh->GetVertexFormat()) << RENDER_KEY_FORMAT_SHIFT) |
+		(meshIdx << 27) |
+		(uint64(item.lodIdx) << 25) |
+		uint64(depthBits >> 6);
+}
+
+template<typename T>
+static void RadixSortByKey(T* pEntries, T* pScratch, int32 count) {
+	// stable LSD radix sort on 8-bit digits, building every histogram in one sweep
+	if (count < 2)
 		return;
 
-	let idx = lineCount << 1;
-	lineBuf[idx].position = start;
-	lineBuf[idx].color = color;
-	lineBuf[idx+1].position = end;
-	lineBuf[idx+1].color = color;
-	++lineCount;
+	uint32 histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for(int32 it=0; it<count; ++it) {
+		let key = pEntries[it].key;
+		for(int digit=0; digit<8; ++digit)
+			++histograms[digit][(key >> (digit << 3)) & 0xff];
+	}
 
-	#endif
+	auto pSrc = pEntries;
+	auto pDst = pScratch;
+	for(int digit=0; digit<8; ++digit) {
+		auto& histogram = histograms[digit];
+		let shift = digit << 3;
+
+		// skip digits which every key shares (e.g. the layer, or a single pass)
+		if (histogram[(pSrc[0].key >> shift) & 0xff] == uint32(count))
+			continue;
+
+		uint32 offset = 0;
+		for(auto& bucket : histogram) {
+			let n = bucket;
+			bucket = offset;
+			offset += n;
+		}
+		for(int32 it=0; it<count; ++it)
+			pDst[histogram[(pSrc[it].key >> shift) & 0xff]++] = pSrc[it];
+		eastl::swap(pSrc, pDst);
+	}
+
+	if (pSrc != pEntries)
+		memcpy(pEntries, pSrc, count * sizeof(T));
+}
+
+void Graphics::BindRenderConstants(IPipelineState* pPSO) {
+	// (the compiler strips whichever constants a stage doesn't read)
+	for(let shaderType : { SHADER_TYPE_VERTEX, SHADER_TYPE_PIXEL }) {
+		if (let pVar = pPSO->GetStaticVariableByName(shaderType, "FrameConstants"))
+			pVar->Set(pFrameConstants);
+		if (let pVar = pPSO->GetStaticVariableByName(shaderType, "PassConstants"))
+			pVar->Set(pPassConstants[0]);
+	}
+}
+
+void Graphics::DoWritePassConstants(IDeviceContext* pContext, int32 cascadeIdx, const mat4& viewProjection) {
+	if (pContext) {
+		PassConstants constants;
+		constants.ViewProjectionTransform = viewProjection;
+		pContext->UpdateBuffer(pPassConstants[1 + cascadeIdx], 0, sizeof(PassConstants), &constants, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+	}
+	++renderStats.mapCount;
+	renderStats.uploadBytes += sizeof(PassConstants);
+}
+
+void Graphics::DoAddRenderTasks(const RenderQueueEntry* pQueue, int32 count, int32 firstInstance, ITextureView* pRTV, ITextureView* pDSV, int32 cascadeIdx, int32 copyStaticCascade, bool bClear) {
+	// split into chunks (always at least one, for the clear or copy); only the first waits
+	// for the copy or clears, and runs split across chunks just cost an extra draw
+	int32 chunkStart = 0;
+	do {
+		let chunkCount = eastl::min(count - chunkStart, RENDER_TASK_GRAIN);
+		renderTasks.push_back();
+		auto& task = renderTasks.back();
+		task.pQueue = pQueue + chunkStart;
+		task.count = chunkCount;
+		task.firstInstance = firstInstance + chunkStart;
+		task.pRTV = pRTV;
+		task.pDSV = pDSV;
+		task.cascadeIdx = cascadeIdx;
+		task.copyStaticCascade = chunkStart == 0 ? copyStaticCascade : -1;
+		task.bClear = bClear && chunkStart == 0;
+		memset(&task.stats, 0, sizeof(task.stats));
+		chunkStart += chunkCount;
+	} while(chunkStart < count);
+}
+
+void Graphics::DoRecordRenderTask(IDeviceContext* pContext, RenderTask& task, RESOURCE_STATE_TRANSITION_MODE transitionMode) {
+	// (command lists don't inherit state, so each binds everything it uses; with no
+	// context, as when headless, this only validates and tallies)
+	CHECK_ASSERT(task.firstInstance >= 0 && task.firstInstance + task.count <= int32(instanceCapacity));
+	if (pContext) {
+		pContext->SetRenderTargets(task.pRTV ? 1 : 0, task.pRTV ? &task.pRTV : nullptr, task.pDSV, transitionMode);
+		if (task.bClear)
+			pContext->ClearDepthStencil(task.pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, transitionMode);
+	}
+	if (task.count == 0)
+		return;
+
+	// mesh binds only replace slot 0, and runs address the instance stream by first instance
+	if (pContext) {
+		uint32 offset = 0;
+		IBuffer* pBuffers[]{ pInstanceBuffer };
+		pContext->SetVertexBuffers(1, 1, pBuffers, &offset, transitionMode, SET_VERTEX_BUFFERS_FLAG_RESET);
+	}
+	++task.stats.vertexBufferBindCount;
+
+	DoDrawRenderQueue(pContext, task.pQueue, task.count, task.firstInstance, task.cascadeIdx, transitionMode, task.stats);
+}
+
+void Graphics::DoDrawRenderQueue(IDeviceContext* pContext, const RenderQueueEntry* pQueue, int32 count, int32 firstInstance, int32 cascadeIdx, RESOURCE_STATE_TRANSITION_MODE transitionMode, RenderStats& stats) {
+	let bindPasses = cascadeIdx < 0;
+	SubMesh* pBoundSubmesh = nullptr;
+	int boundPassIdx = -1;
+	int boundFormat = -1;
+	bool bPassLoaded = true;
+
+	int32 runStart = 0;
+	while(runStart < count) {
+		let groupKey = pQueue[runStart].key & RENDER_KEY_GROUP_MASK;
+		int32 runEnd = runStart + 1;
+		while(runEnd < count && (pQueue[runEnd].key & RENDER_KEY_GROUP_MASK) == groupKey)
+			++runEnd;
+
+		// only touch state which changed since the previous run (each material pass
+		// owns a PSO and SRB per vertex format, so they change with either; without
+		// passes, the shadow PSO for the format is bound with the cascade's constants)
+		let& item = items[pQueue[runStart].itemIdx];
+		let format = int(item.pMesh->GetVertexFormat());
+		if (bindPasses && (item.passIdx != boundPassIdx || format != boundFormat)) {
+			boundPassIdx = item.passIdx;
+			boundFormat = format;
+			auto& materialPass = passes[boundPassIdx].pMaterial->GetPass(passes[boundPassIdx].materialPassIdx);
+			bPassLoaded = materialPass.IsLoaded();
+			if (bPassLoaded) {
+				if (pContext) {
+					pContext->SetPipelineState(materialPass.GetPipelineState(format));
+					pContext->CommitShaderResources(materialPass.GetResourceBinding(format), transitionMode);
+				}
+				++stats.psoBindCount;
+				++stats.srbCommitCount;
+			}
+		} else if (!bindPasses && format != boundFormat) {
+			boundFormat = format;
+			if (pContext) {
+				pContext->SetPipelineState(pShadowPipelineStates[format]);
+				pContext->CommitShaderResources(pShadowResourceBindings[cascadeIdx][format], transitionMode);
+			}
+			++stats.psoBindCount;
+			++stats.srbCommitCount;
+		}
+
+		if (bPassLoaded) {
+			let pSubmesh = item.pMesh->GetLod(item.lodIdx);
+			CHECK_ASSERT(pSubmesh->IsLoaded());
+			if (pSubmesh != pBoundSubmesh) {
+				pBoundSubmesh = pSubmesh;
+				if (pContext)
+					pSubmesh->Bind(pContext, transitionMode);
+				++stats.vertexBufferBindCount;
+			}
+			if (pContext)
+				pSubmesh->DoDrawInstanced(pContext, firstInstance + runStart, runEnd - runStart);
+			++stats.drawCount;
+			stats.triangleCount += pSubmesh->GetTriangleCount() * uint32(runEnd - runStart);
+		}
+
+		runStart = runEnd;
+	}
 }
 
 void Graphics::Draw() {
@@ -297,138 +836,369 @@ void Graphics::Draw() {
 	let pSwapChain = pDisplay->GetSwapChain();
 	let pContext = pDisplay->GetContext();
 
-	const auto& DevCaps = pDevice->GetDeviceCaps();
-	const auto& NDCAttribs = DevCaps.GetNDCAttribs();
+	static const DeviceCaps HeadlessCaps;
+	const auto& DevCaps = pDevice ? pDevice->GetDeviceCaps() : HeadlessCaps;
 	const bool  IsGL = DevCaps.IsGLDevice();
 
 	// get transforms, bounding boxes
 	if (matrices.size() < items.size()) {
 		matrices.resize(items.size());
 		boundingBoxes.resize(items.size());
+		visibleItems.resize(items.size());
+		shadowQueue.resize(items.size() * MAX_SHADOW_CASCADES);
+		renderQueue.resize(items.size());
+		queueScratch.resize(items.size() * MAX_SHADOW_CASCADES);
 	}
-	for(uint it=0; it<items.size(); ++it)
-	{
-		let& item = items[it];
-		let pHierarchy = pWorld->scene.GetSublevelHierarchyFor(item.id);
-		let pPose = pHierarchy->GetScenePose(item.id);
-		matrices[it] = pPose->ToMatrix();
-		boundingBoxes[it] = item.pMesh->GetBoundingBox().GetTransformed(matrices[it]);
-	}
+	// flush any pose writes since World::Update (refitting the spatial index to them), so
+	// the jobs below only read scene poses and culling sees current bounds
+	UpdateSpatialIndex();
+	let view = pov.pose.Inverse().ToMatrix();
+	let lodScale = 1.f / glm::tan(0.5f * glm::radians(pov.fovy));
+	pWorld->jobs.ParallelFor(int32(items.size()), 1024, [this, &view, lodScale](int32 begin, int32 end) {
+		for(auto it=begin; it<end; ++it) {
+			auto& item = items[it];
+			let pHierarchy = pWorld->scene.GetSublevelHierarchyFor(item.id);
+			let pPose = pHierarchy->GetScenePose(item.id);
+			let matrix = pPose->ToMatrix();
 
-	// draw shadow map
-	let lightz = lightDirection;
-	const vec3 referenceVec = lightz.y * lightz.y < lightz.z * lightz.z ? vec3(0, 1, 0) : vec3(0, 0, 1);
-	let lightx = glm::normalize(glm::cross(referenceVec, lightz));
-	let lighty = glm::cross(lightz, lightx);
+			// items which haven't moved (by the hierarchy's moved list, see UpdateSpatialIndex)
+			// and aren't awake in physics for a while are static
+			let bWasStatic = item.stillFrames >= STATIC_SHADOW_FRAMES;
+			let bMoved = item.moved || pWorld->phys.IsAwake(item.id);
+			item.moved = 0;
+			item.stillFrames = bMoved ? 0 : uint16(eastl::min(item.stillFrames + 1, STATIC_SHADOW_FRAMES));
+			item.staticChanged = bWasStatic != (item.stillFrames >= STATIC_SHADOW_FRAMES);
 
-	// TODO: actually calculate view bounds
-	float  r = 5.f;
-	const vec3 viewCenter (0.f, 0.f, 0.f);
-	let viewMin = viewCenter - vec3(r, r, r);
-	let viewMax = viewCenter + vec3(r, r, r);
-	let viewExtent = viewMax - viewMin;
-
-	// Apply bias to shift the extent to 
-	//    [-1,1]x[-1,1]x[0,1] for DX or to 
-	//    [-1,1]x[-1,1]x[-1,1] for GL
-	// Find bias such that sceneMin -> 
-	//    (-1,-1,0) for DX or 
-	//    (-1,-1,-1) for GL
-	const vec3 lightSpaceScale (
-		2.f / viewExtent.x,
-		2.f / viewExtent.y,
-		(IsGL ? 2.f : 1.f) / viewExtent.z
-	);
-	const vec3 lightSpaceScaledBias (
-		-viewMin.x * lightSpaceScale.x - 1.f,
-		-viewMin.y * lightSpaceScale.y - 1.f,
-		-viewMin.z * lightSpaceScale.z + (IsGL ? -1.f : 0.f)
-	);
-
-	let worldToLightProjSpace = 
-		glm::translate(lightSpaceScaledBias) *              // offset to scene center
-		glm::scale(lightSpaceScale) *                       // scale to scene extents
-		mat4(glm::transpose(mat3(lightx, lighty, lightz))); // view matrix of directional light
-
-	let worldToShadowMapUVDepth = 
-		glm::translate(vec3(0.5f, 0.5f, NDCAttribs.GetZtoDepthBias())) *         // to UV bias
-		glm::scale(vec3(0.5f, NDCAttribs.YtoVScale, NDCAttribs.ZtoDepthScale)) * // to UV scale
-		worldToLightProjSpace;
+			matrices[it] = matrix;
+			boundingBoxes[it] = item.pMesh->GetBoundingBox().GetTransformed(matrix);
 
-	{
-		pContext->SetRenderTargets(0, nullptr, pShadowMapDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-		pContext->ClearDepthStencil(pShadowMapDSV, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-		pContext->SetPipelineState(pShadowPipelineState);
-		pContext->CommitShaderResources(pShadowResourceBinding, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-		for(auto it=0u; it<items.size(); ++it) {
-			let& item = items[it];
-			if (item.shadows) {
-				{
-					MapHelper<RenderConstants> CBConstants(pContext, pRenderConstants, MAP_WRITE, MAP_FLAG_DISCARD);
-					CBConstants->ModelViewProjectionTransform = worldToLightProjSpace * matrices[it];
-				}
-				item.pMesh->GetSubmesh(item.submeshIdx)->DoDraw(pContext);
+			// pick the LOD by projected size, only switching once the size is clear of the
+			// threshold by the hysteresis (shadow passes reuse the view's choice)
+			let lodCount = item.pMesh->GetLodCount();
+			if (lodCount > 1) {
+				let& box = boundingBoxes[it];
+				let viewDepth = eastl::max((view * vec4(box.Center(), 1.f)).z, pov.zNear);
+				let screenSize = 0.5f * glm::length(box.Size()) * lodScale / viewDepth;
+				let LodThreshold = [](int lodIdx) { return MESH_LOD_SCREEN_SIZE * glm::pow(0.5f, float(lodIdx - 1)); };
+				int lodIdx = eastl::min(int(item.lodIdx), lodCount - 1);
+				while(lodIdx + 1 < lodCount && screenSize < LodThreshold(lodIdx + 1) * (1.f - MESH_LOD_HYSTERESIS))
+					++lodIdx;
+				while(lodIdx > 0 && screenSize > LodThreshold(lodIdx) * (1.f + MESH_LOD_HYSTERESIS))
+					--lodIdx;
+				item.lodIdx = uint8(lodIdx);
 			}
 		}
+	});
+
+	// fit shadow cascades to the view
+	memset(&renderStats, 0, sizeof(renderStats));
+	let itemCount = int32(items.size());
+	let lightz = lightDirection;
+	DoFitShadowCascades(DevCaps);
+
+	// the static shadow layer of a cascade is reused unless its transform changed (the view
+	// or light moved) or a static caster was added, removed, moved or settled
+	int32 casterCount = 0;
+	for(let& it : items) {
+		casterCount += it.shadows ? 1 : 0;
+		staticShadowsDirty |= it.shadows && it.staticChanged;
+	}
+	let cascadeCount = shadowSettings.cascadeCount;
+	bool cascadeCached[MAX_SHADOW_CASCADES];
+	for(int cascadeIdx=0; cascadeIdx<cascadeCount; ++cascadeIdx) {
+		auto& cascade = cascades[cascadeIdx];
+		cascadeCached[cascadeIdx] = !staticShadowsDirty && cascade.staticWorldToLightProjSpace == cascade.worldToLightProjSpace;
+		cascade.staticWorldToLightProjSpace = cascade.worldToLightProjSpace;
+		if (cascadeCached[cascadeIdx])
+			++renderStats.staticShadowCacheHits;
+		else
+			++renderStats.staticShadowInvalidations;
 	}
+	staticShadowsDirty = false;
 
-	// draw material passes
-	let view = pov.pose.Inverse().ToMatrix();
+	// cull shadow casters against each cascade, and queue them by cascade, static/dynamic and
+	// mesh -- the shadow pass shares one PSO, so casters are grouped across all materials
+	int32 segmentStarts[2 * MAX_SHADOW_CASCADES + 1];
+	int32 segmentCounts[2 * MAX_SHADOW_CASCADES] = {};
+	int32 shadowCasterCount = 0;
+	int32 visibleCasterCount = 0;
+	for(int cascadeIdx=0; cascadeIdx<cascadeCount; ++cascadeIdx) {
+		auto cascadeFrustum = FrustumPlanes::FromMatrix(cascades[cascadeIdx].worldToLightProjSpace, IsGL);
+		cascadeFrustum.planes[4] = Plane(vec3(0.f, 0.f, 0.f), 0.f); // (casters nearer the light are clamped, not clipped)
+		let nVisible = DoQueryFrustumItems(cascadeFrustum);
+		for(int32 it=0; it<nVisible; ++it) {
+			let idx = visibleItems[it];
+			let& item = items[idx];
+			if (!item.shadows)
+				continue;
+			++visibleCasterCount;
+			let bStatic = item.IsStaticCaster();
+			if (bStatic && cascadeCached[cascadeIdx])
+				continue;
+
+			// (the segment stands in for the layer)
+			let segment = 2 * cascadeIdx + (bStatic ? 0 : 1);
+			shadowQueue[shadowCasterCount++] = RenderQueueEntry { (uint64(segment) << 60) | (GetSortKey(item, 0.f) & ~RENDER_KEY_PASS_MASK), idx };
+			++segmentCounts[segment];
+		}
+	}
+	segmentStarts[0] = 0;
+	for(int it=0; it<2 * cascadeCount; ++it)
+		segmentStarts[it + 1] = segmentStarts[it] + segmentCounts[it];
+	renderStats.shadowCasterCount = shadowCasterCount;
+	renderStats.culledShadowCasterCount = casterCount * cascadeCount - visibleCasterCount;
+
+	// cull against the view frustum, and queue visible items by pass, mesh and depth
 	let aspect = pDisplay->GetAspect();
 	let viewProjection = glm::perspective(glm::radians(pov.fovy), aspect, pov.zNear, pov.zFar) * view;
-	pDisplay->SetMultisamplingTargetAndClear();
+	let viewFrustum = FrustumPlanes::FromMatrix(viewProjection, IsGL);
+	let frustumVisibleCount = DoQueryFrustumItems(viewFrustum);
+	let visibleCount = DoCullOccludedItems(view, viewProjection, frustumVisibleCount);
+	renderStats.visibleCount = visibleCount;
+	renderStats.culledCount = itemCount - frustumVisibleCount;
+	renderStats.occludedCount = frustumVisibleCount - visibleCount;
+	pWorld->jobs.ParallelFor(visibleCount, 1024, [this, &view](int32 begin, int32 end) {
+		for(auto it=begin; it<end; ++it) {
+			let idx = visibleItems[it];
+			let viewDepth = (view * vec4(boundingBoxes[idx].Center(), 1.f)).z;
+			renderQueue[it] = RenderQueueEntry { GetSortKey(items[idx], viewDepth), idx };
+		}
+	});
 
-	int itemIdx=0;
-	for(auto& pass : passes) {
-		let bSkip = pass.itemCount == 0 || !pass.pMaterial->GetPass(pass.materialPassIdx).Bind(this);
-		if (bSkip)
-			continue;
-		for(int it=0; it<pass.itemCount; ++it) {
-			let& item = items[itemIdx + it];
-			let& pose = matrices[itemIdx + it];
-			let normalXf = glm::inverseTranspose(mat3(pose));
-			let mvp = viewProjection * pose;
-			let mv = view * pose;
-			{
-					MapHelper<RenderConstants> CBConstants(pContext, pRenderConstants, MAP_WRITE, MAP_FLAG_DISCARD);
-					CBConstants->ModelViewProjectionTransform = mvp;
-					CBConstants->ModelViewTransform = mv;
-					CBConstants->ModelTransform = pose;
-					CBConstants->NormalTransform = normalXf;
-					CBConstants->SceneToShadowMapUVDepth = worldToShadowMapUVDepth;
-					CBConstants->LightDirection = vec4(lightz, 0);
+	RadixSortByKey(shadowQueue.data(), queueScratch.data(), shadowCasterCount);
+	RadixSortByKey(renderQueue.data(), queueScratch.data(), visibleCount);
+
+	// write the per-frame instance stream: shadow casters, then visible items, in queue order
+	let instanceCount = uint32(shadowCasterCount + visibleCount);
+	if (instanceCount > instanceCapacity) {
+		instanceCapacity = eastl::max(instanceCount, instanceCapacity + (instanceCapacity >> 1));
+		pInstanceBuffer.Release();
+		BufferDesc BD;
+		BD.Name = "VB_MeshInstances";
+		BD.uiSizeInBytes = instanceCapacity * sizeof(MeshInstance);
+		// (dynamic buffers can't be shared across contexts; the stream is rewritten in full
+		// each frame with a single update, staged through the device's own upload ring, so
+		// a ring of our own wouldn't save a copy)
+		BD.Usage = USAGE_DEFAULT;
+		BD.BindFlags = BIND_VERTEX_BUFFER;
+		if (pDevice) {
+			pDevice->CreateBuffer(BD, nullptr, &pInstanceBuffer);
+			CHECK_ASSERT(pInstanceBuffer);
+		}
+		instanceData.resize(instanceCapacity);
+	}
+	MeshInstance* pInstances = instanceData.data();
+	pWorld->jobs.ParallelFor(shadowCasterCount, 1024, [this, pInstances](int32 begin, int32 end) {
+		// the shadow VS doesn't read normals
+		for(auto it=begin; it<end; ++it) {
+			let idx = shadowQueue[it].itemIdx;
+			let pMesh = items[idx].pMesh;
+			pInstances[it].ModelTransform = pMesh->IsCompressed() ? matrices[idx] * pMesh->GetVertexTransform() : matrices[idx];
+		}
+	});
+	pInstances += shadowCasterCount;
+	pWorld->jobs.ParallelFor(visibleCount, 1024, [this, pInstances](int32 begin, int32 end) {
+		// (compressed meshes fold position decompression into the model transform, which
+		// their normals don't see)
+		for(auto it=begin; it<end; ++it) {
+			let idx = renderQueue[it].itemIdx;
+			let pMesh = items[idx].pMesh;
+			let& pose = matrices[idx];
+			pInstances[it].ModelTransform = pMesh->IsCompressed() ? pose * pMesh->GetVertexTransform() : pose;
+			let normal = glm::inverseTranspose(mat3(pose));
+			for(int column=0; column<3; ++column)
+				pInstances[it].NormalTransform[column] = vec4(normal[column], 0.f);
+		}
+	});
+
+	// split shadow cascades and material passes into tasks: a static layer that's stale is
+	// re-rendered, then copied into the cascade, and dynamic casters are drawn on top
+	renderTasks.clear();
+	for(int cascadeIdx=0; cascadeIdx<cascadeCount; ++cascadeIdx) {
+		let staticStart = segmentStarts[2 * cascadeIdx];
+		let dynamicStart = segmentStarts[2 * cascadeIdx + 1];
+		let dynamicEnd = segmentStarts[2 * cascadeIdx + 2];
+		if (!cascadeCached[cascadeIdx])
+			DoAddRenderTasks(shadowQueue.data() + staticStart, dynamicStart - staticStart, staticStart, nullptr, pStaticCascadeDSVs[cascadeIdx], cascadeIdx, -1, true);
+		DoAddRenderTasks(shadowQueue.data() + dynamicStart, dynamicEnd - dynamicStart, dynamicStart, nullptr, pShadowCascadeDSVs[cascadeIdx], cascadeIdx, cascadeIdx, false);
+	}
+	let firstViewTask = int32(renderTasks.size());
+	DoAddRenderTasks(renderQueue.data(), visibleCount, shadowCasterCount, pDisplay->GetRenderTargetView(), pDisplay->GetDepthTargetView(), -1, -1, false);
+
+	// pass constants are written once here, on the immediate context, into a buffer per
+	// pass (the view, then each cascade) which the command lists only read
+	DoWritePassConstants(pContext, -1, viewProjection);
+	for(int cascadeIdx=0; cascadeIdx<cascadeCount; ++cascadeIdx)
+		DoWritePassConstants(pContext, cascadeIdx, cascades[cascadeIdx].worldToLightProjSpace);
+
+	let taskCount = int32(renderTasks.size());
+	let AccumulateTaskStats = [this](const RenderTask& task) {
+		renderStats.drawCount += task.stats.drawCount;
+		renderStats.triangleCount += task.stats.triangleCount;
+		renderStats.psoBindCount += task.stats.psoBindCount;
+		renderStats.srbCommitCount += task.stats.srbCommitCount;
+		renderStats.vertexBufferBindCount += task.stats.vertexBufferBindCount;
+	};
+
+	// headless: walk the tasks with no context, which validates and tallies what would
+	// have been recorded and uploaded
+	if (pContext == nullptr) {
+		renderStats.mapCount += instanceCount > 0 ? 2 : 1;
+		renderStats.uploadBytes += instanceCount * sizeof(MeshInstance) + sizeof(FrameConstants);
+		for(auto& task : renderTasks) {
+			DoRecordRenderTask(nullptr, task, RESOURCE_STATE_TRANSITION_MODE_NONE);
+			AccumulateTaskStats(task);
+		}
+		#if TRINKET_TEST
+		let lineCount = debugLines.Flip();
+		renderStats.debugLineCount = lineCount;
+		renderStats.droppedDebugLineCount = debugLines.GetRetiredDroppedCount();
+		if (lineCount > 0) {
+			++renderStats.mapCount;
+			renderStats.uploadBytes += sizeof(DebugLineVertex) * (lineCount + lineCount);
+		}
+		#endif
+		return;
+	}
+
+	// record on deferred contexts, each taking every Nth task, while the immediate
+	// context uploads the frame's data
+	let recordContextCount = eastl::min(pDisplay->GetDeferredContextCount(), taskCount);
+	JobCounter recordCounter;
+	let RecordTasks = [this, taskCount, recordContextCount](int32 begin, int32 end) {
+		for(int32 contextIdx=begin; contextIdx<end; ++contextIdx) {
+			let pDeferredContext = pDisplay->GetDeferredContext(contextIdx);
+			for(int32 taskIdx=contextIdx; taskIdx<taskCount; taskIdx+=recordContextCount) {
+				auto& task = renderTasks[taskIdx];
+				DoRecordRenderTask(pDeferredContext, task, RESOURCE_STATE_TRANSITION_MODE_NONE);
+				pDeferredContext->FinishCommandList(&task.pCommandList);
+			}
+		}
+	};
+	let RecordThunk = [](void* pContext, int32 begin, int32 end) { (*static_cast<decltype(RecordTasks)*>(pContext))(begin, end); };
+	for(int32 it=0; it<recordContextCount; ++it)
+		pWorld->jobs.Submit(recordCounter, RecordThunk, (void*)&RecordTasks, it, it + 1);
+
+	if (instanceCount > 0) {
+		pContext->UpdateBuffer(pInstanceBuffer, 0, instanceCount * sizeof(MeshInstance), instanceData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+		++renderStats.mapCount;
+		renderStats.uploadBytes += instanceCount * sizeof(MeshInstance);
+	}
+	{
+		FrameConstants constants;
+		constants.ViewTransform = view;
+		for(int it=0; it<MAX_SHADOW_CASCADES; ++it) {
+			let bUsed = it < cascadeCount;
+			constants.SceneToShadowMapUVDepth[it] = bUsed ? cascades[it].worldToShadowMapUVDepth : glm::identity<mat4>();
+			constants.CascadeSplits[it] = bUsed ? cascades[it].splitDepth : FLT_MAX;
+		}
+		let resolution = float(shadowSettings.resolution);
+		constants.ShadowMapSize = vec4(resolution, 1.f / resolution, float(cascadeCount), 0.f);
+		constants.LightDirection = vec4(lightz, 0);
+		pContext->UpdateBuffer(pFrameConstants, 0, sizeof(FrameConstants), &constants, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+		++renderStats.mapCount;
+		renderStats.uploadBytes += sizeof(FrameConstants);
+	}
+
+	// deferred contexts record without transitions, so everything they touch is put into
+	// its draw state here, before each command list executes
+	let TransitionTexture = [pContext](ITexture* pTexture, RESOURCE_STATE state) {
+		StateTransitionDesc barrier(pTexture, RESOURCE_STATE_UNKNOWN, state, true);
+		pContext->TransitionResourceStates(1, &barrier);
+	};
+	{
+		StateTransitionDesc barriers[2 + MAX_SHADOW_CASCADES + 1];
+		uint32 barrierCount = 0;
+		barriers[barrierCount++] = StateTransitionDesc(pFrameConstants, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, true);
+		for(int it=0; it<=cascadeCount; ++it)
+			barriers[barrierCount++] = StateTransitionDesc(pPassConstants[it], RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, true);
+		if (pInstanceBuffer)
+			barriers[barrierCount++] = StateTransitionDesc(pInstanceBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, true);
+		pContext->TransitionResourceStates(barrierCount, barriers);
+	}
+
+	// execute in order (recording on the immediate context if there are no deferred contexts)
+	pWorld->jobs.Wait(recordCounter);
+	for(int32 taskIdx=0; taskIdx<taskCount; ++taskIdx) {
+		auto& task = renderTasks[taskIdx];
+		if (taskIdx == firstViewTask) {
+			TransitionTexture(pShadowMap, RESOURCE_STATE_SHADER_RESOURCE);
+			for(let& pass : passes) {
+				auto& materialPass = pass.pMaterial->GetPass(pass.materialPassIdx);
+				if (materialPass.IsLoaded())
+					for(uint32 format=0; format<MESH_VERTEX_FORMAT_COUNT; ++format)
+						pContext->TransitionShaderResources(materialPass.GetPipelineState(format), materialPass.GetResourceBinding(format));
 			}
-			item.pMesh->GetSubmesh(item.submeshIdx)->DoDraw(pContext);
+			pDisplay->SetMultisamplingTargetAndClear();
+		}
+		if (task.copyStaticCascade >= 0) {
+			CopyTextureAttribs CopyAttribs(
+				pStaticShadowMap, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, 
+				pShadowMap, RESOURCE_STATE_TRANSITION_MODE_TRANSITION
+			);
+			CopyAttribs.SrcSlice = task.copyStaticCascade;
+			CopyAttribs.DstSlice = task.copyStaticCascade;
+			pContext->CopyTexture(CopyAttribs);
+		}
+		TransitionTexture(task.pDSV->GetTexture(), RESOURCE_STATE_DEPTH_WRITE);
+
+		if (task.pCommandList) {
+			pContext->ExecuteCommandList(task.pCommandList);
+			task.pCommandList.Release();
+		} else {
+			DoRecordRenderTask(pContext, task, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 		}
-		itemIdx += pass.itemCount;
+
+		AccumulateTaskStats(task);
 	}
+	for(int32 it=0; it<pDisplay->GetDeferredContextCount(); ++it)
+		pDisplay->GetDeferredContext(it)->FinishFrame();
+
+	// (executing command lists resets the immediate context's state)
+	ITextureView* pRTV = pDisplay->GetRenderTargetView();
+	pContext->SetRenderTargets(1, &pRTV, pDisplay->GetDepthTargetView(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
 	#if TRINKET_TEST
+	// retire this frame's debug lines, and upload them page by page
+	let lineCount = debugLines.Flip();
+	renderStats.debugLineCount = lineCount;
+	renderStats.droppedDebugLineCount = debugLines.GetRetiredDroppedCount();
 	if (lineCount > 0) {
-	
-		pContext->UpdateBuffer(pDebugWireframeBuf, 0, sizeof(WireframeVertex)* (lineCount + lineCount), lineBuf, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+		if (lineCount > debugLineCapacity) {
+			debugLineCapacity = eastl::max(lineCount, debugLineCapacity + (debugLineCapacity >> 1));
+			pDebugWireframeBuf.Release();
+			BufferDesc VBD;
+			VBD.Name = "VB_DebugWireframe";
+			VBD.Usage = USAGE_DYNAMIC;
+			VBD.BindFlags = BIND_VERTEX_BUFFER;
+			VBD.CPUAccessFlags = CPU_ACCESS_WRITE;
+			VBD.uiSizeInBytes = debugLineCapacity * 2 * sizeof(DebugLineVertex);
+			pDevice->CreateBuffer(VBD, nullptr, &pDebugWireframeBuf);
+			CHECK_ASSERT(pDebugWireframeBuf);
+		}
+		{
+			MapHelper<DebugLineVertex> vertices(pContext, pDebugWireframeBuf, MAP_WRITE, MAP_FLAG_DISCARD);
+			DebugLineVertex* pVertices = vertices;
+			for(uint32 it=0; it<debugLines.GetRetiredPageCount(); ++it) {
+				let pageLineCount = debugLines.GetRetiredPageLineCount(it);
+				memcpy(pVertices, debugLines.GetRetiredPage(it), pageLineCount * 2 * sizeof(DebugLineVertex));
+				pVertices += 2 * pageLineCount;
+			}
+		}
+		++renderStats.mapCount;
+		renderStats.uploadBytes += sizeof(DebugLineVertex) * (lineCount + lineCount);
+
+		// (the view's pass constants were written with the render tasks)
 		pContext->SetPipelineState(pDebugWireframePSO);
 		pContext->CommitShaderResources(pDebugWireframeSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
 		uint32 offset = 0;
 		IBuffer* pBuffers[]{ pDebugWireframeBuf };
 		pContext->SetVertexBuffers(0, 1, pBuffers, &offset, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET);
-		{
-			MapHelper<RenderConstants> CBConstants(pContext, pRenderConstants, MAP_WRITE, MAP_FLAG_DISCARD);
-			CBConstants->ModelViewProjectionTransform = viewProjection;
-			CBConstants->ModelViewTransform = view;
-			CBConstants->ModelTransform = glm::identity<mat4>();
-			CBConstants->NormalTransform = glm::identity<mat3>();
-			//CBConstants->SceneToShadowMapUVDepth = worldToShadowMapUVDepth;
-			//CBConstants->LightDirection = vec4(lightz, 0);
-		}
-
 		DrawAttribs draw;
 		draw.NumVertices = lineCount << 1;
 		pContext->Draw(draw);
-		lineCount = 0;
 	}
-
 	#endif
 
 	#if SHADOW_MAP_DEBUG
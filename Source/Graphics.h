@@ -6,6 +6,9 @@
 #include "Material.h"
 #include "Mesh.h"
 #include "Texture.h"
+#include "DebugDraw.h"
+#include "Occlusion.h"
+#include "AABBTree.h"
 
 // compile-time graphics config
 #ifndef TEX_FORMAT_SHADOW_MAP
@@ -14,8 +17,32 @@
 #ifndef SHADOW_MAP_DEBUG
 #	define SHADOW_MAP_DEBUG 0
 #endif
-#ifndef DEBUG_LINE_CAPACITY
-#	define DEBUG_LINE_CAPACITY (1024 * 1024)
+#ifndef MAX_SHADOW_CASCADES
+#	define MAX_SHADOW_CASCADES 4 // must match common.fxh
+#endif
+#ifndef STATIC_SHADOW_FRAMES
+#	define STATIC_SHADOW_FRAMES 30 // frames a caster must hold still to join the static shadow layer
+#endif
+#ifndef STATIC_SHADOW_SNAP
+#	define STATIC_SHADOW_SNAP 0.0625f // fraction of a cascade's resolution its bounds snap by, so small camera moves keep the static layer
+#endif
+#ifndef OCCLUSION_CULLING
+#	define OCCLUSION_CULLING 1
+#endif
+#ifndef OCCLUSION_AUTO_OCCLUDER_SIZE
+#	define OCCLUSION_AUTO_OCCLUDER_SIZE 5.f // world-box diagonal above which unflagged renderers occlude, e.g. a wall or building (0 = flagged only)
+#endif
+#ifndef OCCLUSION_AUTO_OCCLUDER_SHRINK
+#	define OCCLUSION_AUTO_OCCLUDER_SHRINK 0.5f // auto-selected occluders use their bounds scaled by this
+#endif
+#ifndef MESH_LOD_SCREEN_SIZE
+#	define MESH_LOD_SCREEN_SIZE 0.25f // projected radius (over the half-height of the view) below which LOD 1 is drawn, halving for each LOD after
+#endif
+#ifndef MESH_LOD_HYSTERESIS
+#	define MESH_LOD_HYSTERESIS 0.1f // fraction past a threshold an item must go to switch LOD, so it doesn't flicker on the boundary
+#endif
+#ifndef RENDER_TASK_GRAIN
+#	define RENDER_TASK_GRAIN 2048 // queue entries per recorded command list
 #endif
 
 // TODO: Implement IAssetListener to detect releases
@@ -27,6 +54,13 @@ struct CameraPOV {
 	float zFar;
 };
 
+struct ShadowSettings {
+	int32 cascadeCount;
+	uint32 resolution;  // of each cascade
+	float distance;     // view depth covered by the last cascade
+	float splitLambda;  // blend of logarithmic (1) and uniform (0) cascade splits
+};
+
 struct MeshComponentHandle {
 	Graphics* gfx;
 	ObjectID id;
@@ -37,17 +71,43 @@ struct RenderMeshData {
 	Mesh* pMesh;
 	Material* pMaterial;
 	bool castsShadow;
+	bool isOccluder; // the mesh's bounding box is (mostly) solid, and hides what's behind it
+};
+
+struct RenderStats {
+	uint32 visibleCount;
+	uint32 culledCount;
+	uint32 occluderCount;
+	uint32 occludedCount;              // (passed the frustum, but hidden by occluders)
+	uint32 shadowCasterCount;
+	uint32 culledShadowCasterCount;
+	uint32 drawCount;
+	uint32 triangleCount;
+	uint32 psoBindCount;
+	uint32 srbCommitCount;
+	uint32 vertexBufferBindCount;
+	uint32 staticShadowCacheHits;      // cascades composited from the cached static layer
+	uint32 staticShadowInvalidations;  // cascades which re-rendered the static layer
+	uint32 mapCount;                   // dynamic buffer maps and updates
+	uint32 uploadBytes;
+	uint32 debugLineCount;
+	uint32 droppedDebugLineCount;      // (past DEBUG_LINE_CAPACITY)
 };
 
-struct RenderConstants {
-	mat4 ModelViewProjectionTransform;
-	mat4 ModelViewTransform;
-	mat4 ModelTransform;
-	mat4 NormalTransform;
-	mat4 SceneToShadowMapUVDepth;
+// written once per frame
+struct FrameConstants {
+	mat4 ViewTransform;
+	mat4 SceneToShadowMapUVDepth[MAX_SHADOW_CASCADES];
+	vec4 CascadeSplits; // far view depth of each cascade
+	vec4 ShadowMapSize; // resolution, 1/resolution, cascade count
 	vec4 LightDirection;
 };
 
+// one buffer per pass (the view, which debug lines share, then each shadow cascade)
+struct PassConstants {
+	mat4 ViewProjectionTransform;
+};
+
 class World;
 
 class Graphics : IAssetListener, ISceneListener, ISkelRegistryListener {
@@ -59,9 +119,10 @@ public:
 	Display* GetDisplay() { return pDisplay; }
 	World* GetWorld() const { return pWorld; }
 	IShaderSourceInputStreamFactory* GetShaderSourceStream() { return pShaderSourceFactory; }
-	IBuffer* GetRenderConstants() { return pRenderConstants; }
+	void BindRenderConstants(IPipelineState* pPSO);
 	ITextureView* GetShadowMapSRV() { return pShadowMapSRV; }
 	const CameraPOV& GetPOV() const { return pov; }
+	const RenderStats& GetRenderStats() const { return renderStats; }
 
 	void SetEyePosition(vec3 position) { pov.pose.position = position; }
 	void SetEyeRotation(quat rotation) { pov.pose.rotation = rotation; }
@@ -69,12 +130,24 @@ public:
 
 	void SetLightDirection(vec3 direction) { lightDirection = glm::normalize(direction); }
 
+	const ShadowSettings& GetShadowSettings() const { return shadowSettings; }
+	void SetShadowSettings(const ShadowSettings& settings);
+
 	void AddRenderPasses(Material* pMaterial);
 
 	bool AddMeshRenderer(ObjectID id, const RenderMeshData& Data);
+	bool TryRemoveMeshRenderer(ObjectID id);
+	bool TrySetMeshRendererMaterial(ObjectID id, Material* pMaterial);
 	const RenderMeshData* GetMeshRenderer(ObjectID id) const { return meshRenderers.TryGetComponent<1>(id); }
 
+	// mesh-renderer bounds by object, refit by UpdateSpatialIndex() (for objects whose scene poses moved)
+	const AABBTree& GetSpatialIndex() const { return spatialIndex; }
+	void UpdateSpatialIndex();
+
 	void DrawDebugLine(const vec4& color, const vec3& start, const vec3& end);
+#if TRINKET_TEST
+	DebugLineBuffer* GetDebugLines() { return &debugLines; } // (thread-safe appends)
+#endif
 
 	void Draw();
 
@@ -88,10 +161,24 @@ private:
 	Display* pDisplay;
 	World* pWorld;
 
-	ObjectPool<RenderMeshData> meshRenderers;
+	// second column is the head of each renderer's RenderItem chain, third its spatial index proxy
+	ObjectPool<RenderMeshData, int32, int32> meshRenderers;
+	AABBTree spatialIndex;
+	eastl::vector<int32> movedRenderers;
+	eastl::vector<AABB> rendererBounds; // (of movedRenderers)
 
 	CameraPOV pov;
 	vec3 lightDirection;
+	ShadowSettings shadowSettings;
+
+	struct ShadowCascade {
+		mat4 worldToLightProjSpace;
+		mat4 worldToShadowMapUVDepth;
+		mat4 staticWorldToLightProjSpace; // of the cached static layer
+		float splitDepth;
+	};
+
+	ShadowCascade cascades[MAX_SHADOW_CASCADES];
 
 	RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
 
@@ -99,13 +186,19 @@ private:
 	RefCntAutoPtr<ITextureView> m_pMSDepthDSV;
 
 
-	RefCntAutoPtr<IBuffer>                pRenderConstants;
+	RefCntAutoPtr<IBuffer>                pFrameConstants;
+	RefCntAutoPtr<IBuffer>                pPassConstants[1 + MAX_SHADOW_CASCADES];
+	RefCntAutoPtr<IBuffer>                pInstanceBuffer;
+	uint32                                instanceCapacity = 0;
 
 	RefCntAutoPtr<ITexture>               pShadowMap;
 	RefCntAutoPtr<ITextureView>           pShadowMapSRV;
-	RefCntAutoPtr<ITextureView>           pShadowMapDSV;
-	RefCntAutoPtr<IPipelineState>         pShadowPipelineState;
-	RefCntAutoPtr<IShaderResourceBinding> pShadowResourceBinding;
+	RefCntAutoPtr<ITextureView>           pShadowCascadeDSVs[MAX_SHADOW_CASCADES];
+	RefCntAutoPtr<ITexture>               pStaticShadowMap;
+	RefCntAutoPtr<ITextureView>           pStaticCascadeDSVs[MAX_SHADOW_CASCADES];
+	bool                                  staticShadowsDirty = true;
+	RefCntAutoPtr<IPipelineState>         pShadowPipelineStates[MESH_VERTEX_FORMAT_COUNT];
+	RefCntAutoPtr<IShaderResourceBinding> pShadowResourceBindings[MAX_SHADOW_CASCADES][MESH_VERTEX_FORMAT_COUNT];
 
 	RefCntAutoPtr<IPipelineState>         pShadowMapDebugPSO;
 	RefCntAutoPtr<IShaderResourceBinding> pShadowMapDebugSRB;
@@ -113,36 +206,85 @@ private:
 	struct RenderItem {
 		Mesh* pMesh;
 		ObjectID id;
-		uint16 submeshIdx;
-		uint16 shadows;
+		uint16 passIdx;
+		uint8 shadows;  // set on the renderer's first item only
+		uint8 occluder; // OccluderMode, set on the renderer's first item only
+		uint8 lodIdx;   // chosen by screen size (with hysteresis, so it persists across frames)
+		uint8 staticChanged; // joined or left the static shadow layer this frame
+		uint8 moved;         // scene pose written or recomputed since the last Draw()
+		uint16 stillFrames;
+		int32 nextItemIdx; // next item for the same renderer
+
+		bool IsStaticCaster() const { return shadows && stillFrames >= STATIC_SHADOW_FRAMES; }
+	};
+
+	enum OccluderMode : uint8 {
+		OCCLUDER_NEVER,
+		OCCLUDER_AUTO,   // if large enough (by OCCLUSION_AUTO_OCCLUDER_SIZE)
+		OCCLUDER_ALWAYS,
 	};
 
 	struct RenderPass {
 		Material* pMaterial;
 		int materialPassIdx;
-		int itemCount;
 	};
 
+	struct RenderQueueEntry {
+		uint64 key;
+		int32 itemIdx;
+	};
+
+	void DoCreateShadowMap();
+	void DoFitShadowCascades(const DeviceCaps& caps);
+	void DoAddRenderItems(ObjectID id, const RenderMeshData& data);
+	void DoRemoveRenderItems(ObjectID id);
+	AABB DoGetRendererBounds(ObjectID id, const RenderMeshData& data);
+	int32 DoQueryFrustumItems(const FrustumPlanes& frustum);
+	int32 DoCullOccludedItems(const mat4& view, const mat4& viewProjection, int32 visibleCount);
+	uint64 GetSortKey(const RenderItem& item, float viewDepth) const;
+	// A chunk of a render queue, recorded on its own command list and executed
+	// in order (after any immediate-context work it's flagged to wait for)
+	struct RenderTask {
+		const RenderQueueEntry* pQueue;
+		int32 count;
+		int32 firstInstance;
+		ITextureView* pRTV; // (null for shadow cascades)
+		ITextureView* pDSV;
+		int32 cascadeIdx; // drawn with the cascade's shadow bindings, or -1 for the view's material passes
+		int32 copyStaticCascade; // copy this cascade's static layer in before executing
+		bool bClear;
+		RenderStats stats;
+		RefCntAutoPtr<ICommandList> pCommandList;
+	};
+
+	void DoDrawRenderQueue(IDeviceContext* pContext, const RenderQueueEntry* pQueue, int32 count, int32 firstInstance, int32 cascadeIdx, RESOURCE_STATE_TRANSITION_MODE transitionMode, RenderStats& stats);
+	void DoWritePassConstants(IDeviceContext* pContext, int32 cascadeIdx, const mat4& viewProjection);
+	void DoAddRenderTasks(const RenderQueueEntry* pQueue, int32 count, int32 firstInstance, ITextureView* pRTV, ITextureView* pDSV, int32 cascadeIdx, int32 copyStaticCascade, bool bClear);
+	void DoRecordRenderTask(IDeviceContext* pContext, RenderTask& task, RESOURCE_STATE_TRANSITION_MODE transitionMode);
+
 
 	eastl::vector<RenderPass> passes;
+	eastl::hash_map<Material*, int32> materialPasses; // first index into passes
 	eastl::vector<RenderItem> items;
 	eastl::vector<AABB> boundingBoxes;
 	eastl::vector<mat4> matrices;
+	eastl::vector<int32> visibleItems;
+	eastl::vector<eastl::pair<float, int32>> occluderCandidates; // (screen size estimate, item)
+	OcclusionBuffer occlusionBuffer;
+	eastl::vector<RenderQueueEntry> shadowQueue;
+	eastl::vector<RenderQueueEntry> renderQueue;
+	eastl::vector<RenderQueueEntry> queueScratch;
+	eastl::vector<MeshInstance> instanceData;
+	eastl::vector<RenderTask> renderTasks;
+	RenderStats renderStats;
 
 #if TRINKET_TEST
 
-	struct WireframeVertex {
-		vec3 position;
-		vec4 color;
-	};
-
 	RefCntAutoPtr<IPipelineState> pDebugWireframePSO;
 	RefCntAutoPtr<IShaderResourceBinding> pDebugWireframeSRB;
 	RefCntAutoPtr<IBuffer>        pDebugWireframeBuf;
-
-	// TODO: double buffer (for multithreading?)
-	uint32 lineCount = 0;
-	WireframeVertex lineBuf[2 * DEBUG_LINE_CAPACITY];
+	uint32                        debugLineCapacity = 0;
+	DebugLineBuffer               debugLines;
 
 #endif
 };
@@ -3,6 +3,41 @@
 
 #include "Hierarchy.h"
 
+namespace {
+
+// Accumulates scene-pose recomputations into groups for the ConcatPoses kernel. Since
+// parents precede children, an object is only grouped with objects after its parent.
+struct PoseConcatBatch {
+	HPose* pScenePoses;
+	const HPose* pRelativePoses;
+	const PoseMask* pMask;
+	const int32* pParents;
+	int32 indices[POSE_BATCH_WIDTH];
+	int32 count = 0;
+
+	PoseConcatBatch(HPose* aScenePoses, const HPose* aRelativePoses, const PoseMask* aMask, const int32* aParents)
+		: pScenePoses(aScenePoses), pRelativePoses(aRelativePoses), pMask(aMask), pParents(aParents) {}
+
+	void Add(int32 idx) {
+		let parentIdx = pParents[idx];
+		if (parentIdx < 0) {
+			pScenePoses[idx] = pRelativePoses[idx];
+			return;
+		}
+
+		if (count == POSE_BATCH_WIDTH || (count > 0 && parentIdx >= indices[0]))
+			Flush();
+		indices[count++] = idx;
+	}
+
+	void Flush() {
+		ConcatPoses(pScenePoses, pRelativePoses, pMask, pParents, indices, count);
+		count = 0;
+	}
+};
+
+}
+
 Hierarchy::Hierarchy(ObjectID worldID) noexcept 
 	: ObjectComponent(worldID) 
 {
@@ -73,9 +108,12 @@ bool Hierarchy::TryAdd(ObjectID id, ObjectID parent) {
 	let statusOK = !pool.Contains(id);
 	if (statusOK) {
 
+		FlushScenePoses();
+
 		// appending to end?
 		if (parent.IsNil()) {
-			pool.TryAppendObject(id, INVALID_INDEX, HPOSE_IDENTITY, HPOSE_IDENTITY, PoseMask(ForceInit::Default));
+			pool.TryAppendObject(id, INVALID_INDEX, HPOSE_IDENTITY, HPOSE_IDENTITY, PoseMask(ForceInit::Default), uint8(POSE_MOVED));
+			movedObjects.push_back(id);
 			for(auto it : listeners)
 				it->Hierarchy_DidAddObject(this, id);
 			return true;
@@ -84,7 +122,8 @@ bool Hierarchy::TryAdd(ObjectID id, ObjectID parent) {
 		let parentIdx = IndexOf(parent);
 		if (parentIdx == Count() - 1) {
 			let parentPose = *pool.GetComponentByIndex<C_WORLD_POSE>(parentIdx);
-			pool.TryAppendObject(id, parentIdx, HPOSE_IDENTITY, parentPose, PoseMask(ForceInit::Default));
+			pool.TryAppendObject(id, parentIdx, HPOSE_IDENTITY, parentPose, PoseMask(ForceInit::Default), uint8(POSE_MOVED));
+			movedObjects.push_back(id);
 			for (auto it : listeners)
 				it->Hierarchy_DidAddObject(this, id);
 			return true;
@@ -93,8 +132,9 @@ bool Hierarchy::TryAdd(ObjectID id, ObjectID parent) {
 		// inserting/downshifting
 		if (parentIdx != INVALID_INDEX) {
 			let parentPose = *pool.GetComponentByIndex<C_WORLD_POSE>(parentIdx);
-			pool.TryInsertObjectAfter(id, parent, parentIdx, HPOSE_IDENTITY, parentPose, PoseMask(ForceInit::Default));
+			pool.TryInsertObjectAfter(id, parent, parentIdx, HPOSE_IDENTITY, parentPose, PoseMask(ForceInit::Default), uint8(POSE_MOVED));
 			DoShiftIndexes(parentIdx + 1, 1);
+			movedObjects.push_back(id);
 			for (auto it : listeners)
 				it->Hierarchy_DidAddObject(this, id);
 			return true;
@@ -105,116 +145,44 @@ bool Hierarchy::TryAdd(ObjectID id, ObjectID parent) {
 
 }
 bool Hierarchy::TryReparent(ObjectID id, ObjectID underParent, ReparentMode mode) {
-	// ?? In principle could be optimized better for batch-operation ??
 
 	// early out?
 	let idx = IndexOf(id);
 	if (idx == INVALID_INDEX)
 		return false;
 
-	let worldStay = mode == ReparentMode::MaintainScenePose;
-	auto worldPose = *pool.GetComponentByIndex<C_WORLD_POSE>(idx);
-	auto relPose = *pool.GetComponentByIndex<C_RELATIVE_POSE>(idx);
-	let mask = *pool.GetComponentByIndex<C_MASK>(idx);
-
-	{
-		let pidx = IndexOf(underParent); // scope this because we're about to invalidate it
-
-		// noop?
-		if (GetParentIndexByIndex(idx) == pidx)
-			return true;
+	let pidx = IndexOf(underParent);
 
-		// trying to reparent under a child?
-		if (pidx > idx && pidx < GetDescendentRangeByIndex(idx))
-			return false;
-
-	}
+	// noop?
+	if (GetParentIndexByIndex(idx) == pidx)
+		return true;
 
-	// save parent-pointers of descendents, relative to idx
-	struct SavedChild {
-		ObjectID id;
-		int32 relativeParent;
-		HPose rel;
-		HPose pose;
-		PoseMask mask;
-
-		SavedChild(ObjectID aID, int32 aRelativeParent, const HPose& aRel, const HPose& aPose, PoseMask aMask) 
-			: id(aID)
-			, relativeParent(aRelativeParent) 
-			, rel(aRel)
-			, pose(aPose)
-			, mask(aMask)
-		{}
-	};
-	static eastl::vector<SavedChild> childParents;
-	childParents.clear();
+	// trying to reparent under self or a child?
 	let idxEnd = GetDescendentRangeByIndex(idx);
-	let rangeCount = idxEnd - idx;
-	{
-		let pHandles = pool.GetComponentData<C_HANDLE>();
-		let pParents = pool.GetComponentData<C_PARENT>();
-		let pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
-		let pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
-		let pMask = pool.GetComponentData<C_MASK>();
-		for(int it=idx + 1; it<idxEnd; ++it)
-			childParents.emplace_back(
-				pHandles[it], 
-				pParents[it] - idx,
-				pRelativePoses[it],
-				pScenePoses[it],
-				pMask[it]
-			);
-	}
+	if (pidx >= idx && pidx < idxEnd)
+		return false;
 
-	// remove range from tree
-	pool.DoReleaseCompactRange_Shift(idx, idxEnd);
-	DoShiftIndexes(idx, -rangeCount);
-
-	// add to new parent
-	let n = Count();
-	let parentIdx = IndexOf(underParent);
-	if (worldStay)
-		relPose = mask.Rebase(parentIdx == INVALID_INDEX ? HPOSE_IDENTITY : *pool.GetComponentByIndex<C_WORLD_POSE>(parentIdx), worldPose);
-	else
-		worldPose = mask.Concat(*pool.GetComponentByIndex<C_WORLD_POSE>(parentIdx), relPose);
-
-	if (parentIdx == INVALID_INDEX || parentIdx == n - 1) {
-		
-		// simply append to the end
-		pool.TryAppendObject(id, parentIdx, relPose, worldPose, mask);
-		if (worldStay) {
-			for (auto it : childParents)
-				pool.TryAppendObject(it.id, it.relativeParent + n, it.rel, it.pose, mask);
-		} else {
-			for (auto it : childParents) {
-				let parentIdx = it.relativeParent + n;
-				let parentPose = *pool.GetComponentByIndex<C_WORLD_POSE>(parentIdx);
-				pool.TryAppendObject(it.id, parentIdx, it.rel, it.mask.Concat(parentPose, it.rel), mask);
-			}
-		}
+	FlushScenePoses();
 
-	} else {
-		
-		// insert after parent and downshift
-		let newIdx = parentIdx + 1;
-		pool.TryInsertObjectAt(id, newIdx, parentIdx, relPose, worldPose, mask);
-		auto nextIdx = newIdx;
-		if (worldStay) {
-			for(auto it : childParents) {
-				++nextIdx;
-				pool.TryInsertObjectAt(it.id, nextIdx, it.relativeParent + newIdx, it.rel, it.pose, mask);
-			}
-		} else {
-			for (auto it : childParents) {
-				++nextIdx;
-				let parentIdx = it.relativeParent + newIdx;
-				let parentPose = *pool.GetComponentByIndex<C_WORLD_POSE>(parentIdx);
-				pool.TryInsertObjectAt(it.id, nextIdx, parentIdx, it.rel, it.mask.Concat(parentPose, it.rel), mask);
-			}
-		}
+	// move the whole subtree to directly after the new parent (or to the end, for roots),
+	// which keeps the depth-first ordering, and then patch up the shifted parent-indices
+	let idxDest = pidx == INVALID_INDEX ? Count() : pidx + 1;
+	let forward = idxDest >= idxEnd;
+	let newIdx = pool.MoveRange(idx, idxEnd, idxDest);
+	DoRotateIndexes(forward ? idx : idxDest, forward ? idxEnd : idx, forward ? idxDest : idxEnd);
 
-		DoShiftIndexes(newIdx, rangeCount);
+	let newParentIdx = pidx == INVALID_INDEX ? INVALID_INDEX : newIdx - 1;
+	let newEnd = newIdx + (idxEnd - idx);
+	let pParents = pool.GetComponentData<C_PARENT>();
+	let pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
+	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
+	let pMask = pool.GetComponentData<C_MASK>();
+	pParents[newIdx] = newParentIdx;
 
+	if (mode == ReparentMode::MaintainScenePose) {
+		pRelativePoses[newIdx] = newParentIdx >= 0 ? pMask[newIdx].Rebase(pScenePoses[newParentIdx], pScenePoses[newIdx]) : pScenePoses[newIdx];
+	} else {
+		DoConcatScenePosesInRange(newIdx, newEnd);
 	}
 
 	return true;
@@ -227,14 +195,13 @@ bool Hierarchy::TryRelease(ObjectID id) {
 
 	// destroy children
 	let idxEnd = GetDescendentRangeByIndex(idxStart);
+	FlushScenePoses();
 	
 	for(int idx=idxStart; idx < idxEnd; ++idx)
 		for (auto it : listeners)
 			it->Hierarchy_WillRemoveObject(this, GetObjectByIndex(idx));
 
-	// TODO: really should be able to remove components by range
-	for (int it = idxStart; it < idxEnd; ++it)
-		pool.TryReleaseObject_Shift(GetObjectByIndex(idxStart));
+	pool.ReleaseRange_Shift(idxStart, idxEnd);
 
 	// downshift elements
 	let removeCount = (idxEnd - idxStart);
@@ -251,6 +218,24 @@ void Hierarchy::DoShiftIndexes(int32 idx, int32 delta) {
 			pParent[it] += delta;
 }
 
+void Hierarchy::DoRotateIndexes(int32 first, int32 middle, int32 last) {
+	
+	// remap parent-indices after the range [first, last) was rotated so
+	// that middle is now at first (parents always precede their children,
+	// so nothing before first can be affected)
+	let count = Count();
+	let pParent = pool.GetComponentData<C_PARENT>();
+	let upshift = last - middle;
+	let downshift = middle - first;
+	for (auto it = first; it < count; ++it) {
+		let parent = pParent[it];
+		if (parent >= first && parent < middle)
+			pParent[it] = parent + upshift;
+		else if (parent >= middle && parent < last)
+			pParent[it] = parent - downshift;
+	}
+}
+
 bool Hierarchy::SetMask(ObjectID id, PoseMask mask, ReparentMode mode) {
 	let idx = IndexOf(id);
 	return idx != INVALID_INDEX && SetMaskByIndex(idx, mask, mode);
@@ -264,117 +249,375 @@ bool Hierarchy::SetMaskByIndex(int32 idx, PoseMask mask, ReparentMode mode) {
 		return true;
 	}
 
-	pMask[idx] = mask;
-
 	auto pParents = pool.GetComponentData<C_PARENT>();
 	auto pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
 	auto pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
 
 	let parentIdx = pParents[idx];
 	if (parentIdx == INVALID_INDEX) {
+		pMask[idx] = mask;
 		return true;
 	}
 
 	if (mode == ReparentMode::MaintainScenePose) {
-		pRelativePoses[idx] = mask.Rebase(pScenePoses[parentIdx], pScenePoses[idx]);
+		// a pending scene pose is resolved with the old mask, and kept as-is by the flush
+		HPose scenePose;
+		if (DoComputeScenePose(idx, scenePose) & POSE_STALE) {
+			pScenePoses[idx] = scenePose;
+			DoMarkScenePoseWritten(idx);
+		}
+		pMask[idx] = mask;
+		pRelativePoses[idx] = mask.Rebase(DoGetCurrentScenePoseByIndex(parentIdx), scenePose);
 	} else {
-		pScenePoses[idx] = mask.Concat(pScenePoses[parentIdx], pRelativePoses[idx]);
-		let idxEnd = GetDescendentRangeByIndex(idx);
-		for (auto cidx = idx + 1; cidx != idxEnd; ++cidx)
-			pScenePoses[cidx] = pMask[cidx].Concat(pScenePoses[pParents[cidx]], pRelativePoses[cidx]);
+		pMask[idx] = mask;
+		DoUpdateScenePoseFromRelative(idx);
 	}
 
 	return true;
 }
 
-#define SET_POSE_PREAMBLE \
-	let pParents = pool.GetComponentData<C_PARENT>(); \
-	let pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>(); \
-	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>(); \
-	let pMask = pool.GetComponentData<C_MASK>(); \
-	let parentIdx = pParents[idx]; \
-	let idxEnd = GetDescendentRangeByIndex(idx);
+HPose Hierarchy::GetCurrentScenePose(ObjectID id) const {
+	let idx = IndexOf(id);
+	CHECK_ASSERT(idx != INVALID_INDEX);
+	return DoGetCurrentScenePoseByIndex(idx);
+}
+
+bool Hierarchy::IsScenePoseCurrentByIndex(int32 idx) const {
+	HPose pose;
+	return (DoComputeScenePose(idx, pose) & POSE_STALE) == 0;
+}
+
+void Hierarchy::SetDeferPoseUpdates(bool defer) {
+	if (!defer)
+		FlushScenePoses();
+	deferPoseUpdates = defer;
+}
+
+void Hierarchy::FlushScenePoses() {
+	if (dirtyIdx == INVALID_INDEX)
+		return;
+
+	FlushScenePosesInRange(dirtyIdx, Count(), movedObjects);
+	FinishFlushScenePoses();
+}
+
+int32 Hierarchy::GetNextRootIndex(int32 idx) const {
+	let pParents = pool.GetComponentData<C_PARENT>();
+	auto rootIdx = idx;
+	while (pParents[rootIdx] != INVALID_INDEX)
+		rootIdx = pParents[rootIdx];
+	return GetDescendentRangeByIndex(rootIdx);
+}
+
+void Hierarchy::FlushScenePosesInRange(int32 idxStart, int32 idxEnd, eastl::vector<ObjectID>& outMoved) {
+	CHECK_ASSERT(dirtyIdx != INVALID_INDEX);
+	CHECK_ASSERT(idxStart >= dirtyIdx);
+	CHECK_ASSERT(idxEnd <= Count());
 
-#define SET_POSE_CONCLUSION \
-	for (auto cidx = idx + 1; cidx != idxEnd; ++cidx) \
-		pScenePoses[cidx] = pMask[cidx].Concat(pScenePoses[pParents[cidx]], pRelativePoses[cidx]); \
+	// Parents always precede their children, so a single forward pass from
+	// the first dirty index visits every parent before its descendents.
+	// Stale poses are recomputed from their relative pose, and objects whose 
+	// scene pose changed flag their children to be recomputed in turn. Pinned
+	// poses were set directly, after any change to their ancestors, so they're kept.
+	let pParents = pool.GetComponentData<C_PARENT>();
+	let pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
+	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
+	let pMask = pool.GetComponentData<C_MASK>();
+	let pDirty = pool.GetComponentData<C_DIRTY>();
+	PoseConcatBatch batch(pScenePoses, pRelativePoses, pMask, pParents);
+	for (auto it = idxStart; it < idxEnd; ++it) {
+		let parentIdx = pParents[it];
+		let parentChanged = parentIdx >= 0 && (pDirty[parentIdx] & POSE_CHANGED);
+		if ((parentChanged || (pDirty[it] & POSE_STALE)) && !(pDirty[it] & POSE_PINNED)) {
+			batch.Add(it);
+			if ((pDirty[it] & POSE_MOVED) == 0)
+				outMoved.push_back(GetObjectByIndex(it));
+			pDirty[it] |= POSE_CHANGED | POSE_MOVED;
+		}
+	}
+	batch.Flush();
+
+	// the range ends at a root, so nothing after it reads these flags
+	for (auto it = idxStart; it < idxEnd; ++it)
+		pDirty[it] &= POSE_MOVED;
+}
+
+void Hierarchy::FinishFlushScenePoses() {
+	dirtyIdx = INVALID_INDEX;
+	hasPinnedPoses = false;
+}
+
+void Hierarchy::ClearMovedObjects() {
+	let pDirty = pool.GetComponentData<C_DIRTY>();
+	for (let id : movedObjects) {
+		let idx = IndexOf(id);
+		if (idx != INVALID_INDEX)
+			pDirty[idx] &= ~POSE_MOVED;
+	}
+	movedObjects.clear();
+}
+
+void Hierarchy::DoMarkDirty(int32 idx, uint8 flags) {
+	*pool.GetComponentByIndex<C_DIRTY>(idx) |= flags;
+	if (dirtyIdx == INVALID_INDEX || idx < dirtyIdx)
+		dirtyIdx = idx;
+}
+
+void Hierarchy::DoMarkMoved(int32 idx) {
+	auto& flags = *pool.GetComponentByIndex<C_DIRTY>(idx);
+	if ((flags & POSE_MOVED) == 0) {
+		flags |= POSE_MOVED;
+		movedObjects.push_back(GetObjectByIndex(idx));
+	}
+}
+
+void Hierarchy::DoMarkScenePoseWritten(int32 idx) {
+
+	// The scene pose was just set directly, so it's current, but its children need
+	// recomputing. If anything before it is dirty then an ancestor's change may still
+	// be pending, so pin the pose to stop the flush from re-deriving it from the rebased
+	// relative pose (which doesn't round-trip exactly).
+	DoMarkMoved(idx);
+	auto& flags = *pool.GetComponentByIndex<C_DIRTY>(idx);
+	flags &= ~POSE_STALE;
+	if (dirtyIdx != INVALID_INDEX && dirtyIdx < idx) {
+		flags |= POSE_PINNED;
+		hasPinnedPoses = true;
+	}
+	if (HasChildrenByIndex(idx))
+		DoMarkDirty(idx, POSE_CHANGED);
+}
+
+void Hierarchy::DoUnpinScenePoses(int32 idxStart, int32 idxSubtree) {
+
+	// pinned poses from idxStart to the end of the subtree of idxSubtree are recomputed 
+	// after all (an ancestor, or the pose itself, was written after they were pinned)
+	if (!hasPinnedPoses)
+		return;
+
+	let pDirty = pool.GetComponentData<C_DIRTY>();
+	let idxEnd = GetDescendentRangeByIndex(idxSubtree);
+	for (auto it = idxStart; it < idxEnd; ++it)
+		pDirty[it] &= ~POSE_PINNED;
+}
+
+uint8 Hierarchy::DoComputeScenePose(int32 idx, HPose& outPose) const {
+
+	// Scene pose of idx is stale if it's waiting to be recomputed, or if its parent's
+	// scene pose has changed (nothing before the first dirty index is either), so walk
+	// up to the nearest current ancestor, and concat back down. Returns POSE_STALE if 
+	// the pose was recomputed, and POSE_CHANGED if the pose's children need recomputing.
+	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
+	if (dirtyIdx == INVALID_INDEX || idx < dirtyIdx) {
+		outPose = pScenePoses[idx];
+		return 0;
+	}
+
+	let pDirty = pool.GetComponentData<C_DIRTY>();
+	if ((pDirty[idx] & POSE_PINNED) == 0) {
+		let parentIdx = GetParentIndexByIndex(idx);
+		HPose parentPose;
+		let parentChanged = parentIdx >= 0 && (DoComputeScenePose(parentIdx, parentPose) & POSE_CHANGED);
+		if (parentChanged || (pDirty[idx] & POSE_STALE)) {
+			let relativePose = *GetRelativePoseByIndex(idx);
+			outPose = parentIdx >= 0 ? ConcatPose(*GetMaskByIndex(idx), parentPose, relativePose) : relativePose;
+			return POSE_STALE | POSE_CHANGED;
+		}
+	}
+
+	outPose = pScenePoses[idx];
+	return pDirty[idx] & POSE_CHANGED;
+}
+
+HPose Hierarchy::DoGetCurrentScenePoseByIndex(int32 idx) const {
+	HPose result;
+	DoComputeScenePose(idx, result);
+	return result;
+}
+
+void Hierarchy::DoUpdateScenePoseFromRelative(int32 idx) {
+	if (deferPoseUpdates) {
+		DoUnpinScenePoses(idx, idx);
+		DoMarkDirty(idx, POSE_STALE);
+		return;
+	}
+
+	DoConcatScenePosesInRange(idx, GetDescendentRangeByIndex(idx));
+}
+
+void Hierarchy::DoUpdateRelativePoseFromScene(int32 idx) {
+	let pParents = pool.GetComponentData<C_PARENT>();
+	let pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
+	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
+	let pMask = pool.GetComponentData<C_MASK>();
+	let parentIdx = pParents[idx];
+	pRelativePoses[idx] = parentIdx >= 0 ? pMask[idx].Rebase(DoGetCurrentScenePoseByIndex(parentIdx), pScenePoses[idx]) : pScenePoses[idx];
+
+	if (deferPoseUpdates) {
+		DoUnpinScenePoses(idx + 1, idx);
+		DoMarkScenePoseWritten(idx);
+	} else {
+		DoMarkMoved(idx);
+		DoPropagateScenePoses(idx);
+	}
+}
+
+void Hierarchy::DoPropagateScenePoses(int32 idx) {
+	DoConcatScenePosesInRange(idx + 1, GetDescendentRangeByIndex(idx));
+}
+
+void Hierarchy::DoConcatScenePosesInRange(int32 idxStart, int32 idxEnd) {
+	PoseConcatBatch batch(
+		pool.GetComponentData<C_WORLD_POSE>(), 
+		pool.GetComponentData<C_RELATIVE_POSE>(), 
+		pool.GetComponentData<C_MASK>(), 
+		pool.GetComponentData<C_PARENT>()
+	);
+	for (auto it = idxStart; it < idxEnd; ++it) {
+		batch.Add(it);
+		DoMarkMoved(it);
+	}
+	batch.Flush();
+}
+
+#define SET_RELATIVE_POSE_PREAMBLE \
+	let pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
+
+#define SET_RELATIVE_POSE_CONCLUSION \
+	DoUpdateScenePoseFromRelative(idx); \
 	return true;
 
+#define SET_SCENE_POSE_PREAMBLE \
+	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>(); \
+	pScenePoses[idx] = DoGetCurrentScenePoseByIndex(idx);
+
+#define SET_SCENE_POSE_CONCLUSION \
+	DoUpdateRelativePoseFromScene(idx); \
+	return true;
 
 bool Hierarchy::SetRelativePoseByIndex(int32 idx, const HPose & rel) {
-	SET_POSE_PREAMBLE
+	SET_RELATIVE_POSE_PREAMBLE
 	pRelativePoses[idx] = rel;
-	pScenePoses[idx] = parentIdx >= 0 ? pMask[idx].Concat(pScenePoses[parentIdx], rel) : rel;
-	SET_POSE_CONCLUSION
+	SET_RELATIVE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetRelativePositionByIndex(int32 idx, const vec3& position) {
-	SET_POSE_PREAMBLE
+	SET_RELATIVE_POSE_PREAMBLE
 	pRelativePoses[idx].position = position;
-	pScenePoses[idx] = parentIdx >= 0 ? pMask[idx].Concat(pScenePoses[parentIdx], pRelativePoses[idx]) : pRelativePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_RELATIVE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetRelativeRotationByIndex(int32 idx, const quat& rotation) {
-	SET_POSE_PREAMBLE
+	SET_RELATIVE_POSE_PREAMBLE
 	pRelativePoses[idx].rotation = rotation;
-	pScenePoses[idx] = parentIdx >= 0 ? pMask[idx].Concat(pScenePoses[parentIdx], pRelativePoses[idx]) : pRelativePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_RELATIVE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetRelativeScaleByIndex(int32 idx, const vec3& scale) {
-	SET_POSE_PREAMBLE
+	SET_RELATIVE_POSE_PREAMBLE
 	pRelativePoses[idx].scale = scale;
-	pScenePoses[idx] = parentIdx >= 0 ? pMask[idx].Concat(pScenePoses[parentIdx], pRelativePoses[idx]) : pRelativePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_RELATIVE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetRelativeRigidPoseByIndex(int32 idx, const RPose& pose) {
-	SET_POSE_PREAMBLE
+	SET_RELATIVE_POSE_PREAMBLE
 	pRelativePoses[idx].rpose = pose;
-	pScenePoses[idx] = parentIdx >= 0 ? pMask[idx].Concat(pScenePoses[parentIdx], pRelativePoses[idx]) : pRelativePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_RELATIVE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetScenePoseByIndex(int32 idx, const HPose & pose) {
-	SET_POSE_PREAMBLE
+	SET_SCENE_POSE_PREAMBLE
 	pScenePoses[idx] = pose;
-	pRelativePoses[idx] = parentIdx >= 0 ? pMask[idx].Rebase(pScenePoses[parentIdx], pScenePoses[idx]) : pScenePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_SCENE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetScenePositionByIndex(int32 idx, const vec3& position) {
-	SET_POSE_PREAMBLE
+	SET_SCENE_POSE_PREAMBLE
 	pScenePoses[idx].position = position;
-	pRelativePoses[idx] = parentIdx >= 0 ? pMask[idx].Rebase(pScenePoses[parentIdx], pScenePoses[idx]) : pScenePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_SCENE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetSceneRotationByIndex(int32 idx, const quat& rotation) {
-	SET_POSE_PREAMBLE
+	SET_SCENE_POSE_PREAMBLE
 	pScenePoses[idx].rotation = rotation;
-	pRelativePoses[idx] = parentIdx >= 0 ? pMask[idx].Rebase(pScenePoses[parentIdx], pScenePoses[idx]) : pScenePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_SCENE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetSceneScaleByIndex(int32 idx, const vec3& scale) {
-	SET_POSE_PREAMBLE
+	SET_SCENE_POSE_PREAMBLE
 	pScenePoses[idx].scale = scale;
-	pRelativePoses[idx] = parentIdx >= 0 ? pMask[idx].Rebase(pScenePoses[parentIdx], pScenePoses[idx]) : pScenePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_SCENE_POSE_CONCLUSION
 }
 
 bool Hierarchy::SetSceneRigidPoseByIndex(int32 idx, const RPose& pose) {
-	SET_POSE_PREAMBLE
+	SET_SCENE_POSE_PREAMBLE
 	pScenePoses[idx].rpose = pose;
-	pRelativePoses[idx] = parentIdx >= 0 ? pMask[idx].Rebase(pScenePoses[parentIdx], pScenePoses[idx]) : pScenePoses[idx];
-	SET_POSE_CONCLUSION
+	SET_SCENE_POSE_CONCLUSION
 }
 
-#undef SET_POSE_PREAMBLE
-#undef SET_POSE_CONCLUSION
+#undef SET_RELATIVE_POSE_PREAMBLE
+#undef SET_RELATIVE_POSE_CONCLUSION
+#undef SET_SCENE_POSE_PREAMBLE
+#undef SET_SCENE_POSE_CONCLUSION
+
+static void ApplyScenePoseWrite(HPose& pose, const HPose& write) { pose = write; }
+static void ApplyScenePoseWrite(HPose& pose, const RPose& write) { pose.rpose = write; }
+
+template<typename T>
+void Hierarchy::DoWriteBatchScenePose(int32 idx, const T& write) {
+
+	// write the pose without propagating, just flagging its subtree as dirty (it's
+	// rebased on its parent's current pose, which sees earlier writes in the batch)
+	let parentIdx = GetParentIndexByIndex(idx);
+	let pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
+	auto pose = DoGetCurrentScenePoseByIndex(idx);
+	ApplyScenePoseWrite(pose, write);
+	pScenePoses[idx] = pose;
+	*pool.GetComponentByIndex<C_RELATIVE_POSE>(idx) = parentIdx >= 0 ? GetMaskByIndex(idx)->Rebase(DoGetCurrentScenePoseByIndex(parentIdx), pose) : pose;
+	DoUnpinScenePoses(idx + 1, idx);
+	DoMarkScenePoseWritten(idx);
+}
+
+template<typename T>
+void Hierarchy::DoSetScenePosesBatchByIndex(const int32* pIndices, const T* pPoses, int32 n) {
+	
+	// write every pose, and then recompute all the dirty subtrees in a 
+	// single pass from the first dirty index
+	for (int32 it = 0; it < n; ++it)
+		DoWriteBatchScenePose(pIndices[it], pPoses[it]);
+	if (!deferPoseUpdates)
+		FlushScenePoses();
+}
+
+template<typename T>
+void Hierarchy::DoSetScenePosesBatch(const ObjectID* pIDs, const T* pPoses, int32 n) {
+	for (int32 it = 0; it < n; ++it) {
+		let idx = IndexOf(pIDs[it]);
+		if (idx != INVALID_INDEX)
+			DoWriteBatchScenePose(idx, pPoses[it]);
+	}
+	if (!deferPoseUpdates)
+		FlushScenePoses();
+}
+
+void Hierarchy::SetScenePosesBatch(const ObjectID* pIDs, const HPose* pPoses, int32 n) {
+	DoSetScenePosesBatch(pIDs, pPoses, n);
+}
+
+void Hierarchy::SetSceneRigidPosesBatch(const ObjectID* pIDs, const RPose* pPoses, int32 n) {
+	DoSetScenePosesBatch(pIDs, pPoses, n);
+}
+
+void Hierarchy::SetScenePosesBatchByIndex(const int32* pIndices, const HPose* pPoses, int32 n) {
+	DoSetScenePosesBatchByIndex(pIndices, pPoses, n);
+}
+
+void Hierarchy::SetSceneRigidPosesBatchByIndex(const int32* pIndices, const RPose* pPoses, int32 n) {
+	DoSetScenePosesBatchByIndex(pIndices, pPoses, n);
+}
 
 void Hierarchy::SanityCheck() {
+	FlushScenePoses();
 	auto pParent = pool.GetComponentData<C_PARENT>();
 	auto pRelativePoses = pool.GetComponentData<C_RELATIVE_POSE>();
 	auto pScenePoses = pool.GetComponentData<C_WORLD_POSE>();
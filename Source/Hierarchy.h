@@ -27,10 +27,16 @@ enum class ReparentMode {
 class Hierarchy : public ObjectComponent {
 private:
 
-	enum Components { C_HANDLE, C_PARENT, C_RELATIVE_POSE, C_WORLD_POSE, C_MASK };
-	ObjectPool<int32, HPose, HPose, PoseMask> pool;
+	enum Components { C_HANDLE, C_PARENT, C_RELATIVE_POSE, C_WORLD_POSE, C_MASK, C_DIRTY };
+	enum DirtyFlags : uint8 { POSE_STALE = 0x01, POSE_CHANGED = 0x02, POSE_MOVED = 0x04, POSE_PINNED = 0x08 }; // (moved persists across flushes)
+	ObjectPool<int32, HPose, HPose, PoseMask, uint8> pool;
 	ListenerList<IHierarchyListener> listeners;
 
+	bool deferPoseUpdates = false;
+	int32 dirtyIdx = INVALID_INDEX;
+	bool hasPinnedPoses = false;
+	eastl::vector<ObjectID> movedObjects;
+
 public:
 
 	Hierarchy(ObjectID id) noexcept;
@@ -81,9 +87,11 @@ public:
 	const HPose* GetRelativePoseByIndex(int32 idx) const { return pool.GetComponentByIndex<C_RELATIVE_POSE>(idx); }
 	const HPose* GetRelativePoseData() const { return pool.GetComponentData<C_RELATIVE_POSE>(); }
 	
-	const HPose* GetScenePose(ObjectID id) const { return pool.TryGetComponent<C_WORLD_POSE>(id); }
-	const HPose* GetScenePoseByIndex(int32 idx) const { return pool.GetComponentByIndex<C_WORLD_POSE>(idx); }
-	const HPose* GetScenePoseData() const { return pool.GetComponentData<C_WORLD_POSE>(); }
+	const HPose* GetScenePose(ObjectID id) const { let idx = IndexOf(id); return idx != INVALID_INDEX ? GetScenePoseByIndex(idx) : nullptr; }
+	const HPose* GetScenePoseByIndex(int32 idx) const { CHECK_ASSERT(IsScenePoseCurrentByIndex(idx)); return pool.GetComponentByIndex<C_WORLD_POSE>(idx); }
+	const HPose* GetScenePoseData() const { CHECK_ASSERT(!HasDirtyPoses()); return pool.GetComponentData<C_WORLD_POSE>(); }
+	HPose GetCurrentScenePose(ObjectID id) const;
+	bool IsScenePoseCurrentByIndex(int32 idx) const;
 
 	const PoseMask* GetMask(ObjectID id) const { return pool.TryGetComponent<C_MASK>(id); }
 	const PoseMask* GetMaskByIndex(int32 idx) const { return pool.GetComponentByIndex<C_MASK>(idx); }
@@ -117,12 +125,73 @@ public:
 	bool SetSceneScaleByIndex(int32 idx, const vec3& scale);
 	bool SetSceneRigidPoseByIndex(int32 idx, const RPose& pose);
 
-	// TODO: Add Batch-Update Versions (e.g. for physics updates)
+	// BATCH METHODS
+
+	// Batch-updates (e.g. for physics or animation write-back) defer propagation until
+	// every write has been applied, so each affected subtree is only recomputed once. 
+	// Writes may be in any order (each costs its depth in the hierarchy), and later
+	// writes to the same object win.
+
+	void SetScenePosesBatch(const ObjectID* pIDs, const HPose* pPoses, int32 n);
+	void SetSceneRigidPosesBatch(const ObjectID* pIDs, const RPose* pPoses, int32 n);
+	void SetScenePosesBatchByIndex(const int32* pIndices, const HPose* pPoses, int32 n);
+	void SetSceneRigidPosesBatchByIndex(const int32* pIndices, const RPose* pPoses, int32 n);
+
+	// DEFERRED UPDATES
+
+	// By default setters eagerly recompute the scene poses of all descendents. When
+	// deferring, setters just flag the object as dirty, and scene poses are recomputed
+	// in one linear pass by FlushScenePoses(). Results are bitwise identical either way
+	// (scene poses which are set directly are pinned, so the flush doesn't re-derive them).
+	// The getters above assert the pose is current in checked builds, while 
+	// GetCurrentScenePose() recomputes a stale pose from its ancestors. Neither flushes, 
+	// so both are safe to call from jobs (as long as nothing is written concurrently).
+
+	bool IsDeferringPoseUpdates() const { return deferPoseUpdates; }
+	bool HasDirtyPoses() const { return dirtyIdx != INVALID_INDEX; }
+	void SetDeferPoseUpdates(bool defer);
+	void FlushScenePoses();
+
+	// Root subtrees occupy disjoint index ranges, so a flush may be split into ranges 
+	// which begin at the first dirty index or at a root, and end at a root (see
+	// GetNextRootIndex). Ranges may be flushed concurrently, each collecting the objects
+	// it moved, and then finished on the main thread with those lists.
+	int32 GetFirstDirtyIndex() const { return dirtyIdx; }
+	int32 GetNextRootIndex(int32 idx) const;
+	void FlushScenePosesInRange(int32 idxStart, int32 idxEnd, eastl::vector<ObjectID>& outMoved);
+	void AddMovedObjects(const eastl::vector<ObjectID>& moved) { movedObjects.insert(movedObjects.end(), moved.begin(), moved.end()); }
+	void FinishFlushScenePoses();
+
+	// MOVED OBJECTS
+
+	// Objects are flagged as moved whenever their scene pose is written or recomputed
+	// (including by a flush), and listed once, until ClearMovedObjects(), so e.g. the 
+	// spatial index can refit just what moved without scanning the hierarchy. There's one
+	// list, so only one consumer may clear it. (Released objects may still be listed.)
+	bool WasMovedByIndex(int32 idx) const { return (*pool.GetComponentByIndex<C_DIRTY>(idx) & POSE_MOVED) != 0; }
+	const eastl::vector<ObjectID>& GetMovedObjects() const { return movedObjects; }
+	void ClearMovedObjects();
 
 	void SanityCheck();
 
 private:
 	void DoShiftIndexes(int32 idx, int32 delta);
+	void DoRotateIndexes(int32 first, int32 middle, int32 last);
+
+	void DoMarkDirty(int32 idx, uint8 flags);
+	void DoMarkMoved(int32 idx);
+	void DoMarkScenePoseWritten(int32 idx);
+	void DoUnpinScenePoses(int32 idxStart, int32 idxSubtree);
+	uint8 DoComputeScenePose(int32 idx, HPose& outPose) const;
+	HPose DoGetCurrentScenePoseByIndex(int32 idx) const;
+	void DoUpdateScenePoseFromRelative(int32 idx);
+	void DoUpdateRelativePoseFromScene(int32 idx);
+	void DoPropagateScenePoses(int32 idx);
+	void DoConcatScenePosesInRange(int32 idxStart, int32 idxEnd);
+
+	template<typename T> void DoWriteBatchScenePose(int32 idx, const T& write);
+	template<typename T> void DoSetScenePosesBatch(const ObjectID* pIDs, const T* pPoses, int32 n);
+	template<typename T> void DoSetScenePosesBatchByIndex(const int32* pIndices, const T* pPoses, int32 n);
 
 };
 
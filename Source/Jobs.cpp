@@ -0,0 +1,126 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "Jobs.h"
+
+// index of the queue owned by this thread; the main thread (and any other
+// thread which isn't a worker) uses queue zero
+static thread_local int32 tlsWorkerIdx = 0;
+
+JobSystem::JobSystem(int32 workerCount) {
+	if (workerCount < 0)
+		workerCount = eastl::max(int32(std::thread::hardware_concurrency()) - 1, 0);
+
+	queues.reset(new WorkerQueue[workerCount + 1]);
+	workers.reserve(workerCount);
+	for (int32 it = 0; it < workerCount; ++it)
+		workers.push_back(std::thread([this, it]() { WorkerMain(it + 1); }));
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+	}
+	wakeup.notify_all();
+	for (auto& it : workers)
+		it.join();
+}
+
+void JobSystem::Submit(JobCounter& counter, JobFunc func, void* pContext, int32 begin, int32 end) {
+	counter.remaining.fetch_add(1, std::memory_order_relaxed);
+
+	auto& queue = queues[tlsWorkerIdx];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(Job { func, pContext, begin, end, &counter });
+	}
+
+	// bump the pending count under the sleep-lock so that sleeping
+	// workers (and waiters) can't miss the wakeup between checking and waiting
+	bool bWaiters;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		pendingCount.fetch_add(1, std::memory_order_relaxed);
+		bWaiters = waiterCount > 0;
+	}
+	wakeup.notify_one();
+	if (bWaiters)
+		completion.notify_all();
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	let workerIdx = tlsWorkerIdx;
+	while (!counter.IsDone()) {
+		Job job;
+		if (TryGetJob(workerIdx, job)) {
+			Execute(job);
+			continue;
+		}
+
+		// the rest are running on workers, so sleep until the last one finishes
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		++waiterCount;
+		completion.wait(lock, [this, &counter]() { return counter.IsDone() || pendingCount.load(std::memory_order_relaxed) > 0; });
+		--waiterCount;
+	}
+}
+
+void JobSystem::WorkerMain(int32 workerIdx) {
+	tlsWorkerIdx = workerIdx;
+	for(;;) {
+		Job job;
+		if (TryGetJob(workerIdx, job)) {
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeup.wait(lock, [this]() { return quit || pendingCount.load(std::memory_order_relaxed) > 0; });
+		if (quit)
+			return;
+	}
+}
+
+bool JobSystem::TryGetJob(int32 workerIdx, Job& outJob) {
+	if (pendingCount.load(std::memory_order_relaxed) == 0)
+		return false;
+
+	// pop our own most-recent job first (it's likely still in cache)
+	{
+		auto& queue = queues[workerIdx];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			outJob = queue.jobs.back();
+			queue.jobs.pop_back();
+			pendingCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// otherwise steal the oldest job from someone else
+	let queueCount = GetThreadCount();
+	for (int32 it = 1; it < queueCount; ++it) {
+		auto& queue = queues[(workerIdx + it) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			outJob = queue.jobs.front();
+			queue.jobs.pop_front();
+			pendingCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(const Job& job) {
+	job.func(job.pContext, job.begin, job.end);
+
+	// (the counter may be gone as soon as it's done, so it's not touched after)
+	if (job.pCounter->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		if (waiterCount > 0)
+			completion.notify_all();
+	}
+}
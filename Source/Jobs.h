@@ -0,0 +1,90 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Common.h"
+#include <EASTL/algorithm.h>
+#include <EASTL/deque.h>
+#include <EASTL/unique_ptr.h>
+#include <EASTL/vector.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Simple work-stealing job system. Each worker (plus the main thread, at index 0)
+// owns a queue, popping its own work LIFO and stealing from the others FIFO. Jobs 
+// are plain function-pointers over an index-range, so a parallel-for submits one
+// job per chunk with no allocations beyond the queue storage.
+
+typedef void (*JobFunc)(void* pContext, int32 begin, int32 end);
+
+struct JobCounter {
+	std::atomic<int32> remaining { 0 };
+	bool IsDone() const { return remaining.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+	JobFunc func;
+	void* pContext;
+	int32 begin;
+	int32 end;
+	JobCounter* pCounter;
+};
+
+class JobSystem {
+private:
+
+	struct WorkerQueue {
+		std::mutex mutex;
+		eastl::deque<Job> jobs;
+	};
+
+	eastl::unique_ptr<WorkerQueue[]> queues;
+	eastl::vector<std::thread> workers;
+	std::atomic<int32> pendingCount { 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wakeup;     // workers, when jobs are queued
+	std::condition_variable completion; // waiters, when a counter finishes or jobs are queued
+	int32 waiterCount = 0;              // (guarded by sleepMutex)
+	bool quit = false;
+
+public:
+
+	// default worker count leaves one core for the main thread
+	explicit JobSystem(int32 workerCount = INVALID_INDEX);
+	~JobSystem();
+
+	int32 GetWorkerCount() const { return int32(workers.size()); }
+	int32 GetThreadCount() const { return int32(workers.size()) + 1; }
+
+	void Submit(JobCounter& counter, JobFunc func, void* pContext, int32 begin, int32 end);
+
+	// The calling thread helps execute jobs until the counter is done, sleeping
+	// while there's nothing queued for it to help with
+	void Wait(JobCounter& counter);
+
+	// Calls fn(begin, end) over [0, count) in chunks of grainSize and waits for completion
+	template<typename Fn>
+	void ParallelFor(int32 count, int32 grainSize, const Fn& fn) {
+		if (count <= 0)
+			return;
+
+		if (count <= grainSize || workers.empty()) {
+			fn(0, count);
+			return;
+		}
+
+		let thunk = [](void* pContext, int32 begin, int32 end) { (*static_cast<const Fn*>(pContext))(begin, end); };
+		JobCounter counter;
+		for (int32 it = 0; it < count; it += grainSize)
+			Submit(counter, thunk, const_cast<Fn*>(&fn), it, eastl::min(it + grainSize, count));
+		Wait(counter);
+	}
+
+private:
+
+	void WorkerMain(int32 workerIdx);
+	bool TryGetJob(int32 workerIdx, Job& outJob);
+	void Execute(const Job& job);
+};
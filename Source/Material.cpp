@@ -2,6 +2,7 @@
 // (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
 
 #include "Material.h"
+#include "AssetCache.h"
 #include "Texture.h"
 #include "World.h"
 
@@ -9,7 +10,10 @@
 #include <EASTL/string.h>
 #include <EASTL/vector.h>
 
-MaterialAssetData* ImportMaterialAssetDataFromSource(const char* configPath) {
+// bump when the import process changes, to invalidate cooked materials
+#define MATERIAL_IMPORTER_VERSION 1
+
+static MaterialAssetData* DoImportMaterialAssetData(const char* configPath) {
 	using namespace eastl::literals::string_literals;
 
 	struct TextureVarConfig {
@@ -85,12 +89,31 @@ MaterialAssetData* ImportMaterialAssetDataFromSource(const char* configPath) {
 	return result;
 }
 
+AssetDataRef ImportMaterialAssetDataFromSource(const char* configPath) {
+
+	// materials are cooked from just their config, so the cache key covers everything
+	const AssetCacheEntry cacheEntry(configPath, MaterialAssetData::SCHEMA, MATERIAL_IMPORTER_VERSION);
+	if (auto cached = cacheEntry.TryLoad())
+		return cached;
+
+	let result = DoImportMaterialAssetData(configPath);
+	if (result)
+		cacheEntry.Store(result);
+	return AssetDataRef(result);
+}
+
 Material::Material(ObjectID aID) : ObjectComponent(aID) {}
 
 bool MaterialPass::TryLoad(Graphics* pGraphics, class Material* pCaller, const MaterialAssetData *pData, int Idx) {
 	if (IsLoaded())
 		return true;
 
+	// headless: there's no device to compile for, so the pass only feeds draw tallies
+	if (pGraphics->GetDisplay()->IsHeadless()) {
+		loaded = true;
+		return true;
+	}
+
 	CHECK_ASSERT(pData->TextureCount < 16);
 	struct TextureVariable {
 		const char* name;
@@ -119,9 +142,6 @@ bool MaterialPass::TryLoad(Graphics* pGraphics, class Material* pCaller, const M
 	PipelineStateCreateInfo Args;
 	auto& PSODesc = Args.PSODesc;
 
-	let descName = "PSO_" + nameStr;
-	PSODesc.Name = descName.c_str();
-
 	PSODesc.IsComputePipeline = false;
 	PSODesc.GraphicsPipeline.NumRenderTargets = 1;
 	PSODesc.GraphicsPipeline.RTVFormats[0] = pSwapChain->GetDesc().ColorBufferFormat;
@@ -135,17 +155,6 @@ bool MaterialPass::TryLoad(Graphics* pGraphics, class Material* pCaller, const M
 	SCI.SourceLanguage = SHADER_SOURCE_LANGUAGE_HLSL;
 	SCI.UseCombinedTextureSamplers = true; // For GL Compat
 	SCI.pShaderSourceStreamFactory = pGraphics->GetShaderSourceStream();
-	RefCntAutoPtr<IShader> pVS;
-	{
-		let vsDescName = "VS_" + nameStr;
-		SCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
-		SCI.EntryPoint = "main";
-		SCI.Desc.Name = vsDescName.c_str();
-		SCI.FilePath = pData->VertexShaderPath();
-		pDevice->CreateShader(SCI, &pVS);
-		if (!pVS)
-			return false;
-	}
 	RefCntAutoPtr<IShader> pPS;
 	{
 		let psDescName = "PS_" + nameStr;
@@ -158,15 +167,14 @@ bool MaterialPass::TryLoad(Graphics* pGraphics, class Material* pCaller, const M
 			return false;
 	}
 
-	PSODesc.GraphicsPipeline.InputLayout.LayoutElements = MeshVertexLayoutElems;
-	PSODesc.GraphicsPipeline.InputLayout.NumElements = _countof(MeshVertexLayoutElems);
-	PSODesc.GraphicsPipeline.pVS = pVS;
+	PSODesc.GraphicsPipeline.InputLayout.NumElements = _countof(InstancedMeshVertexLayoutElems);
 	PSODesc.GraphicsPipeline.pPS = pPS;
 
 	PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
 
 	ShaderResourceVariableDesc Vars[16];
-	Vars[0] = { SHADER_TYPE_PIXEL, "g_ShadowMap", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE };
+	// dynamic, since the shadow map is rebound into existing SRBs whenever its settings change
+	Vars[0] = { SHADER_TYPE_PIXEL, "g_ShadowMap", SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC };
 
 	for(auto it=0u; it<pData->TextureCount; ++it) {
 		Vars[it+1] = { SHADER_TYPE_PIXEL, tv[it].name, SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE };
@@ -190,19 +198,42 @@ bool MaterialPass::TryLoad(Graphics* pGraphics, class Material* pCaller, const M
 	PSODesc.ResourceLayout.StaticSamplers = StaticSamplers;
 	PSODesc.ResourceLayout.NumStaticSamplers = pData->TextureCount + 1;
 
-	pDevice->CreatePipelineState(Args, &pMaterialPipelineState);
-	if (!pMaterialPipelineState)
-		return false;
+	// the vertex shader is compiled for each mesh vertex format, decoding its attributes
+	static const char* FormatSuffixes[MESH_VERTEX_FORMAT_COUNT] { "", "_Compressed" };
+	for(uint32 format=0; format<MESH_VERTEX_FORMAT_COUNT; ++format) {
+		RefCntAutoPtr<IShader> pVS;
+		{
+			let vsDescName = "VS_" + nameStr + FormatSuffixes[format];
+			SCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
+			SCI.EntryPoint = "main";
+			SCI.Desc.Name = vsDescName.c_str();
+			SCI.FilePath = pData->VertexShaderPath();
+			SCI.Macros = GetInstancedMeshShaderMacros(format);
+			pDevice->CreateShader(SCI, &pVS);
+			SCI.Macros = nullptr;
+			if (!pVS)
+				return false;
+		}
+
+		let descName = "PSO_" + nameStr + FormatSuffixes[format];
+		PSODesc.Name = descName.c_str();
+		PSODesc.GraphicsPipeline.InputLayout.LayoutElements = GetInstancedMeshLayoutElems(format);
+		PSODesc.GraphicsPipeline.pVS = pVS;
+		pDevice->CreatePipelineState(Args, &pMaterialPipelineStates[format]);
+		if (!pMaterialPipelineStates[format])
+			return false;
 
-	pMaterialPipelineState->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(pGraphics->GetRenderConstants());
-	pMaterialPipelineState->CreateShaderResourceBinding(&pMaterialResourceBinding, true);
+		pGraphics->BindRenderConstants(pMaterialPipelineStates[format]);
+		pMaterialPipelineStates[format]->CreateShaderResourceBinding(&pMaterialResourceBindings[format], true);
+	}
+	loaded = true;
 
-	if (let pShadowMapVar = pMaterialResourceBinding->GetVariableByName(SHADER_TYPE_PIXEL, "g_ShadowMap"))
-		pShadowMapVar->Set(pGraphics->GetShadowMapSRV());
+	SetShadowMap(pGraphics->GetShadowMapSRV());
 
-	for(auto it=0u; it<pData->TextureCount; ++it)
-		if (let pVar = pMaterialResourceBinding->GetVariableByName(SHADER_TYPE_PIXEL, tv[it].name))
-			pVar->Set(tv[it].pTexture->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+	for(let& pBinding : pMaterialResourceBindings)
+		for(auto it=0u; it<pData->TextureCount; ++it)
+			if (let pVar = pBinding->GetVariableByName(SHADER_TYPE_PIXEL, tv[it].name))
+				pVar->Set(tv[it].pTexture->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
 			
 
 	return true;
@@ -213,16 +244,13 @@ bool MaterialPass::TryUnload(Graphics* pGraphics) {
 	return false;
 }
 
-bool MaterialPass::Bind(Graphics* pGraphics) {
-	if (!IsLoaded())
-		return false;
-	let pContext = pGraphics->GetDisplay()->GetContext();
-	pContext->SetPipelineState(pMaterialPipelineState);
-	pContext->CommitShaderResources(pMaterialResourceBinding, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-	return true;
+void MaterialPass::SetShadowMap(ITextureView* pShadowMapSRV) {
+	for(let& pBinding : pMaterialResourceBindings)
+		if (pBinding)
+			if (let pShadowMapVar = pBinding->GetVariableByName(SHADER_TYPE_PIXEL, "g_ShadowMap"))
+				pShadowMapVar->Set(pShadowMapSRV);
 }
 
-
 MaterialRegistry::MaterialRegistry(World* aWorld) : pWorld(aWorld) {
 }
 
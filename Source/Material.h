@@ -4,6 +4,7 @@
 #pragma once
 #include "AssetData.h"
 #include "Display.h"
+#include "Mesh.h"
 #include "Name.h"
 #include "ObjectPool.h"
 
@@ -25,12 +26,14 @@ struct MaterialAssetData : AssetDataHeader {
 	AssetDataReader TextureVariables() const { return AssetDataReader(this, TextureVariablesOffset); }
 };
 
-MaterialAssetData* ImportMaterialAssetDataFromSource(const char* configPath);
+AssetDataRef ImportMaterialAssetDataFromSource(const char* configPath);
 
+// Passes compile a pipeline (and binding) for each mesh vertex format
 class MaterialPass {
 private:
-	RefCntAutoPtr<IPipelineState>         pMaterialPipelineState;
-	RefCntAutoPtr<IShaderResourceBinding> pMaterialResourceBinding;
+	RefCntAutoPtr<IPipelineState>         pMaterialPipelineStates[MESH_VERTEX_FORMAT_COUNT];
+	RefCntAutoPtr<IShaderResourceBinding> pMaterialResourceBindings[MESH_VERTEX_FORMAT_COUNT];
+	bool loaded = false;
 
 public:
 
@@ -40,11 +43,12 @@ public:
 	MaterialPass(const MaterialPass&) = delete;
 	MaterialPass& operator=(const MaterialPass&) = delete;
 	
-	bool IsLoaded() const { return pMaterialPipelineState; }
+	bool IsLoaded() const { return loaded; }
+	IPipelineState* GetPipelineState(uint32 format) { return pMaterialPipelineStates[format]; }
+	IShaderResourceBinding* GetResourceBinding(uint32 format) { return pMaterialResourceBindings[format]; }
 	bool TryLoad(Graphics* pGraphics, class Material* pCaller, const MaterialAssetData *pData, int Idx);
 	bool TryUnload(Graphics* pGraphics);
-
-	bool Bind(Graphics* pGraphics);
+	void SetShadowMap(ITextureView* pShadowMapSRV);
 };
 
 class Material : public ObjectComponent {
@@ -5,4 +5,198 @@
 
 //static_assert( sizeof(HPose) == sizeof(HPoseWithFlags) );
 static_assert( std::alignment_of<quat>::value == 4);
-static_assert( std::alignment_of<vec3>::value == 4);
\ No newline at end of file
+static_assert( std::alignment_of<vec3>::value == 4);
+#include <cstddef>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+static_assert( offsetof(quat, x) == 0 && offsetof(quat, w) == 3 * sizeof(float) );
+static_assert( sizeof(HPose) == 10 * sizeof(float) );
+static_assert( offsetof(HPose, rotation) == 0 );
+static_assert( offsetof(HPose, position) == 4 * sizeof(float) );
+static_assert( offsetof(HPose, scale) == 7 * sizeof(float) );
+
+namespace {
+
+// Structure-of-Arrays view of poses, one pose per lane (four SIMD lanes, or a single
+// float "lane" for lone poses)
+template<typename Lane>
+struct PoseLanes {
+	Lane qx, qy, qz, qw;
+	Lane px, py, pz;
+	Lane sx, sy, sz;
+};
+
+// the lane math is written once against these, so the SIMD and float versions do the
+// same operations in the same order, and round identically
+inline __m128 Add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+inline __m128 Sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+inline __m128 Mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+	// mask ? a : b
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline float Add(float a, float b) { return a + b; }
+inline float Sub(float a, float b) { return a - b; }
+inline float Mul(float a, float b) { return a * b; }
+inline float Select(bool mask, float a, float b) { return mask ? a : b; }
+
+inline void LoadLanes(PoseLanes<__m128>& out, const HPose* p0, const HPose* p1, const HPose* p2, const HPose* p3) {
+	// rotation: [x y z w]
+	__m128 r0 = _mm_loadu_ps(reinterpret_cast<const float*>(p0));
+	__m128 r1 = _mm_loadu_ps(reinterpret_cast<const float*>(p1));
+	__m128 r2 = _mm_loadu_ps(reinterpret_cast<const float*>(p2));
+	__m128 r3 = _mm_loadu_ps(reinterpret_cast<const float*>(p3));
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	out.qx = r0; out.qy = r1; out.qz = r2; out.qw = r3;
+
+	// position: [px py pz sx]
+	__m128 a0 = _mm_loadu_ps(reinterpret_cast<const float*>(p0) + 4);
+	__m128 a1 = _mm_loadu_ps(reinterpret_cast<const float*>(p1) + 4);
+	__m128 a2 = _mm_loadu_ps(reinterpret_cast<const float*>(p2) + 4);
+	__m128 a3 = _mm_loadu_ps(reinterpret_cast<const float*>(p3) + 4);
+	_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+	out.px = a0; out.py = a1; out.pz = a2;
+
+	// scale: [pz sx sy sz] (offset so the load stays inside the pose)
+	__m128 b0 = _mm_loadu_ps(reinterpret_cast<const float*>(p0) + 6);
+	__m128 b1 = _mm_loadu_ps(reinterpret_cast<const float*>(p1) + 6);
+	__m128 b2 = _mm_loadu_ps(reinterpret_cast<const float*>(p2) + 6);
+	__m128 b3 = _mm_loadu_ps(reinterpret_cast<const float*>(p3) + 6);
+	_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+	out.sx = b1; out.sy = b2; out.sz = b3;
+}
+
+inline void StoreLanes(HPose* const* pOut, const PoseLanes<__m128>& in, int32 n) {
+	__m128 r0 = in.qx, r1 = in.qy, r2 = in.qz, r3 = in.qw;
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	__m128 a0 = in.px, a1 = in.py, a2 = in.pz, a3 = in.sx;
+	_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+	__m128 b0 = in.pz, b1 = in.sx, b2 = in.sy, b3 = in.sz;
+	_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+	const __m128 rows[3][4] = { { r0, r1, r2, r3 }, { a0, a1, a2, a3 }, { b0, b1, b2, b3 } };
+	for (int32 it = 0; it < n; ++it) {
+		let pDst = reinterpret_cast<float*>(pOut[it]);
+		_mm_storeu_ps(pDst, rows[0][it]);
+		_mm_storeu_ps(pDst + 4, rows[1][it]);
+		_mm_storeu_ps(pDst + 6, rows[2][it]);
+	}
+}
+
+inline void LoadLane(PoseLanes<float>& out, const HPose& pose) {
+	out.qx = pose.rotation.x; out.qy = pose.rotation.y; out.qz = pose.rotation.z; out.qw = pose.rotation.w;
+	out.px = pose.position.x; out.py = pose.position.y; out.pz = pose.position.z;
+	out.sx = pose.scale.x; out.sy = pose.scale.y; out.sz = pose.scale.z;
+}
+
+inline void StoreLane(HPose& out, const PoseLanes<float>& in) {
+	out.rotation.x = in.qx; out.rotation.y = in.qy; out.rotation.z = in.qz; out.rotation.w = in.qw;
+	out.position.x = in.px; out.position.y = in.py; out.position.z = in.pz;
+	out.scale.x = in.sx; out.scale.y = in.sy; out.scale.z = in.sz;
+}
+
+inline __m128 LaneMask(const PoseMask* const* pMasks, uint8 bit) {
+	return _mm_castsi128_ps(_mm_set_epi32(
+		(pMasks[3]->ignoreFlags & bit) ? -1 : 0,
+		(pMasks[2]->ignoreFlags & bit) ? -1 : 0,
+		(pMasks[1]->ignoreFlags & bit) ? -1 : 0,
+		(pMasks[0]->ignoreFlags & bit) ? -1 : 0
+	));
+}
+
+template<typename Lane, typename LaneBool>
+inline void ConcatLanes(PoseLanes<Lane>& result, PoseLanes<Lane>& lhs, const PoseLanes<Lane>& rhs, LaneBool ignorePosition, LaneBool ignoreRotation, LaneBool ignoreScale, Lane zero, Lane one, Lane two) {
+
+	// apply the parent mask (see PoseMask::Apply)
+	lhs.qx = Select(ignoreRotation, zero, lhs.qx);
+	lhs.qy = Select(ignoreRotation, zero, lhs.qy);
+	lhs.qz = Select(ignoreRotation, zero, lhs.qz);
+	lhs.qw = Select(ignoreRotation, one, lhs.qw);
+	lhs.px = Select(ignorePosition, zero, lhs.px);
+	lhs.py = Select(ignorePosition, zero, lhs.py);
+	lhs.pz = Select(ignorePosition, zero, lhs.pz);
+	lhs.sx = Select(ignoreScale, one, lhs.sx);
+	lhs.sy = Select(ignoreScale, one, lhs.sy);
+	lhs.sz = Select(ignoreScale, one, lhs.sz);
+
+	// rotation = lhs.rotation * rhs.rotation
+	result.qw = Sub(Sub(Sub(Mul(lhs.qw, rhs.qw), Mul(lhs.qx, rhs.qx)), Mul(lhs.qy, rhs.qy)), Mul(lhs.qz, rhs.qz));
+	result.qx = Sub(Add(Add(Mul(lhs.qw, rhs.qx), Mul(lhs.qx, rhs.qw)), Mul(lhs.qy, rhs.qz)), Mul(lhs.qz, rhs.qy));
+	result.qy = Sub(Add(Add(Mul(lhs.qw, rhs.qy), Mul(lhs.qy, rhs.qw)), Mul(lhs.qz, rhs.qx)), Mul(lhs.qx, rhs.qz));
+	result.qz = Sub(Add(Add(Mul(lhs.qw, rhs.qz), Mul(lhs.qz, rhs.qw)), Mul(lhs.qx, rhs.qy)), Mul(lhs.qy, rhs.qx));
+
+	// position = lhs.position + lhs.rotation * (lhs.scale * rhs.position)
+	let vx = Mul(lhs.sx, rhs.px);
+	let vy = Mul(lhs.sy, rhs.py);
+	let vz = Mul(lhs.sz, rhs.pz);
+	let uvx = Sub(Mul(lhs.qy, vz), Mul(lhs.qz, vy));
+	let uvy = Sub(Mul(lhs.qz, vx), Mul(lhs.qx, vz));
+	let uvz = Sub(Mul(lhs.qx, vy), Mul(lhs.qy, vx));
+	let uuvx = Sub(Mul(lhs.qy, uvz), Mul(lhs.qz, uvy));
+	let uuvy = Sub(Mul(lhs.qz, uvx), Mul(lhs.qx, uvz));
+	let uuvz = Sub(Mul(lhs.qx, uvy), Mul(lhs.qy, uvx));
+	result.px = Add(lhs.px, Add(vx, Mul(Add(Mul(uvx, lhs.qw), uuvx), two)));
+	result.py = Add(lhs.py, Add(vy, Mul(Add(Mul(uvy, lhs.qw), uuvy), two)));
+	result.pz = Add(lhs.pz, Add(vz, Mul(Add(Mul(uvz, lhs.qw), uuvz), two)));
+
+	// scale = lhs.scale * rhs.scale
+	result.sx = Mul(lhs.sx, rhs.sx);
+	result.sy = Mul(lhs.sy, rhs.sy);
+	result.sz = Mul(lhs.sz, rhs.sz);
+}
+
+}
+
+void ConcatPoses(HPose* pScenePoses, const HPose* pRelativePoses, const PoseMask* pMasks, const int32* pParents, const int32* pIndices, int32 n) {
+	CHECK_ASSERT(n >= 0 && n <= POSE_BATCH_WIDTH);
+	if (n == 0)
+		return;
+
+	// a lone pose (e.g. in a deep chain) isn't worth the transposes
+	if (n == 1) {
+		let idx = pIndices[0];
+		CHECK_ASSERT(pParents[idx] >= 0);
+		pScenePoses[idx] = ConcatPose(pMasks[idx], pScenePoses[pParents[idx]], pRelativePoses[idx]);
+		return;
+	}
+
+	// pad unused lanes by repeating the last index; they're computed but never stored
+	HPose* pOut[POSE_BATCH_WIDTH];
+	const HPose* pParentPoses[POSE_BATCH_WIDTH];
+	const HPose* pRelatives[POSE_BATCH_WIDTH];
+	const PoseMask* pLaneMasks[POSE_BATCH_WIDTH];
+	for (int32 it = 0; it < POSE_BATCH_WIDTH; ++it) {
+		let idx = pIndices[it < n ? it : n - 1];
+		CHECK_ASSERT(pParents[idx] >= 0);
+		pOut[it] = pScenePoses + idx;
+		pParentPoses[it] = pScenePoses + pParents[idx];
+		pRelatives[it] = pRelativePoses + idx;
+		pLaneMasks[it] = pMasks + idx;
+	}
+
+	const PoseMask positionBit(true, false, false);
+	const PoseMask rotationBit(false, true, false);
+	const PoseMask scaleBit(false, false, true);
+	PoseLanes<__m128> lhs, rhs, result;
+	LoadLanes(lhs, pParentPoses[0], pParentPoses[1], pParentPoses[2], pParentPoses[3]);
+	LoadLanes(rhs, pRelatives[0], pRelatives[1], pRelatives[2], pRelatives[3]);
+	ConcatLanes(
+		result, lhs, rhs, 
+		LaneMask(pLaneMasks, positionBit.ignoreFlags), LaneMask(pLaneMasks, rotationBit.ignoreFlags), LaneMask(pLaneMasks, scaleBit.ignoreFlags), 
+		_mm_setzero_ps(), _mm_set1_ps(1.f), _mm_set1_ps(2.f)
+	);
+	StoreLanes(pOut, result, n);
+}
+
+HPose ConcatPose(const PoseMask& mask, const HPose& lhs, const HPose& rhs) {
+	PoseLanes<float> lhsLane, rhsLane, result;
+	LoadLane(lhsLane, lhs);
+	LoadLane(rhsLane, rhs);
+	ConcatLanes(result, lhsLane, rhsLane, bool(mask.ignorePosition), bool(mask.ignoreRotation), bool(mask.ignoreScale), 0.f, 1.f, 2.f);
+
+	HPose pose;
+	StoreLane(pose, result);
+	return pose;
+}
@@ -208,6 +208,20 @@ union PoseMask {
 	}
 };
 
+// Batch-Concat Kernel, computing up to four independent hierarchy poses at once:
+//   pScenePoses[idx] = pMasks[idx].Concat(pScenePoses[pParents[idx]], pRelativePoses[idx])
+// for each idx in pIndices[0..n). Poses are transposed into SIMD lanes on load, and 
+// masks are applied with a lane-select instead of the float-multiply used by PoseMask.
+// No index may be the parent of another index in the same call.
+#define POSE_BATCH_WIDTH 4
+void ConcatPoses(HPose* pScenePoses, const HPose* pRelativePoses, const PoseMask* pMasks, const int32* pParents, const int32* pIndices, int32 n);
+
+// Single-pose version of the kernel (the same lane math in plain floats, which ConcatPoses
+// also uses for batches of one), returning mask.Concat(lhs, rhs) with exactly the same
+// rounding as ConcatPoses (PoseMask::Concat can differ in the last bit), so hierarchies can
+// mix the two and still compute identical scene poses.
+HPose ConcatPose(const PoseMask& mask, const HPose& lhs, const HPose& rhs);
+
 inline bool ContainsNaN(float f) { return glm::isnan(f); }
 inline bool ContainsNaN(const vec3& v) { return glm::isnan(v.x) || glm::isnan(v.y) || glm::isnan(v.z); }
 inline bool ContainsNaN(const quat& q) { return glm::isnan(q.x) || glm::isnan(q.y) || glm::isnan(q.z) || glm::isnan(q.w); }
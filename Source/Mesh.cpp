@@ -2,9 +2,13 @@
 // (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
 
 #include "Mesh.h"
+#include "AssetCache.h"
+#include "MeshOptimizer.h"
+#include "Simplify.h"
 #include "World.h"
 
 #include <ini.h>
+#include <atomic>
 #include <EASTL/string.h>
 
 #include <assimp/Importer.hpp>
@@ -15,6 +19,7 @@
 #include <assimp/LogStream.hpp>
 
 
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/norm.hpp>
 
 static_assert(sizeof(uint) == 4);
@@ -27,7 +32,60 @@ const LayoutElement MeshVertexLayoutElems[4]{
 	LayoutElement{ 3, 0, 4, VT_UINT8,   true }
 };
 
-AABB ComputeMeshAABB(MeshVertex* pVertices, uint count) {
+const LayoutElement CompressedMeshVertexLayoutElems[4]{
+	LayoutElement{ 0, 0, 4, VT_UINT16,  true },
+	LayoutElement{ 1, 0, 2, VT_INT16,   true },
+	LayoutElement{ 2, 0, 2, VT_FLOAT16, false },
+	LayoutElement{ 3, 0, 4, VT_UINT8,   true }
+};
+
+static_assert(sizeof(CompressedMeshVertex) == 20);
+
+const LayoutElement InstancedMeshVertexLayoutElems[11]{
+	LayoutElement{ 0, 0, 3, VT_FLOAT32, false },
+	LayoutElement{ 1, 0, 3, VT_FLOAT32, false },
+	LayoutElement{ 2, 0, 2, VT_FLOAT32, false },
+	LayoutElement{ 3, 0, 4, VT_UINT8,   true },
+	LayoutElement{ 4, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 5, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 6, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 7, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 8, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 9, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 10, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE }
+};
+
+const LayoutElement InstancedCompressedMeshVertexLayoutElems[11]{
+	LayoutElement{ 0, 0, 4, VT_UINT16,  true },
+	LayoutElement{ 1, 0, 2, VT_INT16,   true },
+	LayoutElement{ 2, 0, 2, VT_FLOAT16, false },
+	LayoutElement{ 3, 0, 4, VT_UINT8,   true },
+	LayoutElement{ 4, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 5, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 6, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 7, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 8, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 9, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE },
+	LayoutElement{ 10, 1, 4, VT_FLOAT32, false, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE }
+};
+
+static_assert(sizeof(MeshInstance) == 7 * sizeof(vec4));
+
+const ShaderMacro CompressedMeshShaderMacros[2]{
+	{ "COMPRESSED_VERTICES", "1" },
+	{ nullptr, nullptr }
+};
+
+const LayoutElement* GetInstancedMeshLayoutElems(uint32 format) {
+	static_assert(_countof(InstancedMeshVertexLayoutElems) == _countof(InstancedCompressedMeshVertexLayoutElems));
+	return format == MESH_VERTEX_FORMAT_COMPRESSED ? InstancedCompressedMeshVertexLayoutElems : InstancedMeshVertexLayoutElems;
+}
+
+const ShaderMacro* GetInstancedMeshShaderMacros(uint32 format) {
+	return format == MESH_VERTEX_FORMAT_COMPRESSED ? CompressedMeshShaderMacros : nullptr;
+}
+
+AABB ComputeMeshAABB(const MeshVertex* pVertices, uint count) {
 	CHECK_ASSERT(count > 0);
 	AABB result (pVertices[0].position);
 	for(uint it=1; it<count; ++it)
@@ -35,7 +93,158 @@ AABB ComputeMeshAABB(MeshVertex* pVertices, uint count) {
 	return result;
 }
 
-MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
+CompressedMeshVertex CompressMeshVertex(const MeshVertex& vertex, const AABB& bounds) {
+	CompressedMeshVertex result;
+
+	let size = bounds.Size();
+	let invSize = vec3(size.x > 0.f ? 1.f / size.x : 0.f, size.y > 0.f ? 1.f / size.y : 0.f, size.z > 0.f ? 1.f / size.z : 0.f);
+	let unitPosition = glm::clamp((vertex.position - bounds.min) * invSize, vec3(0.f), vec3(1.f));
+	for(int it=0; it<3; ++it)
+		result.position[it] = glm::packUnorm1x16(unitPosition[it]);
+	result.position[3] = 0;
+
+	// project onto the octahedron |x|+|y|+|z|=1, folding its lower half out over the diagonals
+	let manhattan = glm::abs(vertex.normal.x) + glm::abs(vertex.normal.y) + glm::abs(vertex.normal.z);
+	let n = manhattan > 0.f ? vertex.normal / manhattan : vec3(0.f, 0.f, 1.f);
+	auto octahedral = vec2(n.x, n.y);
+	if (n.z < 0.f) {
+		let signs = vec2(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+		octahedral = (1.f - glm::abs(vec2(n.y, n.x))) * signs;
+	}
+	for(int it=0; it<2; ++it)
+		result.normal[it] = int16(glm::packSnorm1x16(octahedral[it]));
+
+	for(int it=0; it<2; ++it)
+		result.uv[it] = glm::packHalf1x16(vertex.uv[it]);
+	result.color = vertex.color;
+	return result;
+}
+
+mat4 GetDecompressTransform(const AABB& bounds) {
+	return glm::translate(bounds.min) * glm::scale(bounds.Size());
+}
+
+// bump when the import process changes, to invalidate cooked meshes
+#define MESH_IMPORTER_VERSION 4
+
+#ifndef MESH_LOD_REDUCTION
+#	define MESH_LOD_REDUCTION 0.5f // each generated LOD targets this fraction of the previous one's indices
+#endif
+
+static std::atomic<uint32> gCookedMeshCount { 0 };
+static std::atomic<uint64> gCookedTriangleCount { 0 };
+static std::atomic<uint64> gCacheMissesBefore { 0 };
+static std::atomic<uint64> gCacheMissesAfter { 0 };
+
+static MeshAssetData* DoCreateMeshAssetData(const eastl::vector<MeshVertex>& vertices, const eastl::vector<uint32>& indices, MeshVertexFormat format) {
+	let numVerts = uint32(vertices.size());
+	let numIndices = uint32(indices.size());
+
+	// simplify the full-resolution mesh to successively smaller targets, stopping once
+	// a LOD saves less than a tenth of the previous one (e.g. only borders and seams remain)
+	eastl::vector<vec3> positions;
+	positions.reserve(numVerts);
+	for(let& it : vertices)
+		positions.push_back(it.position);
+
+	eastl::vector<uint32> lodIndices (indices.begin(), indices.end()); // (every LOD, back to back)
+	uint32 lodIndexCounts[MESH_MAX_LODS] = { numIndices };
+	uint32 lodCount = 1;
+	while(lodCount < MESH_MAX_LODS && numIndices > 0) {
+		let prevCount = lodIndexCounts[lodCount - 1];
+		let targetCount = 3 * uint32(MESH_LOD_REDUCTION * (prevCount / 3));
+		let offset = uint32(lodIndices.size());
+		lodIndices.resize(offset + numIndices);
+		let count = SimplifyMesh(lodIndices.data() + offset, indices.data(), numIndices, positions.data(), numVerts, targetCount);
+		if (count == 0 || 10 * count > 9 * prevCount) {
+			lodIndices.resize(offset);
+			break;
+		}
+		lodIndices.resize(offset + count);
+		lodIndexCounts[lodCount++] = count;
+	}
+
+	// order triangles for the post-transform cache (and, at full resolution, for overdraw
+	// too, as LODs are drawn too small for it to matter), then number vertices by first use
+	eastl::vector<MeshVertex> orderedVertices (numVerts);
+	if (numIndices > 0) {
+		let acmrBefore = ComputeVertexCacheMissRatio(indices.data(), numIndices, numVerts);
+		eastl::vector<uint32> scratch (numIndices);
+		auto pLod = lodIndices.data();
+		for(uint32 it=0; it<lodCount; ++it) {
+			OptimizeVertexCache(scratch.data(), pLod, lodIndexCounts[it], numVerts);
+			if (it == 0)
+				OptimizeOverdraw(pLod, scratch.data(), numIndices, positions.data(), numVerts);
+			else
+				memcpy(pLod, scratch.data(), lodIndexCounts[it] * sizeof(uint32));
+			pLod += lodIndexCounts[it];
+		}
+		let acmrAfter = ComputeVertexCacheMissRatio(lodIndices.data(), numIndices, numVerts);
+		++gCookedMeshCount;
+		gCookedTriangleCount += numIndices / 3;
+		gCacheMissesBefore += uint64(acmrBefore * (numIndices / 3) + 0.5f);
+		gCacheMissesAfter += uint64(acmrAfter * (numIndices / 3) + 0.5f);
+
+		eastl::vector<uint32> remap (numVerts);
+		OptimizeVertexFetch(remap.data(), lodIndices.data(), numIndices, numVerts);
+		for(auto& it : lodIndices)
+			it = remap[it];
+		for(uint32 it=0; it<numVerts; ++it)
+			orderedVertices[remap[it]] = vertices[it];
+	} else {
+		orderedVertices = vertices;
+	}
+
+	// 16-bit indices when there are fewer than 65536 vertices (which leaves out 0xffff,
+	// the index some APIs reserve to restart strips)
+	let indexSize = numVerts <= 0xffff ? uint32(sizeof(uint16)) : uint32(sizeof(uint32));
+
+	let sz = uint32(
+		sizeof(MeshAssetData) +
+		sizeof(SubmeshHeader) * lodCount +
+		GetMeshVertexStride(format) * numVerts +
+		indexSize * lodIndices.size()
+	);
+
+	let result = AllocAssetData<MeshAssetData>(sz);
+	result->SubmeshCount = 1;
+	result->LodCount = lodCount;
+	result->VertexFormat = format;
+	result->BoundingBox = ComputeMeshAABB(orderedVertices.data(), numVerts);
+
+	AssetDataWriter writer(result, sizeof(MeshAssetData));
+	for(uint32 it=0; it<lodCount; ++it)
+		writer.PeekAndSeek<SubmeshHeader>();
+
+	let vertexOffset = writer.GetOffset();
+	if (format == MESH_VERTEX_FORMAT_COMPRESSED) {
+		for(let& it : orderedVertices)
+			writer.WriteValue(CompressMeshVertex(it, result->BoundingBox));
+	} else {
+		writer.WriteData(orderedVertices.data(), sizeof(MeshVertex) * numVerts);
+	}
+
+	auto pLodIndices = lodIndices.data();
+	for(uint32 it=0; it<lodCount; ++it) {
+		auto pSubmesh = result->LodData(0, it);
+		pSubmesh->VertexCount = numVerts;
+		pSubmesh->IndexCount = lodIndexCounts[it];
+		pSubmesh->VertexOffset = vertexOffset;
+		pSubmesh->IndexOffset = writer.GetOffset();
+		pSubmesh->IndexSize = indexSize;
+		for(uint32 idx=0; idx<lodIndexCounts[it]; ++idx) {
+			if (indexSize == sizeof(uint16))
+				writer.WriteValue(uint16(pLodIndices[idx]));
+			else
+				writer.WriteValue(pLodIndices[idx]);
+		}
+		pLodIndices += lodIndexCounts[it];
+	}
+
+	return result;
+}
+
+static MeshAssetData* DoImportMeshAssetData(const char* configPath, eastl::string& outSourcePath) {
 	using namespace eastl::literals::string_literals;
 	using namespace Assimp;
 
@@ -50,6 +259,7 @@ MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
 		float scale = 1.f;
 		float clipDistance = 0.f;
 		bool includeSkinnedMeshes = true;
+		bool compressVertices = false;
 	};
 
 
@@ -79,6 +289,8 @@ MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
 			pConfig->clipDistance = strtof(value, nullptr);
 		else if (MATCH("includeSkin"))
 			pConfig->includeSkinnedMeshes = strcmp(value, "false") != 0;
+		else if (MATCH("compressVertices"))
+			pConfig->compressVertices = strcmp(value, "true") == 0;
 		#undef SECTION
 		#undef MATCH
 		return 1;
@@ -90,7 +302,9 @@ MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
 		return nullptr;
 
 	config.path = "Assets/"s + config.path;
+	outSourcePath = config.path;
 
+	let vertexFormat = config.compressVertices ? MESH_VERTEX_FORMAT_COMPRESSED : MESH_VERTEX_FORMAT_FULL;
 	let importTransform = HPose(
 		quat(glm::radians(vec3(config.pitch, config.yaw, config.roll))),
 		vec3(config.x, config.y, config.z),
@@ -127,26 +341,9 @@ MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
 
 		let mesh = scene->mMeshes[0];
 
-		let numVerts = mesh->mNumVertices;
-		let numIndices = (3 * mesh->mNumFaces);
-
-		let sz = uint32(
-			sizeof(MeshAssetData) +
-			sizeof(SubmeshHeader) +
-			sizeof(MeshVertex) * numVerts +
-			sizeof(uint32) * numIndices
-		);
-
-		let result = AllocAssetData<MeshAssetData>(sz);
-		result->SubmeshCount = 1;
-
-		AssetDataWriter writer(result, sizeof(MeshAssetData));
-		auto pSubmesh = writer.PeekAndSeek<SubmeshHeader>();
-		pSubmesh->IndexCount = numIndices;
-		pSubmesh->VertexCount = numVerts;
-		pSubmesh->VertexOffset = writer.GetOffset();
-
-		for (uint32 it = 0; it < numVerts; ++it) {
+		eastl::vector<MeshVertex> vertices;
+		vertices.reserve(mesh->mNumVertices);
+		for (uint32 it = 0; it < mesh->mNumVertices; ++it) {
 			MeshVertex p;
 			p.position = importTransform * vec4(FromAI(mesh->mVertices[it]), 1);
 			if (config.clipDistance > 0.f && glm::length2(p.position) > config.clipDistance * config.clipDistance)
@@ -154,21 +351,20 @@ MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
 			p.uv = FromAI(mesh->mTextureCoords[0][it]);
 			p.normal = FromAI(mesh->mNormals[it]);
 			p.color = 0xffffffff; // TODO: Read Vertexc Color + Convert To Hex
-			writer.WriteValue(p);
+			vertices.push_back(p);
 		}
 
-		pSubmesh->IndexOffset = writer.GetOffset();
+		eastl::vector<uint32> indices;
+		indices.reserve(3 * mesh->mNumFaces);
 		for(uint32 it=0; it<mesh->mNumFaces; ++it) {
 			let& face = mesh->mFaces[it];
 			CHECK_ASSERT(face.mNumIndices == 3);
-			writer.WriteValue(face.mIndices[0]);
-			writer.WriteValue(face.mIndices[1]);
-			writer.WriteValue(face.mIndices[2]);
+			indices.push_back(face.mIndices[0]);
+			indices.push_back(face.mIndices[1]);
+			indices.push_back(face.mIndices[2]);
 		}
 
-		result->BoundingBox = ComputeMeshAABB(result->VertexData(0), result->SubmeshData(0)->VertexCount);
-
-		return result;
+		return DoCreateMeshAssetData(vertices, indices, vertexFormat);
 
 	}
 
@@ -287,44 +483,44 @@ MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath) {
 
 	}
 
-	let numVerts = uint32(vertices.size());
-	let numIndices = uint32(indices.size());
-
-	let sz = uint32(
-		sizeof(MeshAssetData) +
-		sizeof(SubmeshHeader) +
-		sizeof(MeshVertex) * numVerts +
-		sizeof(uint32) * numIndices
-	);
-
-	let result = AllocAssetData<MeshAssetData>(sz);
-	result->SubmeshCount = 1;
+	return DoCreateMeshAssetData(vertices, indices, vertexFormat);
+}
 
-	AssetDataWriter writer(result, sizeof(MeshAssetData));
-	auto pSubmesh = writer.PeekAndSeek<SubmeshHeader>();
-	pSubmesh->IndexCount = numIndices;
-	pSubmesh->VertexCount = numVerts;
+MeshCookStats GetMeshCookStats() {
+	MeshCookStats result;
+	result.meshCount = gCookedMeshCount.load();
+	result.triangleCount = gCookedTriangleCount.load();
+	result.cacheMissesBefore = gCacheMissesBefore.load();
+	result.cacheMissesAfter = gCacheMissesAfter.load();
+	return result;
+}
 
-	pSubmesh->VertexOffset = writer.GetOffset();
-	writer.WriteData(vertices.data(), sizeof(MeshVertex) * numVerts);
-	
-	pSubmesh->IndexOffset = writer.GetOffset();
-	writer.WriteData(indices.data(), sizeof(uint32) * numIndices);
-	
-	result->BoundingBox = ComputeMeshAABB(result->VertexData(0), result->SubmeshData(0)->VertexCount);
+AssetDataRef ImportMeshAssetDataFromSource(const char* configPath) {
+	const AssetCacheEntry cacheEntry(configPath, MeshAssetData::SCHEMA, MESH_IMPORTER_VERSION);
+	if (auto cached = cacheEntry.TryLoad())
+		return cached;
 
-	return result;
+	eastl::string sourcePath;
+	let result = DoImportMeshAssetData(configPath, sourcePath);
+	if (result)
+		cacheEntry.Store(result, sourcePath.c_str());
+	return AssetDataRef(result);
 }
 
 void MeshAssetData::ReverseWindingOrder() {
-	for(uint32 sub=0; sub<SubmeshCount; ++sub) {
-		let pSubmesh = SubmeshData(sub);
-		if (pSubmesh->IndexCount > 0) {
-			let pIndices = IndexData(sub);
+	// (LODs index the same vertices, so non-indexed submeshes have none)
+	for(uint32 idx=0; idx<HeaderCount(); ++idx) {
+		let pSubmesh = SubmeshData(idx);
+		if (pSubmesh->IndexCount > 0 && pSubmesh->IndexSize == sizeof(uint16)) {
+			let pIndices = IndexData16(idx);
+			for(uint it=0; it<pSubmesh->IndexCount; it+=3)
+				eastl::swap(pIndices[it+1], pIndices[it+2]);
+		} else if (pSubmesh->IndexCount > 0) {
+			let pIndices = IndexData(idx);
 			for(uint it=0; it<pSubmesh->IndexCount; it+=3)
 				eastl::swap(pIndices[it+1], pIndices[it+2]);
 		} else {
-			let pVertices = VertexData(sub);
+			let pVertices = VertexData(idx);
 			for(uint it=0; it<pSubmesh->VertexCount; it+=3)
 				eastl::swap(pVertices[it+1], pVertices[it+2]);
 		}
@@ -333,8 +529,8 @@ void MeshAssetData::ReverseWindingOrder() {
 
 void MeshAssetData::FlipNormals() {
 	for (uint32 sub = 0; sub < SubmeshCount; ++sub) {
-		let pSubmesh = SubmeshData(sub);
-		let pVertices = VertexData(sub);
+		let pSubmesh = LodData(sub, 0);
+		let pVertices = VertexData(sub * LodCount);
 		for(auto it=0u; it<pSubmesh->VertexCount; ++it)
 			pVertices[it].normal = -pVertices[it].normal;
 	}
@@ -342,8 +538,8 @@ void MeshAssetData::FlipNormals() {
 
 void MeshAssetData::SetColor(vec4 c) {
 	for (uint32 sub = 0; sub < SubmeshCount; ++sub) {
-		let pSubmesh = SubmeshData(sub);
-		let pVertices = VertexData(sub);
+		let pSubmesh = LodData(sub, 0);
+		let pVertices = VertexData(sub * LodCount);
 		for (auto it = 0u; it < pSubmesh->VertexCount; ++it)
 			pVertices[it].color;
 	}
@@ -355,24 +551,35 @@ bool SubMesh::TryLoad(IRenderDevice* pDevice, bool aDynamic, const MeshAssetData
 		return false;
 
 	let pSubmesh = pAsset->SubmeshData(idx);
-	let pVertices = pAsset->VertexData(idx);
-	let pIndices = pAsset->IndexData(idx);
+	let pVertices = pAsset->RawVertexData(idx);
+	let pIndices = pAsset->RawIndexData(idx);
 
-	return TryLoad(pDevice, aDynamic, pSubmesh->VertexCount, pSubmesh->IndexCount, pVertices, pIndices);
+	return DoLoad(pDevice, aDynamic, pSubmesh->VertexCount, GetMeshVertexStride(pAsset->VertexFormat), pVertices, pSubmesh->IndexCount, pSubmesh->IndexSize, pIndices);
 }
 
 bool SubMesh::TryLoad(IRenderDevice* pDevice, bool aDynamic, uint nverts, uint nidx, const MeshVertex* pVertices, const uint32* pIndices) {
 	if (IsLoaded())
 		return false;
 
+	return DoLoad(pDevice, aDynamic, nverts, sizeof(MeshVertex), pVertices, nidx, sizeof(uint32), pIndices);
+}
+
+bool SubMesh::DoLoad(IRenderDevice* pDevice, bool aDynamic, uint nverts, uint32 vertexStride, const void* pVertices, uint nidx, uint32 indexSize, const void* pIndices) {
 	CHECK_ASSERT(nidx % 3 == 0);
 
 	gpuVertexCount = nverts;
 	gpuIndexCount = nidx;
+	indexType = indexSize == sizeof(uint16) ? VT_UINT16 : VT_UINT32;
 	dynamic = aDynamic;
 
+	// headless: no device, so only the counts are kept (for draw tallies)
+	if (pDevice == nullptr) {
+		loaded = true;
+		return true;
+	}
+
 	{
-		let vertexByteCount = uint32(sizeof(MeshVertex) * nverts);
+		let vertexByteCount = uint32(vertexStride * nverts);
 		BufferDesc VBD;
 		VBD.Name = "VB_Mesh"; // get name for mesh?
 		VBD.Usage = aDynamic ? USAGE_DEFAULT : USAGE_STATIC;
@@ -384,39 +591,80 @@ bool SubMesh::TryLoad(IRenderDevice* pDevice, bool aDynamic, uint nverts, uint n
 		pDevice->CreateBuffer(VBD, &buf, &pVertexBuffer);
 	}
 
-	if (nidx > 0) {
-		let indexByteCount = uint32(sizeof(uint32) * nidx);
-		BufferDesc IBD;
-		IBD.Name = "IB_Mesh";
-		IBD.Usage = USAGE_STATIC;
-		IBD.BindFlags = BIND_INDEX_BUFFER;
-		IBD.uiSizeInBytes = indexByteCount;
-		BufferData buf;
-		buf.pData = pIndices;
-		buf.DataSize = indexByteCount;
-		pDevice->CreateBuffer(IBD, &buf, &pIndexBuffer);
-	}
-	
+	if (nidx > 0)
+		DoCreateIndexBuffer(pDevice, nidx, indexSize, pIndices);
+
+	loaded = true;
+	return true;
+}
+
+bool SubMesh::TryLoadLod(IRenderDevice* pDevice, const SubMesh& base, uint nidx, uint32 indexSize, const void* pIndices) {
+	if (IsLoaded() || !base.IsLoaded())
+		return false;
 
+	CHECK_ASSERT(nidx > 0 && nidx % 3 == 0);
 
+	gpuVertexCount = base.gpuVertexCount;
+	gpuIndexCount = nidx;
+	indexType = indexSize == sizeof(uint16) ? VT_UINT16 : VT_UINT32;
+	dynamic = base.dynamic;
+	pVertexBuffer = base.pVertexBuffer;
+	if (pDevice != nullptr)
+		DoCreateIndexBuffer(pDevice, nidx, indexSize, pIndices);
+
+	loaded = true;
 	return true;
 }
 
+void SubMesh::DoCreateIndexBuffer(IRenderDevice* pDevice, uint nidx, uint32 indexSize, const void* pIndices) {
+	let indexByteCount = uint32(indexSize * nidx);
+	BufferDesc IBD;
+	IBD.Name = "IB_Mesh";
+	IBD.Usage = USAGE_STATIC;
+	IBD.BindFlags = BIND_INDEX_BUFFER;
+	IBD.uiSizeInBytes = indexByteCount;
+	BufferData buf;
+	buf.pData = pIndices;
+	buf.DataSize = indexByteCount;
+	pDevice->CreateBuffer(IBD, &buf, &pIndexBuffer);
+}
+
 bool SubMesh::TryRelease(IRenderDevice* pDevice) {
 	return false;
 }
 
-void SubMesh::DoDraw(IDeviceContext* pContext) {
+void SubMesh::Bind(IDeviceContext* pContext, RESOURCE_STATE_TRANSITION_MODE transitionMode) {
 	CHECK_ASSERT(IsLoaded());
 
 	uint32 offset = 0;
 	IBuffer* pBuffers[]{ pVertexBuffer };
-	pContext->SetVertexBuffers(0, 1, pBuffers, &offset, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET);
+	pContext->SetVertexBuffers(0, 1, pBuffers, &offset, transitionMode, SET_VERTEX_BUFFERS_FLAG_NONE);
+	if (pIndexBuffer != nullptr)
+		pContext->SetIndexBuffer(pIndexBuffer, 0, transitionMode);
+}
+
+void SubMesh::DoTransitionBuffers(IDeviceContext* pContext) {
+	CHECK_ASSERT(IsLoaded());
+
+	// deferred contexts can't transition, so buffers are put into their
+	// (permanent) draw states up-front on the immediate context
+	StateTransitionDesc barriers[] = {
+		StateTransitionDesc(pVertexBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, true),
+		StateTransitionDesc(pIndexBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDEX_BUFFER, true),
+	};
+	pContext->TransitionResourceStates(pIndexBuffer != nullptr ? 2 : 1, barriers);
+}
+
+void SubMesh::DoDrawInstanced(IDeviceContext* pContext, uint32 firstInstance, uint32 instanceCount) {
+	CHECK_ASSERT(IsLoaded());
+	CHECK_ASSERT(instanceCount > 0);
+
 	if (pIndexBuffer != nullptr) {
-		pContext->SetIndexBuffer(pIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 		DrawIndexedAttribs draw;
-		draw.IndexType = VT_UINT32;
+		draw.IndexType = indexType;
 		draw.NumIndices = gpuIndexCount;
+		draw.NumInstances = instanceCount;
+		draw.FirstInstanceLocation = firstInstance;
 		#if _DEBUG
 		draw.Flags = DRAW_FLAG_VERIFY_ALL;
 		#endif
@@ -424,21 +672,42 @@ void SubMesh::DoDraw(IDeviceContext* pContext) {
 	} else {
 		DrawAttribs draw;
 		draw.NumVertices = gpuVertexCount;
+		draw.NumInstances = instanceCount;
+		draw.FirstInstanceLocation = firstInstance;
 		pContext->Draw(draw);
 	}
 }
 
 bool Mesh::TryLoad(IRenderDevice* pDevice, bool dynamic, const MeshAssetData* pAsset) { 
-	if (!defaultSubmesh.TryLoad(pDevice, dynamic, pAsset, 0))
+	// (dynamic meshes are rewritten with full-format vertices)
+	CHECK_ASSERT(!dynamic || pAsset->VertexFormat == MESH_VERTEX_FORMAT_FULL);
+	if (!lods[0].TryLoad(pDevice, dynamic, pAsset, 0))
 		return false;
+	lodCount = 1;
 	boundingBox = pAsset->BoundingBox;
+	vertexFormat = MeshVertexFormat(pAsset->VertexFormat);
+	vertexTransform = IsCompressed() ? GetDecompressTransform(pAsset->BoundingBox) : mat4(1.f);
+
+	// (dynamic meshes are rewritten in place, which would leave their LODs stale)
+	if (dynamic)
+		return true;
+	let assetLodCount = eastl::min(pAsset->LodCount, uint32(MESH_MAX_LODS));
+	for(uint32 it=1; it<assetLodCount; ++it) {
+		let pLod = pAsset->LodData(0, it);
+		if (!lods[it].TryLoadLod(pDevice, lods[0], pLod->IndexCount, pLod->IndexSize, pAsset->RawIndexData(it)))
+			break;
+		lodCount = it + 1;
+	}
 	return true;
 }
 
 bool Mesh::TryLoad(IRenderDevice* pDevice, bool dynamic, uint nverts, uint nidx, const MeshVertex* pVertices, const uint32* pIndices, const AABB& bbox) { 
-	if (!defaultSubmesh.TryLoad(pDevice, dynamic, nverts, nidx, pVertices, pIndices))
+	if (!lods[0].TryLoad(pDevice, dynamic, nverts, nidx, pVertices, pIndices))
 		return false;
+	lodCount = 1;
 	boundingBox = bbox;
+	vertexFormat = MESH_VERTEX_FORMAT_FULL;
+	vertexTransform = mat4(1.f);
 	return true;
 }
 
@@ -656,11 +925,14 @@ MeshAssetData* MeshPlotter::CreateAssetData() {
 	);
 	let result = AllocAssetData<MeshAssetData>(sz);
 	result->SubmeshCount = 1;
+	result->LodCount = 1;
+	result->VertexFormat = MESH_VERTEX_FORMAT_FULL;
 	result->BoundingBox = ComputeMeshAABB(vertices.data(), (uint) vertices.size());
 
 	AssetDataWriter writer (result, sizeof(MeshAssetData));
 	auto pSubmesh = writer.PeekAndSeek<SubmeshHeader>();
 	pSubmesh->IndexCount = (uint32) indices.size();
+	pSubmesh->IndexSize = sizeof(uint32);
 	pSubmesh->VertexCount = (uint32) vertices.size();
 	pSubmesh->VertexOffset = writer.GetOffset();
 	writer.WriteData(vertices.data(), sizeof(MeshVertex) * vertices.size());
@@ -9,6 +9,10 @@
 #include "Name.h"
 #include "ObjectPool.h"
 
+#ifndef MESH_MAX_LODS
+#	define MESH_MAX_LODS 4 // levels of detail per submesh, including the full-resolution one
+#endif
+
 struct MeshVertex {
 	vec3 position;
 	vec3 normal;
@@ -24,39 +28,101 @@ struct MeshVertex {
 	};
 };
 
-AABB ComputeMeshAABB(MeshVertex* pVertices, uint count);
+// Cooked alternative to MeshVertex (20 bytes rather than 36): the position is quantized
+// against the mesh's bounding box (which instances fold into their model transforms), the
+// normal is octahedral-encoded, and the uv is half-precision.
+struct CompressedMeshVertex {
+	uint16 position[4]; // (w is padding)
+	int16 normal[2];
+	uint16 uv[2];
+	uint32 color;
+};
+
+enum MeshVertexFormat : uint32 {
+	MESH_VERTEX_FORMAT_FULL,       // MeshVertex
+	MESH_VERTEX_FORMAT_COMPRESSED, // CompressedMeshVertex
+	MESH_VERTEX_FORMAT_COUNT
+};
+
+inline uint32 GetMeshVertexStride(uint32 format) { return format == MESH_VERTEX_FORMAT_COMPRESSED ? sizeof(CompressedMeshVertex) : sizeof(MeshVertex); }
+
+AABB ComputeMeshAABB(const MeshVertex* pVertices, uint count);
+CompressedMeshVertex CompressMeshVertex(const MeshVertex& vertex, const AABB& bounds);
+mat4 GetDecompressTransform(const AABB& bounds); // maps quantized positions into the box
 
 extern const LayoutElement MeshVertexLayoutElems[4];
+extern const LayoutElement CompressedMeshVertexLayoutElems[4];
+
+// per-instance stream, bound to vertex buffer slot 1 for instanced draws
+struct MeshInstance {
+	mat4 ModelTransform;
+	vec4 NormalTransform[3]; // columns of the model's inverse-transpose 3x3 (w unused)
+};
+
+// mesh vertices in slot 0, followed by MeshInstance columns as ATTRIB4-10 in slot 1
+extern const LayoutElement InstancedMeshVertexLayoutElems[11];
+extern const LayoutElement InstancedCompressedMeshVertexLayoutElems[11];
+
+// defines COMPRESSED_VERTICES=1 for shader variants which read CompressedMeshVertex
+// attributes (every mesh shader reads MeshInstance attributes)
+extern const ShaderMacro CompressedMeshShaderMacros[2];
 
+// per-format pipeline inputs
+const LayoutElement* GetInstancedMeshLayoutElems(uint32 format);
+const ShaderMacro* GetInstancedMeshShaderMacros(uint32 format);
+
+// LODs of a submesh are extra headers which index the full-resolution vertices
 struct SubmeshHeader {
 	uint32 VertexCount;
 	uint32 IndexCount;
 	uint32 VertexOffset;
 	uint32 IndexOffset;
+	uint32 IndexSize; // bytes per index (uint16 if the submesh has fewer than 65536 vertices)
 };
 
 struct MeshAssetData : AssetDataHeader {
 	static const schema_t SCHEMA = SCHEMA_MESH;
 	AABB BoundingBox;
 	uint32 SubmeshCount;
+	uint32 LodCount; // headers are laid out [submesh * LodCount + lod]
+	uint32 VertexFormat; // MeshVertexFormat
+
+	uint32 HeaderCount() const { return SubmeshCount * LodCount; }
 
 	// Const Getters
 	const SubmeshHeader* SubmeshData(uint32 Idx) const { return Peek<SubmeshHeader>(this, sizeof(MeshAssetData) + Idx * sizeof(SubmeshHeader)); }
-	const MeshVertex* VertexData(uint32 Idx) const { return Peek<MeshVertex>(this, SubmeshData(Idx)->VertexOffset); }
-	const uint32* IndexData(uint32 Idx) const { return Peek<uint32>(this, SubmeshData(Idx)->IndexOffset); }
+	const SubmeshHeader* LodData(uint32 Sub, uint32 Lod) const { return SubmeshData(Sub * LodCount + Lod); }
+	const MeshVertex* VertexData(uint32 Idx) const { CHECK_ASSERT(VertexFormat == MESH_VERTEX_FORMAT_FULL); return Peek<MeshVertex>(this, SubmeshData(Idx)->VertexOffset); }
+	const void* RawVertexData(uint32 Idx) const { return Peek<uint8>(this, SubmeshData(Idx)->VertexOffset); }
+	const uint32* IndexData(uint32 Idx) const { CHECK_ASSERT(SubmeshData(Idx)->IndexSize == sizeof(uint32)); return Peek<uint32>(this, SubmeshData(Idx)->IndexOffset); }
+	const void* RawIndexData(uint32 Idx) const { return Peek<uint8>(this, SubmeshData(Idx)->IndexOffset); }
 
 	// Helper Modifiers
 	SubmeshHeader* SubmeshData(uint32 Idx) { return Peek<SubmeshHeader>(this, sizeof(MeshAssetData) + Idx * sizeof(SubmeshHeader)); }
-	MeshVertex* VertexData(uint32 Idx) { return Peek<MeshVertex>(this, SubmeshData(Idx)->VertexOffset); }
-	uint32* IndexData(uint32 Idx) { return Peek<uint32>(this, SubmeshData(Idx)->IndexOffset); }
+	SubmeshHeader* LodData(uint32 Sub, uint32 Lod) { return SubmeshData(Sub * LodCount + Lod); }
+	MeshVertex* VertexData(uint32 Idx) { CHECK_ASSERT(VertexFormat == MESH_VERTEX_FORMAT_FULL); return Peek<MeshVertex>(this, SubmeshData(Idx)->VertexOffset); }
+	uint32* IndexData(uint32 Idx) { CHECK_ASSERT(SubmeshData(Idx)->IndexSize == sizeof(uint32)); return Peek<uint32>(this, SubmeshData(Idx)->IndexOffset); }
+	uint16* IndexData16(uint32 Idx) { CHECK_ASSERT(SubmeshData(Idx)->IndexSize == sizeof(uint16)); return Peek<uint16>(this, SubmeshData(Idx)->IndexOffset); }
 
+	// (vertex edits are for full-format meshes only)
 	void ReverseWindingOrder();
 	void FlipNormals();
 	void SetColor(vec4 c);
 
 };
 
-MeshAssetData* ImportMeshAssetDataFromSource(const char* configPath);
+AssetDataRef ImportMeshAssetDataFromSource(const char* configPath);
+
+// vertex-cache misses (by MESH_VERTEX_CACHE_SIZE) of the meshes cooked this run, before
+// and after optimizing (so ACMR is misses per triangle); cached meshes aren't counted
+struct MeshCookStats {
+	uint32 meshCount;
+	uint64 triangleCount;
+	uint64 cacheMissesBefore;
+	uint64 cacheMissesAfter;
+};
+
+MeshCookStats GetMeshCookStats();
 
 class SubMesh {
 private:
@@ -64,27 +130,43 @@ private:
 	RefCntAutoPtr<IBuffer> pIndexBuffer;
 	uint32 gpuVertexCount = 0;
 	uint32 gpuIndexCount = 0;
+	VALUE_TYPE indexType = VT_UINT32;
 	uint32 dynamic : 1;
+	bool loaded = false;
 
 public:
 
 	bool IsDynamic() const { return dynamic; }
-	bool IsLoaded() const { return pVertexBuffer != nullptr; }
+	bool IsLoaded() const { return loaded; }
+	uint32 GetTriangleCount() const { return (gpuIndexCount > 0 ? gpuIndexCount : gpuVertexCount) / 3; }
 
 	IBuffer* GetVertexBuffer() { return pVertexBuffer; }
 	IBuffer* GetIndexBuffer() { return pIndexBuffer; }
 
 	bool TryLoad(IRenderDevice* pDevice, bool dynamic, const MeshAssetData* pAsset, uint32 idx);
 	bool TryLoad(IRenderDevice* pDevice, bool dynamic, uint nverts, uint nidx, const MeshVertex* pVertices, const uint32* pIndices);
+	bool TryLoadLod(IRenderDevice* pDevice, const SubMesh& base, uint nidx, uint32 indexSize, const void* pIndices); // shares base's vertex buffer
 	bool TryRelease(IRenderDevice* pDevice);
-	void DoDraw(IDeviceContext* pContext);
+
+	// instanced draws bind mesh buffers separately, leaving the instance stream in slot 1
+	void Bind(IDeviceContext* pContext, RESOURCE_STATE_TRANSITION_MODE transitionMode);
+	void DoTransitionBuffers(IDeviceContext* pContext);
+	void DoDrawInstanced(IDeviceContext* pContext, uint32 firstInstance, uint32 instanceCount);
+
+private:
+
+	bool DoLoad(IRenderDevice* pDevice, bool dynamic, uint nverts, uint32 vertexStride, const void* pVertices, uint nidx, uint32 indexSize, const void* pIndices);
+	void DoCreateIndexBuffer(IRenderDevice* pDevice, uint nidx, uint32 indexSize, const void* pIndices);
 
 };
 
 class Mesh : public ObjectComponent {
 private:
 	AABB boundingBox;
-	SubMesh defaultSubmesh;
+	SubMesh lods[MESH_MAX_LODS]; // (of the default submesh)
+	int lodCount = 0;
+	MeshVertexFormat vertexFormat = MESH_VERTEX_FORMAT_FULL;
+	mat4 vertexTransform = mat4(1.f);
 
 public:
 
@@ -93,7 +175,12 @@ public:
 	// more of an aspirational interface, here, lol
 	AABB GetBoundingBox() const { return boundingBox; }
 	int GetSubmeshCount() const { return 1; }
-	SubMesh* GetSubmesh(int idx) { return idx == 0 ? &defaultSubmesh : nullptr; }
+	SubMesh* GetSubmesh(int idx) { return idx == 0 ? &lods[0] : nullptr; }
+	int GetLodCount() const { return lodCount; }
+	SubMesh* GetLod(int lodIdx) { return lodIdx < lodCount ? &lods[lodIdx] : nullptr; } // (of the default submesh)
+	MeshVertexFormat GetVertexFormat() const { return vertexFormat; }
+	bool IsCompressed() const { return vertexFormat == MESH_VERTEX_FORMAT_COMPRESSED; }
+	const mat4& GetVertexTransform() const { return vertexTransform; } // (decompresses positions, for compressed meshes)
 	
 	bool TryLoad(IRenderDevice* pDevice, bool dynamic, const MeshAssetData* pAsset);
 	bool TryLoad(IRenderDevice* pDevice, bool dynamic, uint nverts, uint nidx, const MeshVertex* pVertices, const uint32* pIndices, const AABB& bbox);
@@ -0,0 +1,193 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "MeshOptimizer.h"
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
+#include <EASTL/vector.h>
+
+float ComputeVertexCacheMissRatio(const uint32* pIndices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize) {
+	if (indexCount < 3)
+		return 0.f;
+
+	// (a vertex is in the FIFO if it was added within the last cacheSize misses)
+	eastl::vector<uint32> addedAt(vertexCount, 0u);
+	uint32 missCount = 0;
+	for(uint32 it=0; it<indexCount; ++it) {
+		let idx = pIndices[it];
+		if (addedAt[idx] == 0 || missCount - addedAt[idx] >= cacheSize) {
+			++missCount;
+			addedAt[idx] = missCount;
+		}
+	}
+	return float(missCount) / float(indexCount / 3);
+}
+
+void OptimizeVertexCache(uint32* outIndices, const uint32* pIndices, uint32 indexCount, uint32 vertexCount) {
+	CHECK_ASSERT(indexCount % 3 == 0);
+	let triangleCount = indexCount / 3;
+	let cacheSize = int32(MESH_VERTEX_CACHE_SIZE);
+
+	// vertex-to-triangle adjacency, and how many of each vertex's triangles are yet to be emitted
+	eastl::vector<uint32> triangleOffsets(vertexCount + 1, 0u);
+	for(uint32 it=0; it<indexCount; ++it)
+		++triangleOffsets[pIndices[it] + 1];
+	for(uint32 it=0; it<vertexCount; ++it)
+		triangleOffsets[it + 1] += triangleOffsets[it];
+	eastl::vector<uint32> liveCounts(vertexCount);
+	for(uint32 it=0; it<vertexCount; ++it)
+		liveCounts[it] = triangleOffsets[it + 1] - triangleOffsets[it];
+	eastl::vector<uint32> triangleLists(indexCount);
+	{
+		eastl::vector<uint32> cursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for(uint32 it=0; it<indexCount; ++it)
+			triangleLists[cursors[pIndices[it]]++] = it / 3;
+	}
+
+	eastl::vector<int32> cacheTimes(vertexCount, 0);
+	eastl::vector<uint8> emitted(triangleCount, uint8(0));
+	eastl::vector<uint32> deadEnds;
+	eastl::vector<uint32> candidates;
+	int32 time = cacheSize + 1;
+	uint32 scanCursor = 0;
+	uint32 outCount = 0;
+
+	// fall back to recently used vertices with triangles left, then to the input order
+	let SkipDeadEnd = [&]() -> int64 {
+		while(!deadEnds.empty()) {
+			let idx = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveCounts[idx] > 0)
+				return idx;
+		}
+		while(scanCursor < vertexCount) {
+			if (liveCounts[scanCursor] > 0)
+				return scanCursor;
+			++scanCursor;
+		}
+		return -1;
+	};
+
+	auto fanVertex = SkipDeadEnd();
+	while(fanVertex >= 0) {
+
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for(auto it=triangleOffsets[fanVertex]; it<triangleOffsets[fanVertex + 1]; ++it) {
+			let triangle = triangleLists[it];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = 1;
+			for(uint32 corner=0; corner<3; ++corner) {
+				let idx = pIndices[3 * triangle + corner];
+				outIndices[outCount++] = idx;
+				deadEnds.push_back(idx);
+				candidates.push_back(idx);
+				--liveCounts[idx];
+				if (time - cacheTimes[idx] > cacheSize)
+					cacheTimes[idx] = time++;
+			}
+		}
+
+		// next, the candidate which entered the cache earliest and will still be in it after
+		// its remaining triangles are emitted (each adds at most two vertices)
+		int64 bestVertex = -1;
+		int32 bestPriority = -1;
+		for(let idx : candidates) {
+			if (liveCounts[idx] == 0)
+				continue;
+			int32 priority = 0;
+			if (time - cacheTimes[idx] + 2 * int32(liveCounts[idx]) <= cacheSize)
+				priority = time - cacheTimes[idx];
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				bestVertex = idx;
+			}
+		}
+		fanVertex = bestVertex >= 0 ? bestVertex : SkipDeadEnd();
+	}
+	CHECK_ASSERT(outCount == indexCount);
+}
+
+void OptimizeOverdraw(uint32* outIndices, const uint32* pIndices, uint32 indexCount, const vec3* pPositions, uint32 vertexCount) {
+	CHECK_ASSERT(indexCount % 3 == 0);
+	let triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// clusters start wherever a triangle misses on all three vertices, which is where
+	// the cache-ordering restarted, so moving them around costs (almost) no misses
+	eastl::vector<uint32> clusterStarts;
+	{
+		eastl::vector<uint32> addedAt(vertexCount, 0u);
+		uint32 missCount = 0;
+		for(uint32 triangle=0; triangle<triangleCount; ++triangle) {
+			uint32 triangleMisses = 0;
+			for(uint32 corner=0; corner<3; ++corner) {
+				let idx = pIndices[3 * triangle + corner];
+				if (addedAt[idx] == 0 || missCount - addedAt[idx] >= MESH_VERTEX_CACHE_SIZE) {
+					++missCount;
+					++triangleMisses;
+					addedAt[idx] = missCount;
+				}
+			}
+			if (triangle == 0 || triangleMisses == 3)
+				clusterStarts.push_back(triangle);
+		}
+	}
+	let clusterCount = uint32(clusterStarts.size());
+	clusterStarts.push_back(triangleCount);
+
+	// sort clusters by how far they face away from the middle of the mesh
+	vec3 meshCenter (0.f, 0.f, 0.f);
+	for(uint32 it=0; it<indexCount; ++it)
+		meshCenter += pPositions[pIndices[it]];
+	meshCenter /= float(indexCount);
+
+	struct Cluster {
+		float sortKey;
+		uint32 idx;
+	};
+	eastl::vector<Cluster> clusters(clusterCount);
+	for(uint32 clusterIdx=0; clusterIdx<clusterCount; ++clusterIdx) {
+		vec3 center (0.f, 0.f, 0.f);
+		vec3 normal (0.f, 0.f, 0.f);
+		float area = 0.f;
+		for(auto triangle=clusterStarts[clusterIdx]; triangle<clusterStarts[clusterIdx + 1]; ++triangle) {
+			let p0 = pPositions[pIndices[3 * triangle]];
+			let p1 = pPositions[pIndices[3 * triangle + 1]];
+			let p2 = pPositions[pIndices[3 * triangle + 2]];
+			let cross = glm::cross(p1 - p0, p2 - p0); // (twice the area-weighted normal)
+			let triangleArea = glm::length(cross);
+			center += triangleArea * (p0 + p1 + p2);
+			normal += cross;
+			area += triangleArea;
+		}
+		center = area > 0.f ? center / (3.f * area) : center;
+		let normalLength = glm::length(normal);
+		clusters[clusterIdx] = Cluster { normalLength > 0.f ? glm::dot(center - meshCenter, normal / normalLength) : 0.f, clusterIdx };
+	}
+	eastl::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& lhs, const Cluster& rhs) { return lhs.sortKey > rhs.sortKey; });
+
+	auto pOut = outIndices;
+	for(let& cluster : clusters) {
+		let first = 3 * clusterStarts[cluster.idx];
+		let last = 3 * clusterStarts[cluster.idx + 1];
+		memcpy(pOut, pIndices + first, (last - first) * sizeof(uint32));
+		pOut += last - first;
+	}
+}
+
+void OptimizeVertexFetch(uint32* outRemap, const uint32* pIndices, uint32 indexCount, uint32 vertexCount) {
+	let unassigned = ~0u;
+	eastl::fill(outRemap, outRemap + vertexCount, unassigned);
+	uint32 nextIdx = 0;
+	for(uint32 it=0; it<indexCount; ++it) {
+		auto& remap = outRemap[pIndices[it]];
+		if (remap == unassigned)
+			remap = nextIdx++;
+	}
+	for(uint32 it=0; it<vertexCount; ++it)
+		if (outRemap[it] == unassigned)
+			outRemap[it] = nextIdx++;
+}
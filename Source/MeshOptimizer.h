@@ -0,0 +1,29 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Math.h"
+
+#ifndef MESH_VERTEX_CACHE_SIZE
+#	define MESH_VERTEX_CACHE_SIZE 16 // post-transform cache entries assumed when ordering triangles
+#endif
+
+// Cook-time reordering of indexed triangle lists, in the order they're meant to run:
+// triangles for the post-transform cache, then clusters of them for overdraw, then
+// vertices for fetch locality. None of them add or remove triangles or vertices.
+
+// Average cache miss ratio (transformed vertices per triangle) with a FIFO cache,
+// from 0.5 (ideal, for large regular meshes) to 3 (no reuse).
+float ComputeVertexCacheMissRatio(const uint32* pIndices, uint32 indexCount, uint32 vertexCount, uint32 cacheSize = MESH_VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander, Nehab & Barczak 2007): fans triangles around each vertex in turn,
+// choosing the next one by how recently it entered the cache.
+void OptimizeVertexCache(uint32* outIndices, const uint32* pIndices, uint32 indexCount, uint32 vertexCount);
+
+// Splits cache-ordered triangles into clusters where the cache would be flushed, and
+// sorts the clusters outward-facing first (so they tend to occlude the rest).
+void OptimizeOverdraw(uint32* outIndices, const uint32* pIndices, uint32 indexCount, const vec3* pPositions, uint32 vertexCount);
+
+// Numbers vertices by first use, writing each one's new index to outRemap (unused
+// vertices are moved to the end). Apply it to every index list which shares them.
+void OptimizeVertexFetch(uint32* outRemap, const uint32* pIndices, uint32 indexCount, uint32 vertexCount);
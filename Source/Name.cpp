@@ -2,55 +2,152 @@
 // (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
 
 #include "Name.h"
-#include <EASTL/functional.h>
-#include <EASTL/hash_map.h>
-#include <shared_mutex>
+#include <EASTL/vector.h>
+#include <atomic>
+#include <cstring>
+#include <mutex>
 
-static auto& GetNameLookup() {
+// The intern table is split into shards by the high bits of the hash. Each shard is 
+// an open-addressing table which is read lock-free; writers (only the first intern
+// of each string) take the shard's lock, and copy the string into an append-only arena. 
+// When a shard grows the old table is retired, but never freed, so concurrent readers
+// holding it stay valid.
 
-	struct Intern {
-		std::shared_mutex mutex;
-		eastl::hash_map<size_t, eastl::string> map;
-	};
+#define NAME_SHARD_BITS 6
+#define NAME_SHARD_COUNT (1 << NAME_SHARD_BITS)
+#define NAME_TABLE_INITIAL_CAPACITY 256
+#define NAME_ARENA_BLOCK_SIZE (16 * 1024)
+
+namespace {
+
+struct NameSlot {
+	std::atomic<size_t> hash;
+	std::atomic<const char*> cstring;
+};
+
+struct NameTable {
+	uint32 capacity; // power of two, at most half-full
+	uint32 count;
+	NameSlot* pSlots;
+};
+
+struct NameShard {
+	std::mutex writeMutex;
+	std::atomic<NameTable*> pTable { nullptr };
+	eastl::vector<NameTable*> retiredTables;
+	char* pArena = nullptr;
+	size_t arenaRemaining = 0;
+};
 
-	static Intern intern;
-	return intern;
 }
 
-Name::Name(const char* cstring) noexcept
-	: hash(eastl::hash<const char*>()(cstring))
-{
-	auto& lookup = GetNameLookup();
+static NameShard& GetShard(size_t hash) {
+	static NameShard shards[NAME_SHARD_COUNT];
+	return shards[hash >> (8 * sizeof(size_t) - NAME_SHARD_BITS)];
+}
 
-	lookup.mutex.lock_shared();
-	let notInterned = lookup.map.find(hash) == lookup.map.end();
-	lookup.mutex.unlock_shared();
+static const char* FindInTable(const NameTable* pTable, size_t hash) {
+	if (pTable == nullptr)
+		return nullptr;
 
-	if (notInterned) {
+	let mask = size_t(pTable->capacity - 1);
+	for (auto idx = hash & mask;; idx = (idx + 1) & mask) {
+		let slotHash = pTable->pSlots[idx].hash.load(std::memory_order_acquire);
+		if (slotHash == hash)
+			return pTable->pSlots[idx].cstring.load(std::memory_order_relaxed);
+		if (slotHash == 0)
+			return nullptr;
+	}
+}
 
-		// pedant note: it's possible that the name was added after the first lock
-		// was released and this second lock is taken -- however even in that case
-		// all we're doing is double-writing the same value, which still works.
+static void InsertInTable(NameTable* pTable, size_t hash, const char* cstring) {
+	
+	// publish the string before the hash, so readers which see the hash see the string
+	let mask = size_t(pTable->capacity - 1);
+	auto idx = hash & mask;
+	while (pTable->pSlots[idx].hash.load(std::memory_order_relaxed) != 0)
+		idx = (idx + 1) & mask;
+	pTable->pSlots[idx].cstring.store(cstring, std::memory_order_relaxed);
+	pTable->pSlots[idx].hash.store(hash, std::memory_order_release);
+	++pTable->count;
+}
 
-		// TODO: add testing-checks for name-hash collisions?
+static NameTable* DoGrow(NameShard& shard) {
+	let pOld = shard.pTable.load(std::memory_order_relaxed);
+	let pNew = new NameTable;
+	pNew->capacity = pOld ? 2 * pOld->capacity : NAME_TABLE_INITIAL_CAPACITY;
+	pNew->count = 0;
+	pNew->pSlots = new NameSlot[pNew->capacity]();
+	if (pOld) {
+		for (uint32 it = 0; it < pOld->capacity; ++it) {
+			let hash = pOld->pSlots[it].hash.load(std::memory_order_relaxed);
+			if (hash != 0)
+				InsertInTable(pNew, hash, pOld->pSlots[it].cstring.load(std::memory_order_relaxed));
+		}
+		shard.retiredTables.push_back(pOld);
+	}
+	shard.pTable.store(pNew, std::memory_order_release);
+	return pNew;
+}
 
-		lookup.mutex.lock();
-		lookup.map[hash] = cstring;
-		lookup.mutex.unlock();
+static const char* DoCopyToArena(NameShard& shard, const char* cstring) {
+	let nbytes = strlen(cstring) + 1;
+	if (nbytes > shard.arenaRemaining) {
+		let blockSize = nbytes > NAME_ARENA_BLOCK_SIZE ? nbytes : NAME_ARENA_BLOCK_SIZE;
+		shard.pArena = new char[blockSize];
+		shard.arenaRemaining = blockSize;
 	}
+	let result = shard.pArena;
+	memcpy(result, cstring, nbytes);
+	shard.pArena += nbytes;
+	shard.arenaRemaining -= nbytes;
+	return result;
+}
+
+static void CheckCollision(const char* interned, const char* cstring) {
+	#if TRINKET_CHECKED
+	CHECK_ASSERT(strcmp(interned, cstring) == 0 && "Name hash collision");
+	#else
+	EA_UNUSED(interned);
+	EA_UNUSED(cstring);
+	#endif
+}
+
+Name::Name(const char* cstring) noexcept
+	: Name(Intern(Hash(cstring), cstring, false))
+{
+}
+
+Name Name::Intern(size_t aHash, const char* cstring, bool isStatic) noexcept {
+	auto& shard = GetShard(aHash);
+
+	// fast path: already interned
+	if (let interned = FindInTable(shard.pTable.load(std::memory_order_acquire), aHash)) {
+		CheckCollision(interned, cstring);
+		return Name(aHash);
+	}
+
+	// pedant note: another thread may have interned the same name between the 
+	// lock-free lookup and taking the lock, so check again once we hold it.
+	std::lock_guard<std::mutex> lock(shard.writeMutex);
+	auto pTable = shard.pTable.load(std::memory_order_relaxed);
+	if (let interned = FindInTable(pTable, aHash)) {
+		CheckCollision(interned, cstring);
+		return Name(aHash);
+	}
+
+	if (pTable == nullptr || 2 * (pTable->count + 1) > pTable->capacity)
+		pTable = DoGrow(shard);
+	InsertInTable(pTable, aHash, isStatic ? cstring : DoCopyToArena(shard, cstring));
+	return Name(aHash);
 }
 
 eastl::string Name::GetString() const {
 	eastl::string result;
 	if (hash)
 	{
-		auto& lookup = GetNameLookup();
-		lookup.mutex.lock_shared();
-		let it = lookup.map.find(hash);
-		if (it != lookup.map.end())
-			result = it->second;
-		lookup.mutex.unlock_shared();
+		if (let interned = FindInTable(GetShard(hash).pTable.load(std::memory_order_acquire), hash))
+			result = interned;
 	}
 	return result;
 }
-
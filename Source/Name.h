@@ -2,7 +2,9 @@
 // (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
 
 #pragma once
-#include "Common.h"
+#include "Object.h"
+#include <EASTL/functional.h>
+#include <EASTL/hash_map.h>
 #include <EASTL/string.h>
 
 // String-interning system, so the trinket can pass around
@@ -19,7 +21,7 @@ struct Name {
 
 	Name(ForceInit) noexcept : hash(0) {}
 	Name(const char* cstring)  noexcept;
-	explicit Name(size_t aHash) noexcept : hash(aHash) {}
+	explicit constexpr Name(size_t aHash) noexcept : hash(aHash) {}
 
 	bool IsValid() const { return hash != 0; }
 	eastl::string GetString() const;
@@ -27,4 +29,70 @@ struct Name {
 	inline bool operator==(const Name& rhs) const { return hash == rhs.hash; }
 	inline bool operator!=(const Name& rhs) const { return hash != rhs.hash; }
 
+	// 64-bit FNV-1a, which can be folded at compile-time for literals (zero is reserved for "invalid")
+	static constexpr size_t Hash(const char* cstring) {
+		uint64 result = 14695981039346656037ull;
+		for (; *cstring; ++cstring)
+			result = (result ^ uint64(uint8(*cstring))) * 1099511628211ull;
+		return result == 0 ? 1 : size_t(result);
+	}
+
+	// Interns a string with a precomputed hash. Static strings (e.g. literals) are
+	// referenced in-place rather than copied into the string arena.
+	static Name Intern(size_t aHash, const char* cstring, bool isStatic) noexcept;
+};
+
+// Compile-time names: the hash is folded by the compiler, and the literal is 
+// interned (by pointer) only the first time each call-site is reached.
+#define NAME(literal) ([]() noexcept { \
+	constexpr size_t hash = Name::Hash(literal); \
+	static const Name result = Name::Intern(hash, literal, true); \
+	return result; \
+}())
+
+namespace eastl {
+	template<> struct hash<Name> {
+		size_t operator()(const Name& name) const { return name.hash; }
+	};
+}
+
+// Secondary Name -> ObjectID index for owners of a name column, so that find-by-name 
+// doesn't scan. Names needn't be unique; Find() returns the match at the lowest index
+// of the owner's pool, which is the one a scan of the name column would find.
+
+class NameIndex {
+private:
+	eastl::hash_multimap<Name, ObjectID> map;
+
+public:
+
+	void Add(Name name, ObjectID id) { map.insert(eastl::make_pair(name, id)); }
+	
+	void Remove(Name name, ObjectID id) {
+		let range = map.equal_range(name);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second == id) {
+				map.erase(it);
+				return;
+			}
+		}
+	}
+
+	template<typename TPool>
+	ObjectID Find(Name name, const TPool& pool) const {
+		let range = map.equal_range(name);
+		ObjectID result = OBJECT_NIL;
+		int32 resultIdx = 0;
+		for (auto it = range.first; it != range.second; ++it) {
+			let idx = pool.IndexOf(it->second);
+			if (result.IsNil() || idx < resultIdx) {
+				result = it->second;
+				resultIdx = idx;
+			}
+		}
+		return result;
+	}
+
+	int32 Count(Name name) const { return int32(map.count(name)); }
+	void Reserve(int32 count) { map.reserve(count); }
 };
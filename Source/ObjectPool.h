@@ -4,6 +4,8 @@
 #pragma once
 #include "Object.h"
 #include <EASTL/bonus/tuple_vector.h>
+#include <EASTL/algorithm.h>
+#include <EASTL/utility.h>
 #include <EASTL/vector.h>
 
 union SparsePage {
@@ -46,7 +48,7 @@ public:
 
 	void DecrementCount(ObjectID id) {
 		--counts[id.pageIdx];
-		if (counts == 0)
+		if (counts[id.pageIdx] == 0)
 			ReleasePage(id.pageIdx);
 	}
 
@@ -186,7 +188,65 @@ public:
 		return idx != INVALID_INDEX && TryInsertObjectAt(id, idx + 1, args...); // TODO: eastl::forward?
 	}
 
-	void DoReleaseCompactRange_Shift(int32 idxStart, int32 idxEnd) {
+	bool TryInsertRangeAt(int32 index, int32 count, const ObjectID* pIDs, const Ts*... pComponents) {
+
+		// Inserts count objects at index, with the components for each column passed
+		// as parallel arrays. Rather than shifting the tail once per object, we append
+		// the whole range and then rotate it into place, so each column is moved once
+		// and the sparse indices are fixed in a single pass.
+
+		// early out?
+		if (index < 0 || count < 0)
+			return false;
+		for (int32 it = 0; it < count; ++it)
+			if (pIDs[it].IsNil() || Contains(pIDs[it]))
+				return false;
+
+		let oldCount = Count();
+		compact.reserve(oldCount + count);
+		for (int32 it = 0; it < count; ++it) {
+			let id = pIDs[it];
+			CHECK_ASSERT(!Contains(id)); // duplicates in pIDs?
+			sparse.IncrementCount(id);
+			sparse.DoSetIndex(id, oldCount + it);
+			compact.emplace_back(id, pComponents[it]...);
+		}
+
+		if (index < oldCount)
+			MoveRange(oldCount, oldCount + count, index);
+
+		return true;
+	}
+
+	int32 MoveRange(int32 idxStart, int32 idxEnd, int32 idxDest) {
+
+		// Moves the compact range [idxStart, idxEnd) so that it sits before the element
+		// currently at idxDest (which must lie outside the range), shifting everything
+		// in-between to fill the gap. Returns the new start-index of the range.
+
+		CHECK_ASSERT(idxStart >= 0 && idxStart <= idxEnd && idxEnd <= Count());
+		CHECK_ASSERT(idxDest >= 0 && idxDest <= Count());
+		CHECK_ASSERT(idxDest <= idxStart || idxDest >= idxEnd);
+
+		let forward = idxDest >= idxEnd;
+		let first = forward ? idxStart : idxDest;
+		let middle = forward ? idxEnd : idxStart;
+		let last = forward ? idxDest : idxEnd;
+		if (first == middle || middle == last)
+			return idxStart;
+
+		DoRotateColumns(first, middle, last, eastl::make_index_sequence<1 + sizeof...(Ts)>());
+
+		// update shifted indices
+		let pHandles = compact.get<0>();
+		for (int32 it = first; it < last; ++it)
+			sparse.DoSetIndex(pHandles[it], it);
+
+		return forward ? idxDest - (idxEnd - idxStart) : idxDest;
+	}
+
+	void ReleaseRange_Shift(int32 idxStart, int32 idxEnd) {
+		CHECK_ASSERT(idxStart >= 0 && idxStart <= idxEnd && idxEnd <= Count());
 		
 		// release pages
 		let itStart = compact.begin() + idxStart;
@@ -281,6 +341,18 @@ public:
 		compact.clear();
 	}
 
+private:
+
+	template<size_t... Cs>
+	void DoRotateColumns(int32 first, int32 middle, int32 last, eastl::index_sequence<Cs...>) {
+		(DoRotateColumn(compact.get<Cs>(), first, middle, last), ...);
+	}
+
+	template<typename T>
+	static void DoRotateColumn(T* pColumn, int32 first, int32 middle, int32 last) {
+		eastl::rotate(pColumn + first, pColumn + middle, pColumn + last);
+	}
+
 };
 
 //------------------------------------------------------------------------------------------
@@ -346,5 +418,4 @@ public:
 };
 
 // TODO: template the (const Ts&... args) methods receivers to take forwarded arguments
-//       (requires bugfix to east, bug filed: https://github.com/electronicarts/EASTL/issues/369)
-// TODO: Remove/Shift a whole-range
\ No newline at end of file
+//       (requires bugfix to east, bug filed: https://github.com/electronicarts/EASTL/issues/369)
\ No newline at end of file
@@ -0,0 +1,187 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "Occlusion.h"
+#include "Jobs.h"
+#include <xmmintrin.h>
+#include <cfloat>
+
+static_assert(OCCLUSION_BUFFER_WIDTH % OCCLUSION_TILE_SIZE == 0 && OCCLUSION_BUFFER_HEIGHT % OCCLUSION_TILE_SIZE == 0);
+static_assert(OCCLUSION_TILE_SIZE % 4 == 0);
+
+void OcclusionBuffer::Begin(const mat4& aViewProjection) {
+	viewProjection = aViewProjection;
+	occluderCount = 0;
+}
+
+vec4 OcclusionBuffer::DoProject(const vec3& position) const {
+	// (y is flipped, so rows run top to bottom)
+	let clip = viewProjection * vec4(position, 1.f);
+	let invW = 1.f / clip.w;
+	return vec4(
+		(0.5f + 0.5f * clip.x * invW) * float(OCCLUSION_BUFFER_WIDTH),
+		(0.5f - 0.5f * clip.y * invW) * float(OCCLUSION_BUFFER_HEIGHT),
+		invW,
+		clip.w
+	);
+}
+
+bool OcclusionBuffer::TryAddOccluder(const mat4& transform, const AABB& localBox) {
+	if (occluderCount >= OCCLUSION_MAX_OCCLUDERS)
+		return false;
+
+	// corners are indexed by bits (x, y, z)
+	auto& corners = occluderCorners[occluderCount++];
+	for(int it=0; it<8; ++it) {
+		let local = vec3(it & 1 ? localBox.max.x : localBox.min.x, it & 2 ? localBox.max.y : localBox.min.y, it & 4 ? localBox.max.z : localBox.min.z);
+		corners[it] = DoProject(vec3(transform * vec4(local, 1.f)));
+	}
+	return true;
+}
+
+void OcclusionBuffer::Rasterize(JobSystem& jobs) {
+	jobs.ParallelFor(OCCLUSION_TILES_Y, 1, [this](int32 begin, int32 end) {
+		for(int32 tileY=begin; tileY<end; ++tileY)
+			DoRasterizeTileRow(tileY);
+	});
+}
+
+void OcclusionBuffer::DoRasterizeTileRow(int32 tileY) {
+	let rowBegin = tileY * OCCLUSION_TILE_SIZE;
+	let rowEnd = rowBegin + OCCLUSION_TILE_SIZE;
+	eastl::fill(inverseDepth + rowBegin * OCCLUSION_BUFFER_WIDTH, inverseDepth + rowEnd * OCCLUSION_BUFFER_WIDTH, 0.f);
+
+	// each face of each box is a quad, with corners one bit apart around the face's axis
+	for(int32 occluderIdx=0; occluderIdx<occluderCount; ++occluderIdx) {
+		let& corners = occluderCorners[occluderIdx];
+		for(int axis=0; axis<3; ++axis) {
+			let uBit = 1 << ((axis + 1) % 3);
+			let vBit = 1 << ((axis + 2) % 3);
+			for(int side=0; side<2; ++side) {
+				let base = side << axis;
+				DoRasterizeTriangle(corners[base], corners[base | uBit], corners[base | uBit | vBit], rowBegin, rowEnd);
+				DoRasterizeTriangle(corners[base], corners[base | uBit | vBit], corners[base | vBit], rowBegin, rowEnd);
+			}
+		}
+	}
+
+	// reduce to the farthest depth (least 1/w) of each tile
+	for(int32 tileX=0; tileX<OCCLUSION_TILES_X; ++tileX) {
+		__m128 farthest = _mm_set1_ps(FLT_MAX);
+		for(int32 y=rowBegin; y<rowEnd; ++y) {
+			let pRow = inverseDepth + y * OCCLUSION_BUFFER_WIDTH + tileX * OCCLUSION_TILE_SIZE;
+			for(int32 x=0; x<OCCLUSION_TILE_SIZE; x+=4)
+				farthest = _mm_min_ps(farthest, _mm_load_ps(pRow + x));
+		}
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, farthest);
+		tileInverseDepth[tileY * OCCLUSION_TILES_X + tileX] = eastl::min(eastl::min(lanes[0], lanes[1]), eastl::min(lanes[2], lanes[3]));
+	}
+}
+
+void OcclusionBuffer::DoRasterizeTriangle(const vec4& v0, const vec4& v1, const vec4& v2, int32 rowBegin, int32 rowEnd) {
+	// triangles which reach behind the eye are skipped, which only loses occlusion
+	if (v0.w <= 0.f || v1.w <= 0.f || v2.w <= 0.f)
+		return;
+
+	let area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+	if (glm::abs(area) < 1e-6f)
+		return;
+
+	// (bounds are clamped before converting, as vertices near the eye plane project far out)
+	let minY = int32(floorf(glm::clamp(eastl::min(v0.y, eastl::min(v1.y, v2.y)), float(rowBegin), float(rowEnd))));
+	let maxY = int32(ceilf(glm::clamp(eastl::max(v0.y, eastl::max(v1.y, v2.y)), float(rowBegin - 1), float(rowEnd - 1))));
+	let minX = int32(floorf(glm::clamp(eastl::min(v0.x, eastl::min(v1.x, v2.x)), 0.f, float(OCCLUSION_BUFFER_WIDTH)))) & ~3;
+	let maxX = int32(ceilf(glm::clamp(eastl::max(v0.x, eastl::max(v1.x, v2.x)), -1.f, float(OCCLUSION_BUFFER_WIDTH - 1))));
+	if (minY > maxY || minX > maxX)
+		return;
+
+	// edge functions Ax + By + C, oriented to be non-negative inside for either winding
+	let sign = area > 0.f ? 1.f : -1.f;
+	__m128 edgeA[3], edgeB[3], edgeC[3];
+	const vec4* verts[3] = { &v0, &v1, &v2 };
+	for(int it=0; it<3; ++it) {
+		let& va = *verts[it];
+		let& vb = *verts[(it + 1) % 3];
+		let a = sign * (va.y - vb.y);
+		let b = sign * (vb.x - va.x);
+		edgeA[it] = _mm_set1_ps(a);
+		edgeB[it] = _mm_set1_ps(b);
+		edgeC[it] = _mm_set1_ps(-a * va.x - b * va.y);
+	}
+
+	// 1/w is linear in screen space
+	let invArea = 1.f / area;
+	let dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) * invArea;
+	let dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) * invArea;
+	let depthX = _mm_set1_ps(dzdx);
+	let depthY = _mm_set1_ps(dzdy);
+	let depthC = _mm_set1_ps(v0.z - dzdx * v0.x - dzdy * v0.y);
+
+	// sample pixel centers, four at a time (rows are 16-byte aligned, as minX is)
+	let laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	let zero = _mm_setzero_ps();
+	for(int32 y=minY; y<=maxY; ++y) {
+		let py = _mm_set1_ps(float(y) + 0.5f);
+		let pRow = inverseDepth + y * OCCLUSION_BUFFER_WIDTH;
+		for(int32 x=minX; x<=maxX; x+=4) {
+			let px = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+			let e0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), _mm_mul_ps(edgeB[0], py)), edgeC[0]);
+			let e1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], px), _mm_mul_ps(edgeB[1], py)), edgeC[1]);
+			let e2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], px), _mm_mul_ps(edgeB[2], py)), edgeC[2]);
+			let inside = _mm_cmpge_ps(_mm_min_ps(e0, _mm_min_ps(e1, e2)), zero);
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			let z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthX, px), _mm_mul_ps(depthY, py)), depthC);
+			let current = _mm_load_ps(pRow + x);
+			let nearest = _mm_max_ps(current, z);
+			_mm_store_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const AABB& box) const {
+	if (occluderCount == 0)
+		return true;
+
+	// screen rect and nearest depth (greatest 1/w) of the box; boxes reaching behind the eye are visible
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = 0.f;
+	for(int it=0; it<8; ++it) {
+		let corner = DoProject(vec3(it & 1 ? box.max.x : box.min.x, it & 2 ? box.max.y : box.min.y, it & 4 ? box.max.z : box.min.z));
+		if (corner.w <= 0.f)
+			return true;
+		minX = eastl::min(minX, corner.x);
+		minY = eastl::min(minY, corner.y);
+		maxX = eastl::max(maxX, corner.x);
+		maxY = eastl::max(maxY, corner.y);
+		nearest = eastl::max(nearest, corner.z);
+	}
+
+	let x0 = int32(floorf(glm::clamp(minX, 0.f, float(OCCLUSION_BUFFER_WIDTH))));
+	let y0 = int32(floorf(glm::clamp(minY, 0.f, float(OCCLUSION_BUFFER_HEIGHT))));
+	let x1 = int32(floorf(glm::clamp(maxX, -1.f, float(OCCLUSION_BUFFER_WIDTH - 1))));
+	let y1 = int32(floorf(glm::clamp(maxY, -1.f, float(OCCLUSION_BUFFER_HEIGHT - 1))));
+	if (x0 > x1 || y0 > y1)
+		return true; // (off-screen boxes are the frustum's call)
+
+	// a pixel hides the box if it's nearer than the box's nearest point
+	let testDepth = nearest * (1.f + OCCLUSION_DEPTH_BIAS);
+	for(int32 tileY=y0 / OCCLUSION_TILE_SIZE; tileY<=y1 / OCCLUSION_TILE_SIZE; ++tileY) {
+		for(int32 tileX=x0 / OCCLUSION_TILE_SIZE; tileX<=x1 / OCCLUSION_TILE_SIZE; ++tileX) {
+			if (GetTileInverseDepth(tileX, tileY) > testDepth)
+				continue;
+
+			// some pixel of the tile is open, so check the ones under the box
+			let px0 = eastl::max(x0, tileX * OCCLUSION_TILE_SIZE);
+			let py0 = eastl::max(y0, tileY * OCCLUSION_TILE_SIZE);
+			let px1 = eastl::min(x1, tileX * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+			let py1 = eastl::min(y1, tileY * OCCLUSION_TILE_SIZE + OCCLUSION_TILE_SIZE - 1);
+			for(int32 y=py0; y<=py1; ++y)
+				for(int32 x=px0; x<=px1; ++x)
+					if (GetInverseDepth(x, y) <= testDepth)
+						return true;
+		}
+	}
+	return false;
+}
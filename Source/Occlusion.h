@@ -0,0 +1,59 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Geom.h"
+
+class JobSystem;
+
+#ifndef OCCLUSION_BUFFER_WIDTH
+#	define OCCLUSION_BUFFER_WIDTH 256 // a multiple of OCCLUSION_TILE_SIZE
+#endif
+#ifndef OCCLUSION_BUFFER_HEIGHT
+#	define OCCLUSION_BUFFER_HEIGHT 128 // a multiple of OCCLUSION_TILE_SIZE
+#endif
+#ifndef OCCLUSION_TILE_SIZE
+#	define OCCLUSION_TILE_SIZE 8 // pixels per side of each hierarchical-z tile (a multiple of 4)
+#endif
+#ifndef OCCLUSION_MAX_OCCLUDERS
+#	define OCCLUSION_MAX_OCCLUDERS 64
+#endif
+#ifndef OCCLUSION_DEPTH_BIAS
+#	define OCCLUSION_DEPTH_BIAS 1e-4f // relative; keeps boxes from hiding behind their own occluder proxy
+#endif
+
+#define OCCLUSION_TILES_X (OCCLUSION_BUFFER_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y (OCCLUSION_BUFFER_HEIGHT / OCCLUSION_TILE_SIZE)
+
+// Low-resolution CPU depth buffer for occlusion culling. Occluders are boxes (e.g. a
+// renderer's bounding box, if the mesh is mostly solid), rasterized four pixels at a
+// time, with each worker owning one row of tiles. Each tile row then reduces to the
+// farthest depth per tile, and boxes are tested tile by tile, falling back to pixels
+// only where a tile isn't covered nearer than the box. Depth is stored as 1/w, which
+// is linear in screen space, precise at any distance and the same for D3D and GL.
+class OcclusionBuffer {
+public:
+
+	void Begin(const mat4& aViewProjection);
+	bool TryAddOccluder(const mat4& transform, const AABB& localBox);
+	void Rasterize(JobSystem& jobs);
+
+	// conservative: false only if the box is entirely behind the rasterized occluders
+	bool IsVisible(const AABB& box) const;
+
+	int32 GetOccluderCount() const { return occluderCount; }
+	float GetInverseDepth(int32 x, int32 y) const { return inverseDepth[y * OCCLUSION_BUFFER_WIDTH + x]; }
+	float GetTileInverseDepth(int32 tileX, int32 tileY) const { return tileInverseDepth[tileY * OCCLUSION_TILES_X + tileX]; }
+
+private:
+
+	mat4 viewProjection = mat4(1.f);
+	int32 occluderCount = 0;
+	vec4 occluderCorners[OCCLUSION_MAX_OCCLUDERS][8]; // (pixel x, pixel y, 1/w, w)
+	alignas(16) float inverseDepth[OCCLUSION_BUFFER_WIDTH * OCCLUSION_BUFFER_HEIGHT];
+	float tileInverseDepth[OCCLUSION_TILES_X * OCCLUSION_TILES_Y];
+
+	vec4 DoProject(const vec3& position) const;
+	void DoRasterizeTileRow(int32 tileY);
+	void DoRasterizeTriangle(const vec4& v0, const vec4& v1, const vec4& v2, int32 rowBegin, int32 rowEnd);
+};
@@ -38,9 +38,12 @@ PhysicsRuntime::PhysicsRuntime(World* aWorld) : pWorld(aWorld) {
 	CHECK_ASSERT(pDefaultScene != nullptr);
 
 	pDefaultMaterial = pPhysics->createMaterial(0.5f, 0.5f, 0.5f);
+
+	pWorld->scene.AddListener(this);
 }
 
 PhysicsRuntime::~PhysicsRuntime() {
+	pWorld->scene.RemoveListener(this);
 	if (pDefaultScene)
 		pDefaultScene->release();
 	if (pDefaultMaterial)
@@ -71,16 +74,31 @@ bool PhysicsRuntime::TryAttachRigidbodyTo(ObjectID id) {
 		return false;
 
 	let pHierarchy = pScene->GetSublevelHierarchyFor(id);
-	let worldPose = pHierarchy->GetScenePose(id);
-	PxRigidDynamic* body = pPhysics->createRigidDynamic(worldPose->ToPhysX());
+	let worldPose = pHierarchy->GetCurrentScenePose(id);
+	PxRigidDynamic* body = pPhysics->createRigidDynamic(worldPose.ToPhysX());
 	body->userData = ObjectHandle(ObjectTag::SCENE_OBJECT, id).p;
 	pDefaultScene->addActor(*body);
 
 	
-	rigidBodies.TryAppendObject(id, body, worldPose->rpose);
+	rigidBodies.TryAppendObject(id, body, worldPose.rpose);
 	return true;
 }
 
+void PhysicsRuntime::Scene_WillReleaseObject(Scene* caller, ObjectID id) {
+	let ppRigidbody = rigidBodies.TryGetComponent<C_BODY>(id);
+	if (!ppRigidbody)
+		return;
+
+	// (releasing the actor removes it from its scene, and releases its exclusive shapes)
+	(*ppRigidbody)->release();
+	rigidBodies.TryReleaseObject_Swap(id);
+}
+
+bool PhysicsRuntime::IsAwake(ObjectID id) const {
+	let ppRigidbody = rigidBodies.TryGetComponent<C_BODY>(id);
+	return ppRigidbody && !(*ppRigidbody)->isSleeping();
+}
+
 bool PhysicsRuntime::TryAttachBoxTo(ObjectID id, float extent, float density) {
 	let ppRigidbody = rigidBodies.TryGetComponent<C_BODY>(id);
 	if (!ppRigidbody)
@@ -132,15 +150,15 @@ void PhysicsRuntime::Tick(float dt) {
 
 
 	// sample current poses
+	tickPoses.resize(n);
 	let tickProgress = timeAccum / fixedDeltaTime;
 	for(int it=0; it<n; ++it) {
-		let id = pHandles[it];
-		let pHierarchy = pScene->GetSublevelHierarchyFor(id);
-		pHierarchy->SetSceneRigidPose(id, RPose::NLerp(
+		tickPoses[it] = RPose::NLerp(
 			pPrevPoses[it], 
 			RPose(pBodies[it]->getGlobalPose()), 
-			tickProgress)
+			tickProgress
 		);
 	}
+	pScene->SetSceneRigidPosesBatch(pHandles, tickPoses.data(), n);
 
 }
\ No newline at end of file
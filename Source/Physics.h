@@ -5,8 +5,6 @@
 #include "Assets.h"
 #include "Scene.h"
 
-// TODO: handle Scene_WillReleaseObject
-
 namespace physx {
 	class PxFoundation;
 	class PxPhysics;
@@ -23,7 +21,7 @@ namespace physx {
 
 class World;
 
-class PhysicsRuntime {
+class PhysicsRuntime : ISceneListener {
 private:
 	World* pWorld;
 	physx::PxFoundation* pFoundation;
@@ -45,6 +43,7 @@ private:
 
 	enum ComponentType { C_OBJECT_ID, C_BODY, C_PREV_POSE };
 	ObjectPool<physx::PxRigidDynamic*, RPose> rigidBodies;
+	eastl::vector<RPose> tickPoses; // (scratch for writing back to the scene)
 
 public:
 
@@ -57,7 +56,13 @@ public:
 	bool TryAttachRigidbodyTo(ObjectID id);
 	bool TryAttachBoxTo(ObjectID id, float extent, float density);
 
+	bool HasRigidbody(ObjectID id) const { return rigidBodies.Contains(id); }
+	bool IsAwake(ObjectID id) const;
+
 	void Tick(float dt);
 
+private:
+
+	void Scene_WillReleaseObject(Scene* caller, ObjectID id) override;
 
 };
\ No newline at end of file
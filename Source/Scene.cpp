@@ -2,26 +2,33 @@
 // (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
 
 #include "Scene.h"
+#include "Jobs.h"
 #include <shared_mutex>
+#include <EASTL/sort.h>
 
 Scene::Scene() 
 	: mgr(false)
 {
 	mgr.ReserveCompact(1024);
-	CreateSublevel("Default Level");
+	names.Reserve(1024);
+	CreateSublevel(NAME("Default Level"));
 }
 
 Scene::~Scene() {
 }
 
 ObjectID Scene::CreateObject(Name name) {
-	return mgr.CreateObject(name);
+	let id = mgr.CreateObject(name);
+	if (!id.IsNil())
+		names.Add(name, id);
+	return id;
 }
 
 ObjectID Scene::CreateSublevel(Name name) {
 	let id = CreateObject(name);
 	let pHierarchy = NewObjectComponent<Hierarchy>(id);
 	pHierarchy->AddListener(this);
+	pHierarchy->SetDeferPoseUpdates(deferPoseUpdates);
 	sublevels.TryAppendObject(id, pHierarchy);
 	return id;
 }
@@ -44,25 +51,30 @@ void Scene::TryReleaseObject(ObjectID id) {
 		//
 	}
 
-	let ownerID = GetSublevel(id);
-	if (!ownerID.IsNil()) {
-		sceneObjects.TryReleaseObject_Swap(id);
-		let pHierarchy = GetSublevelHierarchyFor(ownerID);
-		for (HierarchyDescendentIterator di(pHierarchy, id); di.MoveNext();)
-			destroySet.push_back(di.GetObject());
+	if (let pHierarchy = GetSublevelHierarchyFor(id)) {
+		// descendents are contiguous in the hierarchy, so we can grab
+		// them all at once and release the whole range in one go
+		let idxStart = pHierarchy->IndexOf(id);
+		let idxEnd = pHierarchy->GetDescendentRangeByIndex(idxStart);
+		let pObjects = pHierarchy->GetObjects();
+		destroySet.insert(destroySet.end(), pObjects + idxStart + 1, pObjects + idxEnd);
 		pHierarchy->TryRelease(id);
 	}
 
 	for(auto it : destroySet) {
 		for(auto listener : listeners)
 			listener->Scene_WillReleaseObject(this, it);
-		mgr.ReleaseObject(id);
+		names.Remove(GetName(it), it);
+		mgr.ReleaseObject(it);
 	}
 }
 
 void Scene::TryRename(ObjectID id, Name name) {
-	if (let pName = mgr.TryGetComponent<C_NAME>(id))
+	if (let pName = mgr.TryGetComponent<C_NAME>(id)) {
+		names.Remove(*pName, id);
 		*pName = name;
+		names.Add(name, id);
+	}
 }
 
 Name Scene::GetName(ObjectID id) const {
@@ -71,13 +83,100 @@ Name Scene::GetName(ObjectID id) const {
 }
 
 ObjectID Scene::FindObject(Name name) const {
-	let pNames = mgr.GetPool().GetComponentData<C_NAME>();
-	let n = mgr.GetPool().Count();
-	for(int it=0; it<n; ++it) {
-		if (name == pNames[it])
-			return *mgr.GetPool().GetComponentByIndex<C_HANDLE>(it);
+	return names.Find(name, mgr.GetPool());
+}
+
+void Scene::SetDeferPoseUpdates(bool defer) {
+	deferPoseUpdates = defer;
+	for (auto it = 0; it < GetSublevelCount(); ++it)
+		GetHierarchyByIndex(it)->SetDeferPoseUpdates(defer);
+}
+
+void Scene::FlushScenePoses() {
+	for (auto it = 0; it < GetSublevelCount(); ++it)
+		GetHierarchyByIndex(it)->FlushScenePoses();
+}
+
+// minimum number of objects per transform-job, so tiny root subtrees are batched together
+#define TRANSFORM_JOB_GRAIN 4096
+
+void Scene::UpdateTransformsParallel(JobSystem* pJobs) {
+	// split each sublevel's dirty span into runs of whole root subtrees
+	flushRanges.clear();
+	for (auto it = 0; it < GetSublevelCount(); ++it) {
+		let pHierarchy = GetHierarchyByIndex(it);
+		let idxFirst = pHierarchy->GetFirstDirtyIndex();
+		if (idxFirst == INVALID_INDEX)
+			continue;
+		
+		let n = pHierarchy->Count();
+		for (auto idxStart = idxFirst; idxStart < n;) {
+			auto idxEnd = pHierarchy->GetNextRootIndex(idxStart);
+			while (idxEnd < n && idxEnd - idxStart < TRANSFORM_JOB_GRAIN)
+				idxEnd = pHierarchy->GetNextRootIndex(idxEnd);
+			flushRanges.push_back(FlushRange { pHierarchy, idxStart, idxEnd });
+			idxStart = idxEnd;
+		}
 	}
-	return OBJECT_NIL;
+
+	let rangeCount = int32(flushRanges.size());
+	if (int32(flushMoved.size()) < rangeCount)
+		flushMoved.resize(rangeCount);
+	pJobs->ParallelFor(rangeCount, 1, [this](int32 begin, int32 end) {
+		for (auto it = begin; it < end; ++it) {
+			flushMoved[it].clear();
+			flushRanges[it].pHierarchy->FlushScenePosesInRange(flushRanges[it].idxStart, flushRanges[it].idxEnd, flushMoved[it]);
+		}
+	});
+
+	for (auto it = 0; it < rangeCount; ++it)
+		flushRanges[it].pHierarchy->AddMovedObjects(flushMoved[it]);
+	for (auto it = 0; it < GetSublevelCount(); ++it)
+		GetHierarchyByIndex(it)->FinishFlushScenePoses();
+}
+
+static void SetScenePosesBatchByIndex(Hierarchy* pHierarchy, const int32* pIndices, const HPose* pPoses, int32 n) { pHierarchy->SetScenePosesBatchByIndex(pIndices, pPoses, n); }
+static void SetScenePosesBatchByIndex(Hierarchy* pHierarchy, const int32* pIndices, const RPose* pPoses, int32 n) { pHierarchy->SetSceneRigidPosesBatchByIndex(pIndices, pPoses, n); }
+
+template<typename T>
+void Scene::DoSetScenePosesBatch(const ObjectID* pIDs, const T* pPoses, int32 n, eastl::vector<T>& poses) {
+	batchWrites.clear();
+	for (int32 it = 0; it < n; ++it) {
+		let pHierarchy = GetSublevelHierarchyFor(pIDs[it]);
+		if (pHierarchy == nullptr)
+			continue;
+		let idx = pHierarchy->IndexOf(pIDs[it]);
+		batchWrites.push_back(BatchWrite { pHierarchy, idx, it });
+	}
+
+	// group by hierarchy (keeping the given order within each, so later writes still win)
+	eastl::sort(batchWrites.begin(), batchWrites.end(), [](const BatchWrite& lhs, const BatchWrite& rhs) { 
+		return lhs.pHierarchy != rhs.pHierarchy ? eastl::less<Hierarchy*>()(lhs.pHierarchy, rhs.pHierarchy) : lhs.srcIdx < rhs.srcIdx;
+	});
+
+	let count = int32(batchWrites.size());
+	batchIndices.resize(count);
+	poses.resize(count);
+	for (int32 it = 0; it < count; ++it) {
+		batchIndices[it] = batchWrites[it].idx;
+		poses[it] = pPoses[batchWrites[it].srcIdx];
+	}
+
+	int32 runStart = 0;
+	for (int32 it = 1; it <= count; ++it) {
+		if (it == count || batchWrites[it].pHierarchy != batchWrites[runStart].pHierarchy) {
+			SetScenePosesBatchByIndex(batchWrites[runStart].pHierarchy, batchIndices.data() + runStart, poses.data() + runStart, it - runStart);
+			runStart = it;
+		}
+	}
+}
+
+void Scene::SetScenePosesBatch(const ObjectID* pIDs, const HPose* pPoses, int32 n) {
+	DoSetScenePosesBatch(pIDs, pPoses, n, batchPoses);
+}
+
+void Scene::SetSceneRigidPosesBatch(const ObjectID* pIDs, const RPose* pPoses, int32 n) {
+	DoSetScenePosesBatch(pIDs, pPoses, n, batchRigidPoses);
 }
 
 void Scene::Hierarchy_DidAddObject(Hierarchy* hierarchy, ObjectID id) {
@@ -8,6 +8,7 @@
 #include "Math.h"
 #include "Listener.h"
 
+class JobSystem;
 class Scene;
 
 //------------------------------------------------------------------------------------------
@@ -32,9 +33,30 @@ private:
 	enum SceneComponents { C_SUBLEVEL = 1 };
 
 	ObjectMgr<Name> mgr;
+	NameIndex names;
 	ObjectPool<StrongRef<Hierarchy>> sublevels;
 	ObjectPool<Hierarchy*> sceneObjects;
 	ListenerList<ISceneListener> listeners;
+	bool deferPoseUpdates = false;
+
+	struct FlushRange {
+		Hierarchy* pHierarchy;
+		int32 idxStart;
+		int32 idxEnd;
+	};
+
+	struct BatchWrite {
+		Hierarchy* pHierarchy;
+		int32 idx;
+		int32 srcIdx;
+	};
+
+	eastl::vector<FlushRange> flushRanges;
+	eastl::vector<eastl::vector<ObjectID>> flushMoved; // (by flush range)
+	eastl::vector<BatchWrite> batchWrites;
+	eastl::vector<int32> batchIndices;
+	eastl::vector<HPose> batchPoses;
+	eastl::vector<RPose> batchRigidPoses;
 
 public:
 
@@ -65,6 +87,15 @@ public:
 	Hierarchy* GetHierarchy(ObjectID id) { return DerefPP(sublevels.TryGetComponent<C_HIERARCHY>(id)); }
 	Hierarchy* GetHierarchyByIndex(int32 idx) { return *sublevels.GetComponentByIndex<C_HIERARCHY>(idx); }
 
+	bool IsDeferringPoseUpdates() const { return deferPoseUpdates; }
+	void SetDeferPoseUpdates(bool defer);
+	void FlushScenePoses();
+	void UpdateTransformsParallel(JobSystem* pJobs);
+
+	// batch pose-writes across sublevels, grouped by hierarchy (e.g. physics write-back)
+	void SetScenePosesBatch(const ObjectID* pIDs, const HPose* pPoses, int32 n);
+	void SetSceneRigidPosesBatch(const ObjectID* pIDs, const RPose* pPoses, int32 n);
+
 	ObjectID GetSublevel(ObjectID id) { let result = sceneObjects.TryGetComponent<C_SUBLEVEL>(id); return result ? (*result)->ID() : OBJECT_NIL; }
 	Hierarchy* GetSublevelHierarchyFor(ObjectID id) { return DerefPP(sceneObjects.TryGetComponent<C_SUBLEVEL>(id)); }
 
@@ -72,6 +103,8 @@ public:
 
 private:
 
+	template<typename T> void DoSetScenePosesBatch(const ObjectID* pIDs, const T* pPoses, int32 n, eastl::vector<T>& poses);
+
 	void Hierarchy_DidAddObject(Hierarchy* hierarchy, ObjectID id) override;
 	void Hierarchy_WillRemoveObject(Hierarchy* hierarchy, ObjectID id) override;
 };
@@ -7,6 +7,7 @@
 #include <lua.hpp>
 #include <glm/gtx/color_space.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <cfloat>
 
 //------------------------------------------------------------------------------------------
 // scripting helper methods/macros
@@ -176,9 +177,16 @@ static int l_object_at(lua_State* lua) {
 	return 1;
 }
 
+static int l_release_object(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	let obj = check_obj(lua, ObjectTag::SCENE_OBJECT, 1);
+	w.scene.TryReleaseObject(obj.id);
+	return 0;
+}
+
 static int l_position(lua_State* lua) {
 	SCENE_OBJ_METHOD_PREAMBLE;
-	let pos = hierarchy->GetScenePose(obj.id)->position;
+	let pos = hierarchy->GetCurrentScenePose(obj.id).position;
 	lua_pushvec3(lua, pos);
 	return 3;
 }
@@ -213,6 +221,37 @@ static int l_set_rotation(lua_State* lua) {
 	return 0;
 }
 
+// Prefers cooked asset-data from a mounted archive, falling back on importing from source.
+// Either way the data is recorded, in case we're packing an archive.
+template<typename T>
+static AssetDataRef LoadOrImportAssetData(World& w, const char* sourcePath, AssetDataRef (*importFunc)(const char*)) {
+	auto result = w.db.FindArchivedAssetData(sourcePath, T::SCHEMA);
+	if (!result)
+		result = importFunc(sourcePath);
+	w.db.RecordAssetData(sourcePath, result.GetHeader());
+	return result;
+}
+
+static int l_mount_archive(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	let path = luaL_checkstring(lua, 1);
+	lua_pushboolean(lua, w.db.TryMountArchive(path));
+	return 1;
+}
+
+static int l_begin_archive(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	w.db.BeginRecordingArchive();
+	return 0;
+}
+
+static int l_save_archive(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	let path = luaL_checkstring(lua, 1);
+	lua_pushboolean(lua, w.db.TrySaveRecordedArchive(path));
+	return 1;
+}
+
 static int l_import_material(lua_State* lua) {
 	using namespace eastl::literals::string_literals;
 	SCRIPT_PREAMBLE;
@@ -227,12 +266,12 @@ static int l_import_material(lua_State* lua) {
 	}
 
 	// import material asset
-	let pAsset = ImportMaterialAssetDataFromSource(sourcePath);
+	let raii = LoadOrImportAssetData<MaterialAssetData>(w, sourcePath, ImportMaterialAssetDataFromSource);
+	let pAsset = raii.Get<MaterialAssetData>();
 	if (!pAsset) {
 		lua_pushobj(lua, ObjectTag::UNDEFINED, OBJECT_NIL);
 		return 1;
 	}
-	AssetDataRef raii(pAsset);
 
 	// ensure all our textures are loaded
 	auto reader = pAsset->TextureVariables();
@@ -240,14 +279,14 @@ static int l_import_material(lua_State* lua) {
 		let tpath = (reader.ReadString(), reader.ReadString()); // skip var name
 		let tid = w.db.FindAsset(tpath);
 		if (tid.IsNil()) {
-			let pTexData = ImportTextureAssetDataFromSource(tpath);
+			let texRaii = LoadOrImportAssetData<TextureAssetData>(w, tpath, ImportTextureAssetDataFromSource);
+			let pTexData = texRaii.Get<TextureAssetData>();
 			if (!pTexData) {
 				lua_pushobj(lua, ObjectTag::UNDEFINED, OBJECT_NIL);
 				return 1;
 			}
 			let tid = w.db.CreateObject(tpath);
 			w.tex.LoadTexture(tid, pTexData);
-			FreeAssetData(pTexData);
 		}
 	}
 
@@ -278,12 +317,12 @@ static int l_import_mesh(lua_State* lua) {
 	}
 
 	// import mesh asset
-	let pAsset = ImportMeshAssetDataFromSource(sourcePath);
+	let raii = LoadOrImportAssetData<MeshAssetData>(w, sourcePath, ImportMeshAssetDataFromSource);
+	let pAsset = raii.Get<MeshAssetData>();
 	if (!pAsset) {
 		lua_pushobj(lua, ObjectTag::UNDEFINED, OBJECT_NIL);
 		return 1;
 	}
-	AssetDataRef raii(pAsset);
 
 	// TODO: default materials?
 	let id = existingID.IsNil() ? w.db.CreateObject(sourcePath) : existingID;
@@ -344,14 +383,57 @@ static int l_attach_rendermesh_to(lua_State* lua) {
 	let mesh = check_obj(lua, ObjectTag::MESH_ASSET, 2);
 	let material = check_obj(lua, ObjectTag::MATERIAL_ASSET, 3);
 	let shadow = lua_check_boolean_opt(lua, 4, true);
+	let occluder = lua_check_boolean_opt(lua, 5, false);
 	let pMesh = w.mesh.GetMesh(mesh.id);
 	let pMaterial = w.mat.GetMaterial(material.id);
-	RenderMeshData rmd { pMesh, pMaterial, shadow };	
+	RenderMeshData rmd { pMesh, pMaterial, shadow, occluder };
 	let result = w.gfx.AddMeshRenderer(obj.id, rmd);
 	lua_pushboolean(lua, result);
 	return 1;
 }
 
+static int l_query_sphere(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	let center = lua_check_vec3(lua, 1);
+	let radius = lua_checkfloat(lua, 4);
+	let& index = w.gfx.GetSpatialIndex();
+	lua_newtable(lua);
+	int32 count = 0;
+	index.QuerySphere(center, radius, [&](int32 proxy) {
+		lua_pushobj(lua, ObjectTag::SCENE_OBJECT, index.GetObject(proxy));
+		lua_rawseti(lua, -2, ++count);
+		return true;
+	});
+	return 1;
+}
+
+static int l_raycast(lua_State* lua) {
+	// returns the nearest object whose renderer bounds the ray hits, and the distance
+	SCRIPT_PREAMBLE;
+	let origin = lua_check_vec3(lua, 1);
+	let rawDirection = lua_check_vec3(lua, 4);
+	let directionLengthSq = glm::dot(rawDirection, rawDirection);
+	if (!(directionLengthSq > 0.f) || glm::isinf(directionLengthSq))
+		return luaL_argerror(lua, 4, "Expected a non-zero, finite direction");
+	let direction = rawDirection / glm::sqrt(directionLengthSq);
+	let maxDistance = lua_gettop(lua) >= 7 ? lua_checkfloat(lua, 7) : FLT_MAX;
+	let& index = w.gfx.GetSpatialIndex();
+	ObjectID hit = OBJECT_NIL;
+	float hitDistance = maxDistance;
+	index.RayCast(origin, direction, maxDistance, [&](int32 proxy, float distance) {
+		hit = index.GetObject(proxy);
+		hitDistance = distance;
+		return distance;
+	});
+	if (hit.IsNil()) {
+		lua_pushnil(lua);
+		return 1;
+	}
+	lua_pushobj(lua, ObjectTag::SCENE_OBJECT, hit);
+	lua_pushnumber(lua, hitDistance);
+	return 2;
+}
+
 static int l_add_ground_plane(lua_State* lua) {
 	SCRIPT_PREAMBLE;
 	w.phys.TryAddGroundPlane();
@@ -410,6 +492,20 @@ static int l_set_light_direction(lua_State* lua) {
 	return 0;
 }
 
+static int l_set_shadow_cascades(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	auto settings = w.gfx.GetShadowSettings();
+	settings.cascadeCount = static_cast<int32>(luaL_checkinteger(lua, 1));
+	settings.resolution = static_cast<uint32>(luaL_optinteger(lua, 2, settings.resolution));
+	settings.distance = (float) luaL_optnumber(lua, 3, settings.distance);
+	if (settings.cascadeCount < 1 || settings.cascadeCount > MAX_SHADOW_CASCADES)
+		return luaL_argerror(lua, 1, "cascade count out of range");
+	if (settings.resolution < 16)
+		return luaL_argerror(lua, 2, "resolution too small");
+	w.gfx.SetShadowSettings(settings);
+	return 0;
+}
+
 static int l_get_left_stick(lua_State* lua) {
 	SCRIPT_PREAMBLE;
 	lua_pushvec2(lua, w.input.GetStickL());
@@ -464,6 +560,7 @@ static const struct luaL_Reg lib_trinket[] = {
 	{ "default_sublevel",     l_default_sublevel     },
 	{ "find_object",          l_find_object          },
 	{ "object_at",            l_object_at            },
+	{ "release_object",       l_release_object       },
 
 	// input 
 	{ "get_left_stick",       l_get_left_stick       },
@@ -487,6 +584,12 @@ static const struct luaL_Reg lib_trinket[] = {
 	{ "set_pov_rotation",     l_set_pov_rotation     },
 	{ "translate_pov_local",  l_translate_pov_local  },
 	{ "set_light_direction",  l_set_light_direction  },
+	{ "set_shadow_cascades",  l_set_shadow_cascades  },
+
+	// archive functions
+	{ "mount_archive",        l_mount_archive        },
+	{ "begin_archive",        l_begin_archive        },
+	{ "save_archive",         l_save_archive         },
 
 	// material functions
 	{ "import_material",      l_import_material      },
@@ -497,6 +600,8 @@ static const struct luaL_Reg lib_trinket[] = {
 	{ "create_plane_mesh",    l_create_plane_mesh    },
 	{ "create_capsule_mesh",  l_create_capsule_mesh  },
 	{ "attach_rendermesh_to", l_attach_rendermesh_to },
+	{ "query_sphere",         l_query_sphere         },
+	{ "raycast",              l_raycast              },
 
 	// physics functions
 	{ "add_ground_plane",      l_add_ground_plane      },
@@ -543,28 +648,23 @@ static int l_wireframe_get_position(lua_State* lua) {
 static int l_wireframe_draw_cube(lua_State* lua) {
 	SCRIPT_PREAMBLE;
 	let sz = lua_checkfloat(lua, 1);
-	let pos = vm->wireframePosition;
-	let rot = vm->wireframeRotation;
-	let col = vm->wireframeColor;
-
-	// draw bottom
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, -sz, -sz), pos + rot * vec3(sz, -sz, -sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, -sz, -sz), pos + rot * vec3(-sz, sz, -sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(sz, -sz, -sz), pos + rot * vec3(sz, sz, -sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, sz, -sz), pos + rot * vec3(sz, sz, -sz));
-
-	// draw top
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, -sz, sz), pos + rot * vec3(sz, -sz, sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, -sz, sz), pos + rot * vec3(-sz, sz, sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(sz, -sz, sz), pos + rot * vec3(sz, sz, sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, sz, sz), pos + rot * vec3(sz, sz, sz));
-
-	// draw connections
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, -sz, -sz), pos + rot * vec3(-sz, -sz, sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(sz, -sz, -sz), pos + rot * vec3(sz, -sz, sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(-sz, sz, -sz), pos + rot * vec3(-sz, sz, sz));
-	w.gfx.DrawDebugLine(col, pos + rot * vec3(sz, sz, -sz), pos + rot * vec3(sz, sz, sz));
+	let transform = glm::translate(vm->wireframePosition) * glm::toMat4(vm->wireframeRotation) * glm::scale(vec3(sz, sz, sz));
+	w.gfx.GetDebugLines()->DrawBox(vm->wireframeColor, transform);
+	return 0;
+}
+
+static int l_wireframe_draw_sphere(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	let radius = lua_checkfloat(lua, 1);
+	w.gfx.GetDebugLines()->DrawSphere(vm->wireframeColor, vm->wireframePosition, radius);
+	return 0;
+}
 
+static int l_wireframe_draw_axes(lua_State* lua) {
+	SCRIPT_PREAMBLE;
+	let sz = lua_checkfloat(lua, 1);
+	let transform = glm::translate(vm->wireframePosition) * glm::toMat4(vm->wireframeRotation);
+	w.gfx.GetDebugLines()->DrawAxes(transform, sz);
 	return 0;
 }
 
@@ -574,7 +674,9 @@ static int l_wireframe_set_rotation(lua_State* lua) { return 0; }
 static int l_wireframe_set_color(lua_State* lua) { return 0; }
 static int l_wireframe_line_to(lua_State* lua) { return 0; }
 static int l_wireframe_get_position(lua_State* lua) { lua_pushvec3(lua, vec3(0,0,0)); return 3; }
-static ine l_wireframe_draw_cube(lua_State* lua) { return 0; }
+static int l_wireframe_draw_cube(lua_State* lua) { return 0; }
+static int l_wireframe_draw_sphere(lua_State* lua) { return 0; }
+static int l_wireframe_draw_axes(lua_State* lua) { return 0; }
 #endif
 
 static const struct luaL_Reg lib_wireframe[] = {
@@ -584,6 +686,8 @@ static const struct luaL_Reg lib_wireframe[] = {
 	{ "line_to",      l_wireframe_line_to      },
 	{ "get_position", l_wireframe_get_position },
 	{ "draw_cube",    l_wireframe_draw_cube    },
+	{ "draw_sphere",  l_wireframe_draw_sphere  },
+	{ "draw_axes",    l_wireframe_draw_axes    },
 	{ nullptr, nullptr }
 };
 
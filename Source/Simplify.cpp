@@ -0,0 +1,216 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "Simplify.h"
+#include <EASTL/algorithm.h>
+#include <EASTL/hash_map.h>
+#include <EASTL/sort.h>
+#include <EASTL/vector.h>
+
+#ifndef SIMPLIFY_MAX_PASSES
+#	define SIMPLIFY_MAX_PASSES 32
+#endif
+
+// symmetric 4x4 error quadric (its upper triangle), measuring squared distance to a set of planes
+struct SimplifyQuadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+	static SimplifyQuadric FromPlane(const vec3& normal, float distance, double weight) {
+		const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+		return SimplifyQuadric {
+			weight * a * a, weight * a * b, weight * a * c, weight * a * d,
+			weight * b * b, weight * b * c, weight * b * d,
+			weight * c * c, weight * c * d,
+			weight * d * d
+		};
+	}
+
+	void Add(const SimplifyQuadric& q) {
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+	}
+
+	double Evaluate(const vec3& p) const {
+		const double x = p.x, y = p.y, z = p.z;
+		return
+			a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+			b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+			c2 * z * z + 2.0 * cd * z +
+			d2;
+	}
+};
+
+struct SimplifyCollapse {
+	double cost;
+	uint32 from;
+	uint32 to;
+};
+
+uint32 SimplifyMesh(uint32* outIndices, const uint32* pIndices, uint32 indexCount, const vec3* pPositions, uint32 vertexCount, uint32 targetIndexCount) {
+	CHECK_ASSERT(indexCount % 3 == 0);
+	memcpy(outIndices, pIndices, indexCount * sizeof(uint32));
+	auto count = indexCount;
+
+	// each vertex starts with the planes of its triangles, weighted by area
+	eastl::vector<SimplifyQuadric> quadrics(vertexCount, SimplifyQuadric {});
+	for(uint32 it=0; it<count; it+=3) {
+		let p0 = pPositions[outIndices[it]];
+		let cross = glm::cross(pPositions[outIndices[it + 1]] - p0, pPositions[outIndices[it + 2]] - p0);
+		let length = glm::length(cross);
+		if (length <= 0.f)
+			continue;
+		let normal = cross / length;
+		let quadric = SimplifyQuadric::FromPlane(normal, -glm::dot(normal, p0), 0.5 * length);
+		for(uint32 corner=0; corner<3; ++corner)
+			quadrics[outIndices[it + corner]].Add(quadric);
+	}
+
+	eastl::vector<uint32> triangleOffsets(vertexCount + 1);
+	eastl::vector<uint32> triangleCursors(vertexCount);
+	eastl::vector<uint32> triangleLists;
+	eastl::vector<uint8> locked(vertexCount);
+	eastl::vector<uint8> touched(vertexCount);
+	eastl::vector<uint32> linkStamps(vertexCount);
+	uint32 linkStamp = 0;
+	eastl::hash_map<uint64, uint32> edgeCounts;
+	eastl::vector<SimplifyCollapse> collapses;
+
+	// each pass collapses the cheapest edges whose neighbourhoods don't overlap, so the
+	// adjacency built at the start of the pass stays valid for every collapse it makes
+	for(int pass=0; pass<SIMPLIFY_MAX_PASSES && count > targetIndexCount; ++pass) {
+
+		// vertex-to-triangle adjacency
+		eastl::fill(triangleOffsets.begin(), triangleOffsets.end(), 0u);
+		for(uint32 it=0; it<count; ++it)
+			++triangleOffsets[outIndices[it] + 1];
+		for(uint32 it=0; it<vertexCount; ++it)
+			triangleOffsets[it + 1] += triangleOffsets[it];
+		eastl::copy(triangleOffsets.begin(), triangleOffsets.end() - 1, triangleCursors.begin());
+		triangleLists.resize(count);
+		for(uint32 it=0; it<count; ++it)
+			triangleLists[triangleCursors[outIndices[it]]++] = it / 3;
+
+		// edges with one triangle are borders (seams count, as their vertices are split)
+		edgeCounts.clear();
+		for(uint32 it=0; it<count; ++it) {
+			let a = outIndices[it];
+			let b = outIndices[it % 3 == 2 ? it - 2 : it + 1];
+			++edgeCounts[(uint64(eastl::min(a, b)) << 32) | eastl::max(a, b)];
+		}
+		eastl::fill(locked.begin(), locked.end(), uint8(0));
+		for(let& it : edgeCounts) {
+			if (it.second == 1) {
+				locked[uint32(it.first >> 32)] = 1;
+				locked[uint32(it.first)] = 1;
+			}
+		}
+
+		// candidate collapses (in both directions), cheapest first
+		collapses.clear();
+		for(uint32 it=0; it<count; ++it) {
+			let a = outIndices[it];
+			let b = outIndices[it % 3 == 2 ? it - 2 : it + 1];
+			auto quadric = quadrics[a];
+			quadric.Add(quadrics[b]);
+			if (!locked[a])
+				collapses.push_back(SimplifyCollapse { quadric.Evaluate(pPositions[b]), a, b });
+			if (!locked[b])
+				collapses.push_back(SimplifyCollapse { quadric.Evaluate(pPositions[a]), b, a });
+		}
+		eastl::sort(collapses.begin(), collapses.end(), [](const SimplifyCollapse& lhs, const SimplifyCollapse& rhs) { return lhs.cost < rhs.cost; });
+
+		eastl::fill(touched.begin(), touched.end(), uint8(0));
+		auto liveCount = count;
+		uint32 collapseCount = 0;
+		for(let& collapse : collapses) {
+			if (liveCount <= targetIndexCount)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// link condition: the only vertices adjacent to both ends may be the apexes of the
+			// edge's own triangles, or else the collapse pinches the surface (folding it onto
+			// itself, or leaving non-manifold edges)
+			let trianglesBegin = triangleLists.begin() + triangleOffsets[collapse.from];
+			let trianglesEnd = triangleLists.begin() + triangleOffsets[collapse.from + 1];
+			let fromStamp = ++linkStamp;
+			let sharedStamp = ++linkStamp;
+			uint32 edgeTriangleCount = 0;
+			for(auto pTriangle=trianglesBegin; pTriangle!=trianglesEnd; ++pTriangle) {
+				let pCorners = outIndices + 3 * (*pTriangle);
+				if (pCorners[0] == collapse.to || pCorners[1] == collapse.to || pCorners[2] == collapse.to)
+					++edgeTriangleCount;
+				for(int corner=0; corner<3; ++corner)
+					linkStamps[pCorners[corner]] = fromStamp;
+			}
+			uint32 sharedCount = 0;
+			for(auto it=triangleOffsets[collapse.to]; it<triangleOffsets[collapse.to + 1]; ++it) {
+				let pCorners = outIndices + 3 * triangleLists[it];
+				for(int corner=0; corner<3; ++corner) {
+					let vertex = pCorners[corner];
+					if (vertex != collapse.from && vertex != collapse.to && linkStamps[vertex] == fromStamp) {
+						linkStamps[vertex] = sharedStamp;
+						++sharedCount;
+					}
+				}
+			}
+			if (sharedCount > edgeTriangleCount)
+				continue;
+
+			// reject collapses which would flip (or sharply turn) any remaining triangle, as
+			// turns of up to a right angle per pass could add up to a flip over several
+			bool bFlips = false;
+			for(auto pTriangle=trianglesBegin; pTriangle!=trianglesEnd && !bFlips; ++pTriangle) {
+				let pCorners = outIndices + 3 * (*pTriangle);
+				if (pCorners[0] == collapse.to || pCorners[1] == collapse.to || pCorners[2] == collapse.to)
+					continue;
+				vec3 before[3], after[3];
+				for(int corner=0; corner<3; ++corner) {
+					before[corner] = pPositions[pCorners[corner]];
+					after[corner] = pCorners[corner] == collapse.from ? pPositions[collapse.to] : before[corner];
+				}
+				let normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				let normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				bFlips = glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter);
+			}
+			if (bFlips)
+				continue;
+
+			// triangles on the edge degenerate, and the rest move their corner over
+			for(auto pTriangle=trianglesBegin; pTriangle!=trianglesEnd; ++pTriangle) {
+				let pCorners = outIndices + 3 * (*pTriangle);
+				if (pCorners[0] == collapse.to || pCorners[1] == collapse.to || pCorners[2] == collapse.to)
+					liveCount -= 3;
+				for(int corner=0; corner<3; ++corner) {
+					if (pCorners[corner] == collapse.from)
+						pCorners[corner] = collapse.to;
+					touched[pCorners[corner]] = 1;
+				}
+			}
+			touched[collapse.from] = 1;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			++collapseCount;
+		}
+
+		// drop degenerate triangles
+		uint32 writeIdx = 0;
+		for(uint32 it=0; it<count; it+=3) {
+			let a = outIndices[it];
+			let b = outIndices[it + 1];
+			let c = outIndices[it + 2];
+			if (a == b || b == c || c == a)
+				continue;
+			outIndices[writeIdx++] = a;
+			outIndices[writeIdx++] = b;
+			outIndices[writeIdx++] = c;
+		}
+		count = writeIdx;
+
+		if (collapseCount == 0)
+			break;
+	}
+
+	return count;
+}
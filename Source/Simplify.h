@@ -0,0 +1,13 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Math.h"
+
+// Reduces an indexed triangle list towards targetIndexCount by quadric-error edge
+// collapses (Garland & Heckbert). Edges collapse onto one of their vertices, so the
+// result indexes the same vertex buffer. Vertices on borders (including UV seams, where
+// vertices are split) never move, so the outline and seams of the mesh are kept, and
+// collapses which would fail the link condition or flip a triangle are skipped.
+// Writes to outIndices (room for indexCount), and returns the number written.
+uint32 SimplifyMesh(uint32* outIndices, const uint32* pIndices, uint32 indexCount, const vec3* pPositions, uint32 vertexCount, uint32 targetIndexCount);
@@ -160,14 +160,14 @@ void SkelRegistry::Update() {
 	let pSocketIDs = sockets.GetComponentData<0>();
 	let pSockets = sockets.GetComponentData<1>();
 	let nSockets = sockets.Count();
+	
+	socketPoses.resize(nSockets);
 	for(int it=0; it<nSockets; ++it) {
-		let id = pSocketIDs[it];
 		let skelID = pSockets[it].pSkeleton->ID();
-		let pSocketHierarchy = pScene->GetSublevelHierarchyFor(id);
 		let pSkelHierarchy = pScene->GetSublevelHierarchyFor(skelID);
-		let pose = (*pSkelHierarchy->GetScenePose(skelID)) * pSockets[it].pSkeleton->GetObjectPose(pSockets[it].idx);
-		pSocketHierarchy->SetScenePose(id, pose);
+		socketPoses[it] = pSkelHierarchy->GetCurrentScenePose(skelID) * pSockets[it].pSkeleton->GetObjectPose(pSockets[it].idx);
 	}
+	pScene->SetScenePosesBatch(pSocketIDs, socketPoses.data(), nSockets);
 }
 
 void SkelRegistry::Database_WillReleaseAsset(AssetDatabase* caller, ObjectID id) {
@@ -114,6 +114,7 @@ private:
 	ObjectPool<StrongRef<SkelAsset>> assets;
 	ObjectPool<StrongRef<Skeleton>> instances;
 	ObjectPool<Socket> sockets;
+	eastl::vector<HPose> socketPoses; // (scratch for writing back to the scene)
 
 	void Database_WillReleaseAsset(AssetDatabase* caller, ObjectID id) override;
 	void Scene_WillReleaseObject(Scene* caller, ObjectID id) override;
@@ -0,0 +1,230 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#include "Tests.h"
+
+#if TRINKET_TEST
+#include "Hierarchy.h"
+#include "Scene.h"
+#include <EASTL/algorithm.h>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+bool PoseColumnsEqual(const Hierarchy& lhs, const Hierarchy& rhs) {
+	let n = lhs.Count();
+	return n == rhs.Count() &&
+		memcmp(lhs.GetRelativePoseData(), rhs.GetRelativePoseData(), n * sizeof(HPose)) == 0 &&
+		memcmp(lhs.GetScenePoseData(), rhs.GetScenePoseData(), n * sizeof(HPose)) == 0;
+}
+
+void AddRandomTree(Hierarchy& hierarchy, TestRandom& rng, int32 count) {
+
+	// objects are parented to a random earlier object (or left as roots),
+	// with a few masks mixed in
+	for (int32 it = 0; it < count; ++it) {
+		let id = ObjectID(uint32(it));
+		let parent = it == 0 || rng.Range(8) == 0 ? OBJECT_NIL : ObjectID(uint32(rng.Range(it)));
+		hierarchy.TryAdd(id, parent);
+		hierarchy.SetRelativePose(id, rng.Pose());
+		if (rng.Range(6) == 0)
+			hierarchy.SetMask(id, PoseMask(uint8(rng.Range(8))), ReparentMode::MaintainRelativePose);
+	}
+}
+
+void ApplyRandomWrite(Hierarchy& hierarchy, TestRandom& rng, int32 count) {
+	let id = ObjectID(uint32(rng.Range(count)));
+	switch (rng.Range(13)) {
+	case 0: hierarchy.SetRelativePose(id, rng.Pose()); break;
+	case 1: hierarchy.SetRelativePosition(id, rng.Position()); break;
+	case 2: hierarchy.SetRelativeRotation(id, rng.Rotation()); break;
+	case 3: hierarchy.SetRelativeScale(id, rng.Scale()); break;
+	case 4: hierarchy.SetRelativeRigidPose(id, RPose(rng.Rotation(), rng.Position())); break;
+	case 5: hierarchy.SetScenePose(id, rng.Pose()); break;
+	case 6: hierarchy.SetScenePosition(id, rng.Position()); break;
+	case 7: hierarchy.SetSceneRotation(id, rng.Rotation()); break;
+	case 8: hierarchy.SetSceneScale(id, rng.Scale()); break;
+	case 9: hierarchy.SetSceneRigidPose(id, RPose(rng.Rotation(), rng.Position())); break;
+	case 10: hierarchy.SetMask(id, PoseMask(uint8(rng.Range(8))), ReparentMode::MaintainScenePose); break;
+	case 11: {
+		const ObjectID ids[] = { id, hierarchy.GetParent(id), ObjectID(uint32(rng.Range(count))) };
+		const HPose poses[] = { rng.Pose(), rng.Pose(), rng.Pose() };
+		hierarchy.SetScenePosesBatch(ids, poses, 3);
+		break;
+	}
+	default: hierarchy.SetMask(id, PoseMask(uint8(rng.Range(8))), ReparentMode::MaintainRelativePose); break;
+	}
+}
+
+bool TestDeferredPosesMatchEager(uint32 seed) {
+
+	// the same random setter traffic is applied to an eager and a deferred hierarchy
+	// (from the same seed), which must end up with bitwise-identical pose columns, and
+	// GetCurrentScenePose() must agree with the eager scene pose between flushes
+	const int32 objectCount = 2048;
+	const int32 writeCount = 50000;
+	Hierarchy eager(ObjectID(0u));
+	Hierarchy deferred(ObjectID(1u));
+	TestRandom eagerRandom(seed), deferredRandom(seed);
+	AddRandomTree(eager, eagerRandom, objectCount);
+	AddRandomTree(deferred, deferredRandom, objectCount);
+	deferred.SetDeferPoseUpdates(true);
+
+	TestRandom checkRandom(seed ^ 0x5eed);
+	for (int32 it = 0; it < writeCount; ++it) {
+		ApplyRandomWrite(eager, eagerRandom, objectCount);
+		ApplyRandomWrite(deferred, deferredRandom, objectCount);
+
+		if (checkRandom.Range(64) == 0) {
+			let id = ObjectID(uint32(checkRandom.Range(objectCount)));
+			let current = deferred.GetCurrentScenePose(id);
+			if (memcmp(&current, eager.GetScenePose(id), sizeof(HPose)) != 0)
+				return false;
+		}
+
+		if (checkRandom.Range(1024) == 0) {
+			deferred.FlushScenePoses();
+			if (!PoseColumnsEqual(eager, deferred))
+				return false;
+		}
+	}
+
+	deferred.FlushScenePoses();
+	return PoseColumnsEqual(eager, deferred);
+}
+
+bool TestBatchPosesMatchIndividual(uint32 seed) {
+
+	// batched scene-pose writes (in any order, including parents before their children,
+	// and repeated objects) must match the same writes applied one at a time
+	const int32 objectCount = 2048;
+	const int32 batchCount = 200;
+	const int32 batchSize = 64;
+	Hierarchy individual(ObjectID(0u));
+	Hierarchy batched(ObjectID(1u));
+	TestRandom individualRandom(seed), batchedRandom(seed);
+	AddRandomTree(individual, individualRandom, objectCount);
+	AddRandomTree(batched, batchedRandom, objectCount);
+
+	TestRandom rng(seed ^ 0xba7c);
+	ObjectID ids[batchSize];
+	HPose poses[batchSize];
+	RPose rigidPoses[batchSize];
+	for (int32 batch = 0; batch < batchCount; ++batch) {
+		for (int32 it = 0; it < batchSize; ++it) {
+			// every other write follows up on the previous object's parent or child
+			auto idx = rng.Range(objectCount);
+			if (it > 0 && (it & 1)) {
+				let prevIdx = batched.IndexOf(ids[it - 1]);
+				let parentIdx = batched.GetParentIndexByIndex(prevIdx);
+				idx = parentIdx >= 0 && rng.Range(2) ? parentIdx : eastl::min(prevIdx + 1, objectCount - 1);
+			}
+			ids[it] = batched.GetObjectByIndex(idx);
+			poses[it] = rng.Pose();
+			rigidPoses[it] = RPose(rng.Rotation(), rng.Position());
+		}
+
+		let rigid = (batch & 1) != 0;
+		for (int32 it = 0; it < batchSize; ++it) {
+			if (rigid)
+				individual.SetSceneRigidPose(ids[it], rigidPoses[it]);
+			else
+				individual.SetScenePose(ids[it], poses[it]);
+		}
+		if (rigid)
+			batched.SetSceneRigidPosesBatch(ids, rigidPoses, batchSize);
+		else
+			batched.SetScenePosesBatch(ids, poses, batchSize);
+
+		if (!PoseColumnsEqual(individual, batched))
+			return false;
+	}
+
+	return true;
+}
+
+bool TestMovedObjectsCoverChanges(uint32 seed) {
+
+	// after random writes (eager and deferred), every object whose scene pose changed
+	// must be on the moved list, and nothing may be listed twice
+	const int32 objectCount = 2048;
+	const int32 frameCount = 32;
+	const int32 writesPerFrame = 64;
+	TestRandom rng(seed);
+	for (int32 defer = 0; defer < 2; ++defer) {
+		Hierarchy hierarchy(ObjectID(0u));
+		AddRandomTree(hierarchy, rng, objectCount);
+		hierarchy.ClearMovedObjects();
+		hierarchy.SetDeferPoseUpdates(defer != 0);
+
+		eastl::vector<HPose> prevPoses;
+		eastl::vector<uint8> listed;
+		for (int32 frame = 0; frame < frameCount; ++frame) {
+			prevPoses.assign(hierarchy.GetScenePoseData(), hierarchy.GetScenePoseData() + objectCount);
+			for (int32 it = 0; it < writesPerFrame; ++it)
+				ApplyRandomWrite(hierarchy, rng, objectCount);
+			hierarchy.FlushScenePoses();
+
+			listed.assign(objectCount, 0);
+			for (let id : hierarchy.GetMovedObjects()) {
+				let idx = hierarchy.IndexOf(id);
+				if (idx == INVALID_INDEX || listed[idx] || !hierarchy.WasMovedByIndex(idx))
+					return false;
+				listed[idx] = 1;
+			}
+			let pScenePoses = hierarchy.GetScenePoseData();
+			for (int32 idx = 0; idx < objectCount; ++idx)
+				if (!listed[idx] && memcmp(&prevPoses[idx], &pScenePoses[idx], sizeof(HPose)) != 0)
+					return false;
+			hierarchy.ClearMovedObjects();
+		}
+	}
+	return true;
+}
+
+}
+
+bool TestFindObjectIsFirstMatch() {
+
+	// duplicate names resolve to the earliest object, as the name-column scan did, through
+	// renames and releases
+	Scene scene;
+	ObjectID ids[4];
+	for (auto& id : ids)
+		id = scene.CreateObject(NAME("test_duplicate"));
+	if (scene.FindObject(NAME("test_duplicate")) != ids[0])
+		return false;
+	scene.TryRename(ids[0], NAME("test_renamed"));
+	if (scene.FindObject(NAME("test_duplicate")) != ids[1] || scene.FindObject(NAME("test_renamed")) != ids[0])
+		return false;
+	scene.TryRename(ids[0], NAME("test_duplicate"));
+	if (scene.FindObject(NAME("test_duplicate")) != ids[0])
+		return false;
+	scene.TryReleaseObject(ids[0]); // (swaps the last object into its slot)
+	return scene.FindObject(NAME("test_duplicate")) == ids[3];
+}
+
+int RunTests() {
+	using namespace std;
+
+	int failures = 0;
+	let Run = [&failures](const char* name, bool passed) {
+		cout << "[TEST] " << name << ": " << (passed ? "OK" : "FAILED") << endl;
+		if (!passed)
+			++failures;
+	};
+
+	for (uint32 seed = 1; seed <= 4; ++seed)
+		Run("Hierarchy deferred poses match eager", TestDeferredPosesMatchEager(seed));
+	for (uint32 seed = 1; seed <= 4; ++seed)
+		Run("Hierarchy batch poses match individual", TestBatchPosesMatchIndividual(seed));
+	for (uint32 seed = 1; seed <= 4; ++seed)
+		Run("Hierarchy moved objects cover changes", TestMovedObjectsCoverChanges(seed));
+	Run("Scene find-by-name is first match", TestFindObjectIsFirstMatch());
+
+	cout << "[TEST] " << failures << " failed" << endl;
+	return failures;
+}
+
+#endif
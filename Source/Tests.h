@@ -0,0 +1,46 @@
+// Trinket Game Engine
+// (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
+
+#pragma once
+#include "Math.h"
+#include <cmath>
+
+#if TRINKET_TEST
+
+// Self-tests for engine systems which don't need a device or content (run with
+// "Trinket --test"). Returns the number of failed tests.
+int RunTests();
+
+// Native micro-benchmarks, printing their timings (run with "Trinket --bench <name>",
+// or "--bench all"). Returns false for an unknown name.
+bool RunBenchmark(const char* name);
+
+// deterministic, so a failure is reproducible from its seed
+struct TestRandom {
+	uint32 state;
+
+	explicit TestRandom(uint32 seed) : state(seed ? seed : 1) {}
+
+	uint32 Next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	int32 Range(int32 n) { return int32(Next() % uint32(n)); }
+	float Unit() { return float(Next() & 0xffffff) / float(0xffffff); }
+	float Signed() { return 2.f * Unit() - 1.f; }
+	vec3 Position() { return vec3(4.f * Signed(), 4.f * Signed(), 4.f * Signed()); }
+	vec3 Scale() { return vec3(0.5f + Unit(), 0.5f + Unit(), 0.5f + Unit()); }
+
+	quat Rotation() {
+		auto x = Signed(), y = Signed(), z = Signed(), w = Signed() + 2.f;
+		let invLength = 1.f / sqrtf(x * x + y * y + z * z + w * w);
+		return quat(w * invLength, x * invLength, y * invLength, z * invLength);
+	}
+
+	HPose Pose() { return HPose(Rotation(), Position(), Scale()); }
+};
+
+#endif
@@ -2,12 +2,16 @@
 // (C) 2020 Max Kaufmann <max.kaufmann@gmail.com>
 
 #include "Texture.h"
+#include "AssetCache.h"
 #include "World.h"
 
 #include <stb_image.h>
 #include <ini.h>
 
-TextureAssetData* ImportTextureAssetDataFromSource(const char* configPath) {
+// bump when the import process changes, to invalidate cooked textures
+#define TEXTURE_IMPORTER_VERSION 1
+
+static TextureAssetData* DoImportTextureAssetData(const char* configPath, eastl::string& outSourcePath) {
 	using namespace eastl::literals::string_literals;
 
 	struct TextureConfig {
@@ -42,6 +46,7 @@ TextureAssetData* ImportTextureAssetDataFromSource(const char* configPath) {
 	if (!config.hasTextureSection)
 		return nullptr;
 	
+	outSourcePath = config.path;
 	int w, h, chan;
 	let pData = stbi_load(config.path.c_str(), &w, &h, &chan, 4);
 	if (pData == nullptr)
@@ -61,9 +66,21 @@ TextureAssetData* ImportTextureAssetDataFromSource(const char* configPath) {
 	return result;
 }
 
+AssetDataRef ImportTextureAssetDataFromSource(const char* configPath) {
+	const AssetCacheEntry cacheEntry(configPath, TextureAssetData::SCHEMA, TEXTURE_IMPORTER_VERSION);
+	if (auto cached = cacheEntry.TryLoad())
+		return cached;
+
+	eastl::string sourcePath;
+	let result = DoImportTextureAssetData(configPath, sourcePath);
+	if (result)
+		cacheEntry.Store(result, sourcePath.c_str());
+	return AssetDataRef(result);
+}
+
 RefCntAutoPtr<ITexture> LoadTextureHandleFromAsset(Display* pDisplay, const TextureAssetData* pData) {
 	RefCntAutoPtr<ITexture> pResult;
-	if (pData == nullptr)
+	if (pData == nullptr || pDisplay->IsHeadless())
 		return pResult;
 
 	TextureDesc desc;
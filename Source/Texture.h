@@ -23,7 +23,7 @@ struct TextureAssetData : AssetDataHeader {
 	const uint8* Data() const { return Peek<uint8>(this, sizeof(TextureAssetData)); }
 };
 
-TextureAssetData* ImportTextureAssetDataFromSource(const char* configPath);
+AssetDataRef ImportTextureAssetDataFromSource(const char* configPath);
 RefCntAutoPtr<ITexture> LoadTextureHandleFromAsset(Display* pDisplay, const TextureAssetData* pData);
 
 class World;
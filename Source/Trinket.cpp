@@ -10,27 +10,93 @@
 #include "Editor.h"
 
 #include "Geom.h"
+#include "AssetCache.h"
+#include "Tests.h"
+#include <cstring>
 
 int main(int argc, char** argv) {
     using namespace std;
 
+	#if TRINKET_TEST
+	// self-tests and native benchmarks don't need sdl, a device, or content:
+	// Trinket --test, or Trinket --bench [name]
+	for(int it=1; it<argc; ++it) {
+		if (strcmp(argv[it], "--test") == 0)
+			return RunTests() == 0 ? 0 : 1;
+		if (strcmp(argv[it], "--bench") == 0)
+			return RunBenchmark(it + 1 < argc ? argv[it + 1] : "all") ? 0 : 1;
+	}
+	#endif
+
+	// parse args: Trinket [--headless] [--verbose] [frame count] [script]
+	// (the frame count and benchmark script only apply to headless runs)
+	bool headless = TRINKET_HEADLESS;
+	bool verbose = false;
+	const char* args[2] = { nullptr, nullptr };
+	int argCount = 0;
+	for(int it=1; it<argc; ++it) {
+		if (strcmp(argv[it], "--headless") == 0)
+			headless = true;
+		else if (strcmp(argv[it], "--verbose") == 0)
+			verbose = true;
+		else if (argCount < 2)
+			args[argCount++] = argv[it];
+	}
+
 	// init sdl
 	srand(clock());
-	if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER|SDL_INIT_GAMECONTROLLER) < 0) {
+	let sdlFlags = headless ? SDL_INIT_TIMER : (SDL_INIT_VIDEO|SDL_INIT_TIMER|SDL_INIT_GAMECONTROLLER);
+	if (SDL_Init(sdlFlags) < 0) {
 		cout << "[SDL] Init Error: " << SDL_GetError() << endl;
 		return -1;
 	}
 	struct SDL_ScopeGuard { ~SDL_ScopeGuard() { SDL_Quit(); } } scope;
 
 	// init globals
-	static Display display("Trinket");
+	static Display display("Trinket", headless);
 	static World world(&display);
 	#if TRINKET_EDITOR
-	static Editor editor(&display, &world);
+	// (windowed only, and created before content is loaded)
+	eastl::unique_ptr<Editor> pEditor;
+	if (!headless)
+		pEditor.reset(new Editor(&display, &world));
 	#endif
 
-	// init content
-	world.vm.RunScript("Assets/main.lua");
+	// init content (cooked content is preferred over source assets, if it's been packed)
+	world.db.TryMountArchive("Assets/content.tpak");
+	world.vm.RunScript(headless && args[1] ? args[1] : "Assets/main.lua");
+	if (headless || verbose) {
+		let cacheStats = GetAssetCacheStats();
+		cout << "[ASSETS] Cooked-Cache Hits: " << cacheStats.hits << ", Misses: " << cacheStats.misses << endl;
+		let meshStats = GetMeshCookStats();
+		if (meshStats.triangleCount > 0)
+			cout << "[ASSETS] Cooked Meshes: " << meshStats.meshCount << ", ACMR: " << double(meshStats.cacheMissesBefore) / meshStats.triangleCount << " -> " << double(meshStats.cacheMissesAfter) / meshStats.triangleCount << endl;
+	}
+
+	if (headless) {
+		// headless: run a fixed number of frames and report CPU frame cost
+		let frameCount = args[0] ? atoi(args[0]) : 1000;
+		let startTicks = SDL_GetPerformanceCounter();
+		uint64 staticShadowCacheHits = 0;
+		uint64 staticShadowInvalidations = 0;
+		for(int frame=0; frame<frameCount; ++frame) {
+			world.Update();
+			world.gfx.Draw();
+			staticShadowCacheHits += world.gfx.GetRenderStats().staticShadowCacheHits;
+			staticShadowInvalidations += world.gfx.GetRenderStats().staticShadowInvalidations;
+		}
+		let seconds = double(SDL_GetPerformanceCounter() - startTicks) / double(SDL_GetPerformanceFrequency());
+		let& stats = world.gfx.GetRenderStats();
+		cout << "[HEADLESS] Frames: " << frameCount << ", CPU ms/frame: " << (frameCount > 0 ? 1000.0 * seconds / frameCount : 0.0) << endl;
+		let frustumVisibleCount = stats.visibleCount + stats.occludedCount;
+		cout << "[HEADLESS] Visible: " << stats.visibleCount << ", Shadow Casters: " << stats.shadowCasterCount << endl;
+		cout << "[HEADLESS] Occluded: " << stats.occludedCount << " of " << frustumVisibleCount << " in view (" << (frustumVisibleCount > 0 ? 100.0 * stats.occludedCount / frustumVisibleCount : 0.0) << "%), Occluders: " << stats.occluderCount << endl;
+		cout << "[HEADLESS] Draw Calls: " << stats.drawCount << ", Triangles: " << stats.triangleCount << ", PSO Binds: " << stats.psoBindCount << ", SRB Commits: " << stats.srbCommitCount << ", Vertex Buffer Binds: " << stats.vertexBufferBindCount << endl;
+		cout << "[HEADLESS] Buffer Maps: " << stats.mapCount << " (" << stats.uploadBytes << " bytes)" << endl;
+		let staticShadowCascades = staticShadowCacheHits + staticShadowInvalidations;
+		cout << "[HEADLESS] Static Shadow Cascades: " << staticShadowCacheHits << " cached, " << staticShadowInvalidations << " re-rendered (" << (staticShadowCascades > 0 ? 100.0 * staticShadowCacheHits / staticShadowCascades : 0.0) << "% hit rate)" << endl;
+		return 0;
+	}
 
 	// main loop
 	// TODO: multithreading :P
@@ -43,15 +109,15 @@ int main(int argc, char** argv) {
 				done = true;
 			display.HandleEvent(event);
 			#if TRINKET_EDITOR
-			editor.HandleEvent(event);
+			pEditor->HandleEvent(event);
 			#endif
 			world.HandleEvent(event);
 		}
 
 		// update
 		#if TRINKET_EDITOR
-		editor.BeginUpdate();
-		editor.EndUpdate();
+		pEditor->BeginUpdate();
+		pEditor->EndUpdate();
 		#endif
 		world.Update();
 
@@ -59,7 +125,7 @@ int main(int argc, char** argv) {
 		world.gfx.Draw();
 		display.ResolveMultisampling();
 		#if TRINKET_EDITOR
-		editor.Draw();
+		pEditor->Draw();
 		#endif
 		display.Present();
 	}
@@ -10,7 +10,10 @@ World::World(Display* aDisplay)
 	, anim(this)
 	, gfx(aDisplay, this)
 	, vm(this)
-{}
+{
+	// writes only flag dirty subtrees, and Update() propagates them once per frame
+	scene.SetDeferPoseUpdates(true);
+}
 
 void World::HandleEvent(const SDL_Event& ev) {
 	input.HandleEvent(ev);
@@ -21,6 +24,8 @@ void World::Update() {
 	if (input.GetDeltaTicks() > 0)
 		phys.Tick(input.GetDeltaTime());
 	vm.Update();
+	scene.UpdateTransformsParallel(&jobs);
+	gfx.UpdateSpatialIndex();
 }
 
 World* World::Clone() {
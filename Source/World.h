@@ -1,4 +1,5 @@
 #pragma once
+#include "Jobs.h"
 #include "Input.h"
 #include "Assets.h"
 #include "Scene.h"
@@ -14,6 +15,7 @@ public:
 
 	World(Display* aDisplay);
 
+	JobSystem jobs;
 	Input input;
 	AssetDatabase db;
 	Scene scene;
@@ -33,6 +35,7 @@ public:
 
 	World* Clone();
 
+	JobSystem* GetJobSystem() { return &jobs; }
 	Input* GetInput() { return &input; }
 	AssetDatabase* GetAssetDatabase() { return &db; }
 	Scene* GetScene() { return &scene; }